@@ -0,0 +1,111 @@
+// Debug:: containers against their std:: counterparts: insertion, resize and
+// copy workloads. Allocations stay below the default 20MB threshold and growth
+// reports are off, so a Debug* row against its Std* row is the tracking cost
+// without any reporting.
+//
+//   ./containers_benchmark --benchmark_out=containers.json --benchmark_out_format=json
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <memory/container_debug/debug_containers.hpp>
+
+namespace {
+
+// Argument: element count
+template <class Vector>
+void BM_VectorPushBack(benchmark::State& state) {
+    const int count = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        Vector vec;
+        for (int i = 0; i < count; ++i) vec.push_back(i);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+template <class Vector>
+void BM_VectorResize(benchmark::State& state) {
+    const size_t count = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        Vector vec;
+        for (size_t size = 16; size <= count; size *= 2) vec.resize(size);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Vector>
+void BM_VectorCopy(benchmark::State& state) {
+    const Vector source(static_cast<size_t>(state.range(0)), 7);
+    for (auto _ : state) {
+        Vector copy(source);
+        benchmark::DoNotOptimize(copy.data());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(int));
+}
+
+template <class String>
+void BM_StringAppend(benchmark::State& state) {
+    const int count = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        String text;
+        for (int i = 0; i < count; ++i) text += 'x';
+        benchmark::DoNotOptimize(text.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+template <class Map>
+void BM_MapInsert(benchmark::State& state) {
+    const int count = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        Map map;
+        for (int i = 0; i < count; ++i) map.emplace(i * 7919 % count, i);
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+template <class Map>
+void BM_MapCopy(benchmark::State& state) {
+    Map source;
+    for (int i = 0; i < state.range(0); ++i) source.emplace(i, i);
+    for (auto _ : state) {
+        Map copy(source);
+        benchmark::DoNotOptimize(copy.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+using DebugPoolMap = Debug::map<int, int, std::less<int>, Debug::PoolAllocator<std::pair<const int, int>>>;
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_VectorPushBack, std::vector<int>)->Name("StdVectorPushBack")->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_VectorPushBack, Debug::vector<int>)->Name("DebugVectorPushBack")->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_VectorResize, std::vector<int>)->Name("StdVectorResize")->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_VectorResize, Debug::vector<int>)->Name("DebugVectorResize")->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_VectorCopy, std::vector<int>)->Name("StdVectorCopy")->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_VectorCopy, Debug::vector<int>)->Name("DebugVectorCopy")->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_StringAppend, std::string)->Name("StdStringAppend")->Range(1 << 6, 1 << 16);
+BENCHMARK_TEMPLATE(BM_StringAppend, Debug::string)->Name("DebugStringAppend")->Range(1 << 6, 1 << 16);
+BENCHMARK_TEMPLATE(BM_MapInsert, std::map<int, int>)->Name("StdMapInsert")->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_MapInsert, Debug::map<int, int>)->Name("DebugMapInsert")->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_MapInsert, DebugPoolMap)->Name("DebugPoolMapInsert")->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_MapInsert, std::unordered_map<int, int>)->Name("StdUnorderedMapInsert")->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_MapInsert, Debug::unordered_map<int, int>)->Name("DebugUnorderedMapInsert")->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_MapCopy, std::map<int, int>)->Name("StdMapCopy")->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_MapCopy, Debug::map<int, int>)->Name("DebugMapCopy")->Range(1 << 8, 1 << 16);
+
+int main(int argc, char** argv) {
+    Debug::set_growth_report_threshold(0);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
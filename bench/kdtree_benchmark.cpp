@@ -0,0 +1,229 @@
+// MemoryMonitoredKDTree against plain nanoflann::KDTreeSingleIndexAdaptor:
+// index build, kNN and radius queries over point count, DIM, leaf size and
+// build threads. Both trees index the same random cloud, so the difference
+// between a Monitored* and a Plain* row is the cost of the monitoring.
+// Split* rows compare the monitored tree's split rules: build time, and kNN
+// time and tree depth of the tree each rule builds.
+//
+//   ./kdtree_benchmark --benchmark_out=kdtree.json --benchmark_out_format=json
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "../include/memory/nanoflann_debug/nanoflann_memory_monitor.hpp"
+
+namespace {
+
+// Row-major cloud of DIM-dimensional points
+template <int DIM>
+struct PointCloud {
+    std::vector<float> coords;
+
+    size_t kdtree_get_point_count() const { return coords.size() / DIM; }
+    float kdtree_get_pt(const size_t idx, const size_t dim) const { return coords[idx * DIM + dim]; }
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& /*bb*/) const { return false; }
+};
+
+// Lightweight view, copied by MemoryMonitoredKDTree and referenced by the plain tree
+template <int DIM>
+struct PointCloudAdaptor {
+    const PointCloud<DIM>* cloud;
+
+    size_t kdtree_get_point_count() const { return cloud->kdtree_get_point_count(); }
+    float kdtree_get_pt(const size_t idx, const size_t dim) const { return cloud->kdtree_get_pt(idx, dim); }
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& bb) const { return cloud->kdtree_get_bbox(bb); }
+};
+
+template <int DIM>
+const PointCloud<DIM>& randomCloud(size_t num_points, unsigned seed) {
+    // One cloud per size; benchmarks of both trees share it
+    static std::map<std::pair<size_t, unsigned>, PointCloud<DIM>> clouds;
+    PointCloud<DIM>& cloud = clouds[{num_points, seed}];
+    if (cloud.coords.empty()) {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+        cloud.coords.resize(num_points * DIM);
+        for (float& c : cloud.coords) c = dis(gen);
+    }
+    return cloud;
+}
+
+template <int DIM>
+using Metric = nanoflann::L2_Simple_Adaptor<float, PointCloudAdaptor<DIM>, float, uint32_t>;
+
+template <int DIM>
+using PlainTree = nanoflann::KDTreeSingleIndexAdaptor<Metric<DIM>, PointCloudAdaptor<DIM>, DIM, uint32_t>;
+
+template <int DIM>
+using MonitoredTree = nanoflann::MemoryMonitoredKDTree<Metric<DIM>, PointCloudAdaptor<DIM>, DIM, uint32_t>;
+
+// Never reached, so the monitored tree does all its checks without throwing
+constexpr size_t MEMORY_THRESHOLD = size_t(8) << 30;
+constexpr size_t NUM_QUERIES = 1000;
+constexpr size_t KNN = 10;
+// Squared L2 radius holding about KNN points of a 100k cloud in 3D
+constexpr float RADIUS = 40.0f;
+
+template <class Tree, int DIM>
+struct TreeFactory {
+    static std::unique_ptr<Tree> make(const PointCloudAdaptor<DIM>& adaptor, size_t leaf_size, unsigned threads) {
+        const nanoflann::KDTreeSingleIndexAdaptorParams params(
+            leaf_size, nanoflann::KDTreeSingleIndexAdaptorFlags::None, threads);
+        if constexpr (std::is_same<Tree, MonitoredTree<DIM>>::value) {
+            return std::make_unique<Tree>(DIM, adaptor, params, MEMORY_THRESHOLD);
+        } else {
+            return std::make_unique<Tree>(DIM, adaptor, params);
+        }
+    }
+};
+
+// Arguments: point count, leaf size, build threads
+template <class Tree, int DIM>
+void BM_Build(benchmark::State& state) {
+    const PointCloud<DIM>& cloud = randomCloud<DIM>(static_cast<size_t>(state.range(0)), 42);
+    const PointCloudAdaptor<DIM> adaptor{&cloud};
+    const size_t leaf_size = static_cast<size_t>(state.range(1));
+    const unsigned threads = static_cast<unsigned>(state.range(2));
+    for (auto _ : state) {
+        auto tree = TreeFactory<Tree, DIM>::make(adaptor, leaf_size, threads);
+        benchmark::DoNotOptimize(tree.get());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Arguments: point count, leaf size; items are queries
+template <class Tree, int DIM>
+void BM_Knn(benchmark::State& state) {
+    const PointCloud<DIM>& cloud = randomCloud<DIM>(static_cast<size_t>(state.range(0)), 42);
+    const PointCloud<DIM>& queries = randomCloud<DIM>(NUM_QUERIES, 7);
+    const PointCloudAdaptor<DIM> adaptor{&cloud};
+    auto tree = TreeFactory<Tree, DIM>::make(adaptor, static_cast<size_t>(state.range(1)), 1);
+    uint32_t indices[KNN];
+    float dists[KNN];
+    for (auto _ : state) {
+        for (size_t q = 0; q < NUM_QUERIES; ++q) {
+            nanoflann::KNNResultSet<float, uint32_t> result(KNN);
+            result.init(indices, dists);
+            tree->findNeighbors(result, &queries.coords[q * DIM]);
+            benchmark::DoNotOptimize(dists[0]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_QUERIES);
+}
+
+// Arguments: point count, leaf size; items are queries
+template <class Tree, int DIM>
+void BM_Radius(benchmark::State& state) {
+    const PointCloud<DIM>& cloud = randomCloud<DIM>(static_cast<size_t>(state.range(0)), 42);
+    const PointCloud<DIM>& queries = randomCloud<DIM>(NUM_QUERIES, 7);
+    const PointCloudAdaptor<DIM> adaptor{&cloud};
+    auto tree = TreeFactory<Tree, DIM>::make(adaptor, static_cast<size_t>(state.range(1)), 1);
+    std::vector<nanoflann::ResultItem<uint32_t, float>> matches;
+    size_t found = 0;
+    for (auto _ : state) {
+        for (size_t q = 0; q < NUM_QUERIES; ++q) {
+            matches.clear();
+            nanoflann::RadiusResultSet<float, uint32_t> result(RADIUS, matches);
+            tree->findNeighbors(result, &queries.coords[q * DIM]);
+            found += matches.size();
+        }
+    }
+    benchmark::DoNotOptimize(found);
+    state.SetItemsProcessed(state.iterations() * NUM_QUERIES);
+    // Average result size, to compare DIMs and point counts
+    state.counters["matches"] = static_cast<double>(found) / (state.iterations() * NUM_QUERIES);
+}
+
+const char* const SPLIT_RULE_NAMES[] = {"middle", "median", "sliding_midpoint", "sampled"};
+
+template <int DIM>
+std::unique_ptr<MonitoredTree<DIM>> makeSplitTree(const PointCloudAdaptor<DIM>& adaptor, int64_t rule) {
+    nanoflann::MemoryMonitoredBuildParams build_params;
+    build_params.split_rule = static_cast<nanoflann::SplitRule>(rule);
+    return std::make_unique<MonitoredTree<DIM>>(
+        DIM, adaptor, nanoflann::KDTreeSingleIndexAdaptorParams(10), MEMORY_THRESHOLD,
+        nanoflann::MemoryMonitorParams(), build_params);
+}
+
+// Arguments: point count, split rule
+template <int DIM>
+void BM_SplitBuild(benchmark::State& state) {
+    const PointCloud<DIM>& cloud = randomCloud<DIM>(static_cast<size_t>(state.range(0)), 42);
+    const PointCloudAdaptor<DIM> adaptor{&cloud};
+    size_t depth = 0;
+    for (auto _ : state) {
+        auto tree = makeSplitTree<DIM>(adaptor, state.range(1));
+        depth = tree->getTreeDepth();
+        benchmark::DoNotOptimize(tree.get());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(SPLIT_RULE_NAMES[state.range(1)]);
+    state.counters["depth"] = static_cast<double>(depth);
+}
+
+// Arguments: point count, split rule; items are queries
+template <int DIM>
+void BM_SplitKnn(benchmark::State& state) {
+    const PointCloud<DIM>& cloud = randomCloud<DIM>(static_cast<size_t>(state.range(0)), 42);
+    const PointCloud<DIM>& queries = randomCloud<DIM>(NUM_QUERIES, 7);
+    const PointCloudAdaptor<DIM> adaptor{&cloud};
+    auto tree = makeSplitTree<DIM>(adaptor, state.range(1));
+    uint32_t indices[KNN];
+    float dists[KNN];
+    for (auto _ : state) {
+        for (size_t q = 0; q < NUM_QUERIES; ++q) {
+            nanoflann::KNNResultSet<float, uint32_t> result(KNN);
+            result.init(indices, dists);
+            tree->findNeighbors(result, &queries.coords[q * DIM]);
+            benchmark::DoNotOptimize(dists[0]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_QUERIES);
+    state.SetLabel(SPLIT_RULE_NAMES[state.range(1)]);
+    state.counters["depth"] = static_cast<double>(tree->getTreeDepth());
+}
+
+void BuildArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"points", "leaf", "threads"})
+     ->ArgsProduct({{10000, 100000, 1000000}, {10}, {1}})
+     ->ArgsProduct({{100000}, {1, 4, 32}, {1}})
+     ->ArgsProduct({{1000000}, {10}, {2, 4, 8}})
+     ->UseRealTime() // CPU time of the calling thread misses the build workers
+     ->Unit(benchmark::kMillisecond);
+}
+
+void QueryArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"points", "leaf"})
+     ->ArgsProduct({{10000, 100000, 1000000}, {10}})
+     ->ArgsProduct({{100000}, {1, 4, 32}})
+     ->Unit(benchmark::kMicrosecond);
+}
+
+void SplitArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"points", "rule"})
+     ->ArgsProduct({{100000, 1000000}, {0, 1, 2, 3}});
+}
+
+} // namespace
+
+#define KDTREE_BENCHMARKS(DIM) \
+    BENCHMARK_TEMPLATE(BM_Build, PlainTree<DIM>, DIM)->Name("PlainBuild/dim:" #DIM)->Apply(BuildArgs); \
+    BENCHMARK_TEMPLATE(BM_Build, MonitoredTree<DIM>, DIM)->Name("MonitoredBuild/dim:" #DIM)->Apply(BuildArgs); \
+    BENCHMARK_TEMPLATE(BM_Knn, PlainTree<DIM>, DIM)->Name("PlainKnn/dim:" #DIM)->Apply(QueryArgs); \
+    BENCHMARK_TEMPLATE(BM_Knn, MonitoredTree<DIM>, DIM)->Name("MonitoredKnn/dim:" #DIM)->Apply(QueryArgs); \
+    BENCHMARK_TEMPLATE(BM_Radius, PlainTree<DIM>, DIM)->Name("PlainRadius/dim:" #DIM)->Apply(QueryArgs); \
+    BENCHMARK_TEMPLATE(BM_Radius, MonitoredTree<DIM>, DIM)->Name("MonitoredRadius/dim:" #DIM)->Apply(QueryArgs); \
+    BENCHMARK_TEMPLATE(BM_SplitBuild, DIM)->Name("SplitBuild/dim:" #DIM)->Apply(SplitArgs)->Unit(benchmark::kMillisecond); \
+    BENCHMARK_TEMPLATE(BM_SplitKnn, DIM)->Name("SplitKnn/dim:" #DIM)->Apply(SplitArgs)->Unit(benchmark::kMicrosecond)
+
+KDTREE_BENCHMARKS(2);
+KDTREE_BENCHMARKS(3);
+KDTREE_BENCHMARKS(6);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <random>
+#include <chrono>
+#include "../include/memory/nanoflann_debug/nanoflann_memory_monitor.hpp"
+
+// Simple dataset adaptor for 3D points
+struct PointCloudAdaptor {
+    const std::vector<std::array<float, 3>>& points;
+
+    explicit PointCloudAdaptor(const std::vector<std::array<float, 3>>& pts)
+        : points(pts) {}
+
+    inline size_t kdtree_get_point_count() const { return points.size(); }
+    inline float kdtree_get_pt(const size_t idx, const size_t dim) const {
+        return points[idx][dim];
+    }
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& /*bb*/) const { return false; }
+};
+
+using KDTree = nanoflann::MemoryMonitoredKDTree<
+    nanoflann::L2_Simple_Adaptor<float, PointCloudAdaptor, float, uint32_t>,
+    PointCloudAdaptor,
+    3,
+    uint32_t>;
+
+// Average kNN latency in nanoseconds, best of a few rounds. checksum sums the
+// result counts and nearest indices of one round, so both traversals must agree.
+double measureQueryLatency(const KDTree& index, const std::vector<std::array<float, 3>>& queries, size_t k,
+                           bool iterative, size_t& checksum) {
+    const nanoflann::MonitoredSearchParameters search_params(0, true, iterative);
+    std::vector<uint32_t> indices(k);
+    std::vector<float> dists(k);
+    double best = 0.0;
+    for (int round = 0; round < 3; ++round) {
+        checksum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto& query : queries) {
+            checksum += index.knnSearch(query.data(), k, indices.data(), dists.data(), search_params) + indices[0];
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count() / queries.size();
+        if (round == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+int main() {
+    std::cout << "Monitored KD-tree search traversal benchmark\n";
+    std::cout << "============================================\n\n";
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    const size_t num_points = 500000;
+    const size_t num_queries = 100000;
+    const size_t k = 10;
+    std::vector<std::array<float, 3>> points(num_points);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    std::vector<std::array<float, 3>> queries(num_queries);
+    for (auto& q : queries) q = {dis(gen), dis(gen), dis(gen)};
+    PointCloudAdaptor dataset(points);
+    const size_t memory_threshold = 1024ull * 1024 * 1024; // 1 GB
+
+    std::cout << num_points << " points, " << num_queries << " queries, k = " << k << "\n\n";
+    std::cout << std::setw(8) << "layout" << std::setw(7) << "leaf" << std::setw(7) << "depth"
+              << std::setw(16) << "recursive ns" << std::setw(16) << "iterative ns"
+              << std::setw(10) << "speedup" << std::setw(14) << "checksum" << "\n";
+
+    for (bool compact : {false, true}) {
+        for (size_t leaf_size : {1, 4, 10}) {
+            nanoflann::KDTreeSingleIndexAdaptorParams params;
+            params.leaf_max_size = leaf_size;
+            nanoflann::MemoryMonitoredBuildParams build_params;
+            build_params.compact_nodes = compact;
+            KDTree index(3, dataset, params, memory_threshold, nanoflann::MemoryMonitorParams(), build_params);
+
+            size_t recursive_sum = 0, iterative_sum = 0;
+            const double recursive_ns = measureQueryLatency(index, queries, k, false, recursive_sum);
+            const double iterative_ns = measureQueryLatency(index, queries, k, true, iterative_sum);
+
+            std::cout << std::setw(8) << (compact ? "compact" : "linked")
+                      << std::setw(7) << leaf_size << std::setw(7) << index.getTreeDepth()
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(16) << recursive_ns << std::setw(16) << iterative_ns
+                      << std::setprecision(2) << std::setw(9) << recursive_ns / iterative_ns << "x"
+                      << std::setw(14) << iterative_sum
+                      << (recursive_sum == iterative_sum ? "" : " (recursive differs)") << "\n";
+        }
+    }
+    return 0;
+}
@@ -2,7 +2,21 @@
 #define SIMPLE_DEBUG_CONTAINERS_HPP
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <string>
 #include <map>
@@ -14,129 +28,1619 @@
 #include <queue>
 #include <stack>
 #include <functional>
+#include <initializer_list>
+#include <iterator>
+#if __cplusplus >= 202002L && __has_include(<source_location>)
+#include <source_location>
+#endif
+#if defined(__GNUC__) && __has_include(<unwind.h>) && __has_include(<dlfcn.h>) && __has_include(<cxxabi.h>)
+#define DEBUG_CONTAINERS_HAS_BACKTRACE 1
+#include <unwind.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#endif
+
+// Define DEBUG_CONTAINERS_DISABLE (CMake: -DDEBUG_CONTAINERS_ENABLE=OFF) for
+// release builds: every Debug:: container is then an alias of its std::
+// container with std::allocator, SimpleAllocator is a plain std::allocator,
+// and nothing is tracked or reported. The configuration functions remain, so
+// the same code builds either way.
+#ifdef DEBUG_CONTAINERS_DISABLE
+#ifndef DEBUG_CONTAINERS_NO_ALLOCATION_COUNTERS
+#define DEBUG_CONTAINERS_NO_ALLOCATION_COUNTERS
+#endif
+#endif
 
 namespace Debug {
 
+// Location of a caller, taken through a defaulted argument:
+//   void resize(size_t count, source_location location = source_location::current());
+// It only holds pointers to static strings, so it costs nothing until a report uses it.
+#if defined(__cpp_lib_source_location)
+using source_location = std::source_location;
+#else
+// C++17 stand-in for std::source_location, filled in by the compiler builtins
+class source_location {
+public:
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1926)
+    static constexpr source_location current(const char* file = __builtin_FILE(),
+                                             const char* function = __builtin_FUNCTION(),
+                                             uint_least32_t line = __builtin_LINE()) noexcept {
+        return source_location(file, function, line);
+    }
+#else
+    static constexpr source_location current() noexcept {
+        return source_location();
+    }
+#endif
+
+    constexpr source_location() noexcept = default;
+
+    constexpr const char* file_name() const noexcept { return file_; }
+    constexpr const char* function_name() const noexcept { return function_; }
+    constexpr uint_least32_t line() const noexcept { return line_; }
+    constexpr uint_least32_t column() const noexcept { return 0; }
+
+private:
+    constexpr source_location(const char* file, const char* function, uint_least32_t line) noexcept
+        : file_(file), function_(function), line_(line) {}
+
+    const char* file_ = "";
+    const char* function_ = "";
+    uint_least32_t line_ = 0;
+};
+#endif
+
 // Configuration
 constexpr size_t DEFAULT_MEMORY_THRESHOLD = 20 * 1024 * 1024; // 20MB
-inline size_t memory_threshold = DEFAULT_MEMORY_THRESHOLD;
+constexpr size_t DEFAULT_GROWTH_REPORT_THRESHOLD = 8; // reallocations of one container
+
+// Message sink: receives each formatted message, valid only during the call.
+// Formatting happens in a fixed stack buffer, so reporting does not allocate
+// unless the sink does.
+using output_sink_fn = void (*)(std::string_view message, void* context);
+
+// Longest message passed to a sink; longer messages are truncated
+constexpr size_t MESSAGE_BUFFER_SIZE = 1024;
+
+// Return addresses kept per sampled report
+constexpr size_t BACKTRACE_MAX_FRAMES = 16;
+
+namespace detail {
+
+inline void stderr_sink(std::string_view message, void*) {
+    std::fwrite(message.data(), 1, message.size(), stderr);
+    std::fputc('\n', stderr);
+}
+
+// Adapter for std::function streams set with set_output_stream(); the
+// context is the stream held by the configuration snapshot
+inline void output_stream_sink(std::string_view message, void* context) {
+    (*static_cast<const std::function<void(const std::string&)>*>(context))(std::string(message));
+}
+
+} // namespace detail
+
+// Immutable configuration snapshot. Setters publish a new snapshot with a
+// higher version; readers never see a half-updated one.
+struct Config {
+    size_t memory_threshold = DEFAULT_MEMORY_THRESHOLD;
+    output_sink_fn sink = detail::stderr_sink;
+    void* sink_context = nullptr;
+    std::function<void(const std::string&)> stream; // set by set_output_stream()
+    size_t growth_report_threshold = DEFAULT_GROWTH_REPORT_THRESHOLD;
+    size_t backtrace_sample_rate = 0; // backtrace every nth report per thread (0 = off)
+    uint64_t version = 0;
+};
+
+namespace detail {
 
-// Global output stream function - defaults to std::cerr
-inline std::function<void(const std::string&)> output_stream = [](const std::string& message) {
-    std::cerr << message << std::endl;
+// Hazard pointer of one thread: the snapshot it is reading, if any. Slots are
+// never freed; a thread that exits releases its slot for reuse.
+struct ConfigReaderSlot {
+    std::atomic<const Config*> hazard{nullptr};
+    std::atomic<bool> in_use{true};
+    ConfigReaderSlot* next = nullptr;
 };
 
+inline const Config default_config{};
+inline std::atomic<const Config*> current_config{&default_config};
+inline std::atomic<ConfigReaderSlot*> config_reader_slots{nullptr};
+
+// Copy of current_config->memory_threshold, so the allocation fast path is one
+// relaxed load without taking a hazard pointer
+inline std::atomic<size_t> threshold{DEFAULT_MEMORY_THRESHOLD};
+
+inline size_t current_threshold() {
+    return threshold.load(std::memory_order_relaxed);
+}
+
+// Copy of current_config->backtrace_sample_rate, read on every report
+inline std::atomic<size_t> backtrace_sample_rate{0};
+
+// Copy of current_config->growth_report_threshold, read by every vector and
+// string destructor
+inline std::atomic<size_t> growth_report_threshold{DEFAULT_GROWTH_REPORT_THRESHOLD};
+
+struct ConfigReaderState {
+    ConfigReaderSlot* slot;
+    const Config* config; // snapshot of the outermost reader on this thread
+    int depth;
+    bool exited;
+};
+
+inline ConfigReaderSlot* acquire_config_reader_slot() {
+    ConfigReaderSlot* head = config_reader_slots.load(std::memory_order_acquire);
+    for (ConfigReaderSlot* slot = head; slot; slot = slot->next) {
+        bool expected = false;
+        if (!slot->in_use.load(std::memory_order_relaxed) &&
+            slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return slot;
+        }
+    }
+    auto* slot = new ConfigReaderSlot();
+    slot->next = head;
+    while (!config_reader_slots.compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                                      std::memory_order_acquire)) {}
+    return slot;
+}
+
+// Trivially destructible, so it stays usable after the exit hook has run
+inline ConfigReaderState& config_reader_state() {
+    struct ExitHook {
+        ~ExitHook() {
+            ConfigReaderState& state = config_reader_state();
+            state.exited = true;
+            if (state.slot && state.depth == 0) {
+                state.slot->in_use.store(false, std::memory_order_release);
+                state.slot = nullptr;
+            }
+        }
+    };
+    thread_local ConfigReaderState state{nullptr, nullptr, 0, false};
+    thread_local ExitHook hook;
+    (void)hook;
+    return state;
+}
+
+// Pins the current snapshot for the reader's lifetime. Nested readers on one
+// thread, e.g. a sink that allocates, share the outermost reader's snapshot.
+class ConfigReader {
+public:
+    ConfigReader() : state_(config_reader_state()) {
+        if (state_.depth++ > 0) return;
+        if (!state_.slot) state_.slot = acquire_config_reader_slot();
+        const Config* config = current_config.load(std::memory_order_relaxed);
+        for (;;) {
+            state_.slot->hazard.store(config, std::memory_order_seq_cst);
+            const Config* again = current_config.load(std::memory_order_seq_cst);
+            if (again == config) break;
+            config = again;
+        }
+        state_.config = config;
+    }
+
+    ~ConfigReader() {
+        if (--state_.depth > 0) return;
+        state_.slot->hazard.store(nullptr, std::memory_order_release);
+        if (state_.exited) {
+            state_.slot->in_use.store(false, std::memory_order_release);
+            state_.slot = nullptr;
+        }
+    }
+
+    ConfigReader(const ConfigReader&) = delete;
+    ConfigReader& operator=(const ConfigReader&) = delete;
+
+    const Config& operator*() const { return *state_.config; }
+    const Config* operator->() const { return state_.config; }
+
+private:
+    ConfigReaderState& state_;
+};
+
+inline std::mutex& config_write_mutex() {
+    static std::mutex* mutex = new std::mutex(); // never destroyed
+    return *mutex;
+}
+
+// Replaced snapshots that a reader may still hold; guarded by config_write_mutex()
+inline std::vector<const Config*>& retired_configs() {
+    static auto* retired = new std::vector<const Config*>();
+    return *retired;
+}
+
+// Publish a copy of the current snapshot changed by update, then free every
+// replaced snapshot that no thread's hazard pointer refers to
+template<typename Update>
+void publish_config(Update update) {
+    std::lock_guard<std::mutex> lock(config_write_mutex());
+    const Config* previous = current_config.load(std::memory_order_relaxed);
+    auto* next = new Config(*previous);
+    update(*next);
+    next->version = previous->version + 1;
+    if (next->sink == output_stream_sink) next->sink_context = &next->stream;
+    current_config.store(next, std::memory_order_seq_cst);
+    threshold.store(next->memory_threshold, std::memory_order_relaxed);
+    backtrace_sample_rate.store(next->backtrace_sample_rate, std::memory_order_relaxed);
+    growth_report_threshold.store(next->growth_report_threshold, std::memory_order_relaxed);
+
+    std::vector<const Config*>& retired = retired_configs();
+    if (previous != &default_config) retired.push_back(previous);
+    auto read_elsewhere = [](const Config* config) {
+        for (ConfigReaderSlot* slot = config_reader_slots.load(std::memory_order_acquire);
+             slot; slot = slot->next) {
+            if (slot->hazard.load(std::memory_order_seq_cst) == config) return true;
+        }
+        return false;
+    };
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [&](const Config* config) {
+        if (read_elsewhere(config)) return false;
+        delete config;
+        return true;
+    }), retired.end());
+}
+
+} // namespace detail
+
+// Version of the current configuration; bumped by every setter
+inline uint64_t config_version() {
+    return detail::current_config.load(std::memory_order_acquire)->version;
+}
+
+// Function to set a sink that receives messages as string_views
+inline void set_output_sink(output_sink_fn sink, void* context = nullptr) {
+    detail::publish_config([&](Config& config) {
+        config.sink = sink;
+        config.sink_context = context;
+        config.stream = nullptr;
+    });
+}
+
 // Function to set custom output stream
 inline void set_output_stream(std::function<void(const std::string&)> stream) {
-    output_stream = stream;
+    detail::publish_config([&](Config& config) {
+        config.stream = std::move(stream);
+        config.sink = detail::output_stream_sink;
+    });
+}
+
+// Pass message to the current sink, as the containers' own reports are; for
+// other modules that report through the same output
+inline void write_output(std::string_view message) {
+    detail::ConfigReader config;
+    config->sink(message, config->sink_context);
+}
+
+// One large allocation, as queued by the asynchronous output mode
+struct AllocationEvent {
+    size_t bytes;
+    const char* file;     // null or empty when the caller is unknown
+    const char* function;
+    int line;
+    uint64_t thread_id;
+    int64_t timestamp_ns; // steady_clock
+    const char* operation; // container member that allocated, or null
+    size_t frame_count;    // frames captured when the report was sampled, else 0
+    void* frames[BACKTRACE_MAX_FRAMES];
+};
+
+// Write "module+0xoffset (symbol+0xoffset)" for one captured return address.
+// The module offset can be resolved offline with `addr2line -e module offset`.
+// Takes the loader lock and may allocate while demangling, so it belongs on
+// the drain thread or in offline tooling, not on an allocating thread.
+inline size_t symbolize_frame(const void* pc, char* buffer, size_t buffer_size) {
+    if (buffer_size == 0) return 0;
+    int length = -1;
+#ifdef DEBUG_CONTAINERS_HAS_BACKTRACE
+    // A return address points past the call; look up the call itself
+    const char* call = static_cast<const char*>(pc) - 1;
+    Dl_info info;
+    if (dladdr(call, &info) && info.dli_fname) {
+        const char* module = std::strrchr(info.dli_fname, '/');
+        module = module ? module + 1 : info.dli_fname;
+        const size_t module_offset = static_cast<size_t>(call - static_cast<const char*>(info.dli_fbase));
+        if (info.dli_sname && info.dli_saddr) {
+            int status = -1;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            length = std::snprintf(buffer, buffer_size, "%s+0x%zx (%s+0x%zx)", module, module_offset,
+                                   status == 0 ? demangled : info.dli_sname,
+                                   static_cast<size_t>(call - static_cast<const char*>(info.dli_saddr)));
+            std::free(demangled);
+        } else {
+            length = std::snprintf(buffer, buffer_size, "%s+0x%zx", module, module_offset);
+        }
+    }
+#endif
+    if (length < 0) length = std::snprintf(buffer, buffer_size, "%p", pc);
+    return length < 0 ? 0 : std::min(static_cast<size_t>(length), buffer_size - 1);
+}
+
+namespace detail {
+
+#ifdef DEBUG_CONTAINERS_HAS_BACKTRACE
+struct BacktraceState {
+    void** frames;
+    size_t count;
+    size_t skip;
+    size_t max;
+};
+
+inline _Unwind_Reason_Code backtrace_frame(_Unwind_Context* context, void* arg) {
+    auto* state = static_cast<BacktraceState*>(arg);
+    const uintptr_t pc = _Unwind_GetIP(context);
+    if (pc == 0) return _URC_END_OF_STACK;
+    if (state->skip > 0) {
+        --state->skip;
+    } else {
+        state->frames[state->count++] = reinterpret_cast<void*>(pc);
+        if (state->count == state->max) return _URC_END_OF_STACK;
+    }
+    return _URC_NO_REASON;
+}
+
+// Store the return addresses of the caller's stack, innermost first. Only
+// walks the unwind tables: no symbol lookup, locking or allocation.
+__attribute__((noinline)) inline size_t capture_backtrace(void** frames, size_t max) {
+    BacktraceState state{frames, 0, 1, max}; // skip capture_backtrace itself
+    _Unwind_Backtrace(backtrace_frame, &state);
+    return state.count;
+}
+#else
+inline size_t capture_backtrace(void**, size_t) {
+    return 0;
+}
+#endif
+
+// Whether this report takes a backtrace: every nth report of each thread
+inline bool sample_backtrace() {
+    const size_t rate = backtrace_sample_rate.load(std::memory_order_relaxed);
+    if (rate == 0) return false;
+    thread_local size_t reports = 0;
+    return reports++ % rate == 0;
+}
+
+// Append the captured frames: raw addresses when reporting on the allocating
+// thread, one symbolized frame per line when delivered by the drain thread
+inline size_t format_backtrace(char* buffer, size_t buffer_size, size_t size, const AllocationEvent& event,
+                               bool symbolize) {
+    for (size_t i = 0; i < event.frame_count && size + 1 < buffer_size; ++i) {
+        int length;
+        if (symbolize) {
+            length = std::snprintf(buffer + size, buffer_size - size, "\n    #%zu ", i);
+            if (length > 0) size = std::min(size + static_cast<size_t>(length), buffer_size - 1);
+            size += symbolize_frame(event.frames[i], buffer + size, buffer_size - size);
+        } else {
+            length = std::snprintf(buffer + size, buffer_size - size, i == 0 ? " [backtrace: %p" : " %p",
+                                   event.frames[i]);
+            if (length > 0) size = std::min(size + static_cast<size_t>(length), buffer_size - 1);
+        }
+    }
+    if (!symbolize && event.frame_count > 0) {
+        const int length = std::snprintf(buffer + size, buffer_size - size, "]");
+        if (length > 0) size = std::min(size + static_cast<size_t>(length), buffer_size - 1);
+    }
+    return size;
+}
+
+// Format a large-allocation report into buffer, returning its length
+inline size_t format_large_allocation(char* buffer, size_t buffer_size, const AllocationEvent& event,
+                                      bool with_origin) {
+    const double megabytes = event.bytes / (1024.0 * 1024.0);
+    int length = event.file && *event.file
+        ? std::snprintf(buffer, buffer_size,
+                        "[DEBUG] Large allocation detected: %zu bytes (%f MB) at %s:%d in function '%s'",
+                        event.bytes, megabytes, event.file, event.line, event.function)
+        : std::snprintf(buffer, buffer_size,
+                        "[DEBUG] Large allocation detected: %zu bytes (%f MB)", event.bytes, megabytes);
+    if (length < 0) return 0;
+    size_t size = std::min(static_cast<size_t>(length), buffer_size - 1);
+    if (event.operation) {
+        length = std::snprintf(buffer + size, buffer_size - size, " (%s)", event.operation);
+        if (length > 0) size = std::min(size + static_cast<size_t>(length), buffer_size - 1);
+    }
+    if (with_origin) {
+        // Delivered late and from another thread, so say where and when it happened
+        length = std::snprintf(buffer + size, buffer_size - size, " [thread %llu, %.6f s]",
+                               static_cast<unsigned long long>(event.thread_id),
+                               event.timestamp_ns / 1e9);
+        if (length > 0) size = std::min(size + static_cast<size_t>(length), buffer_size - 1);
+    }
+    return format_backtrace(buffer, buffer_size, size, event, with_origin);
+}
+
+inline std::atomic<size_t> async_dropped{0};
+
+// Bounded MPSC ring of events drained by a background thread (Vyukov's
+// sequence-numbered queue). Producers never block: a full ring drops the event.
+class AsyncOutput {
+public:
+    explicit AsyncOutput(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        cells_.reset(new Cell[size]);
+        mask_ = size - 1;
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        drain_thread_ = std::thread([this]() { drain(); });
+    }
+
+    ~AsyncOutput() {
+        stop_.store(true, std::memory_order_release);
+        drain_thread_.join();
+    }
+
+    AsyncOutput(const AsyncOutput&) = delete;
+    AsyncOutput& operator=(const AsyncOutput&) = delete;
+
+    bool push(const AllocationEvent& event) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                async_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->event = event;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Wait until every event queued before the call has been delivered
+    void flush() const {
+        const size_t target = enqueue_pos_.load(std::memory_order_acquire);
+        while (delivered_.load(std::memory_order_acquire) < target) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        AllocationEvent event;
+    };
+
+    bool pop(AllocationEvent& event) {
+        Cell& cell = cells_[dequeue_pos_ & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) return false;
+        event = cell.event;
+        cell.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+        ++dequeue_pos_;
+        return true;
+    }
+
+    void drain();
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) size_t dequeue_pos_ = 0; // drain thread only
+    std::atomic<size_t> delivered_{0};
+    std::atomic<bool> stop_{false};
+    std::thread drain_thread_;
+};
+
+inline std::atomic<AsyncOutput*> async_output{nullptr};
+inline std::atomic<size_t> async_producers{0}; // threads between load and push of async_output
+
+inline uint64_t current_thread_id() {
+    return static_cast<uint64_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+}
+
+// Report a large allocation: queue it in async mode, else format and hand it to the sink
+inline void report_large_allocation(size_t bytes, const char* file, int line, const char* function,
+                                    const char* operation = nullptr) {
+    AllocationEvent event;
+    event.bytes = bytes;
+    event.file = file;
+    event.function = function;
+    event.line = line;
+    event.thread_id = 0;
+    event.timestamp_ns = 0;
+    event.operation = operation;
+    event.frame_count = sample_backtrace() ? capture_backtrace(event.frames, BACKTRACE_MAX_FRAMES) : 0;
+    if (async_output.load(std::memory_order_relaxed)) {
+        async_producers.fetch_add(1);
+        if (AsyncOutput* async = async_output.load()) {
+            event.thread_id = current_thread_id();
+            event.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            async->push(event);
+            async_producers.fetch_sub(1);
+            return;
+        }
+        async_producers.fetch_sub(1);
+    }
+    char buffer[MESSAGE_BUFFER_SIZE];
+    const size_t size = format_large_allocation(buffer, sizeof(buffer), event, false);
+    ConfigReader config;
+    config->sink(std::string_view(buffer, size), config->sink_context);
+}
+
+inline void AsyncOutput::drain() {
+    AllocationEvent event;
+    char buffer[MESSAGE_BUFFER_SIZE];
+    for (;;) {
+        // stop_ is set once no producer is left, so when it was seen before a
+        // pop that found nothing, the ring is empty. Checked after the pop, an
+        // event pushed between the two would be lost.
+        const bool stopping = stop_.load(std::memory_order_acquire);
+        if (pop(event)) {
+            const size_t size = format_large_allocation(buffer, sizeof(buffer), event, true);
+            ConfigReader config;
+            config->sink(std::string_view(buffer, size), config->sink_context);
+            delivered_.fetch_add(1, std::memory_order_release);
+        } else if (stopping) {
+            return;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+} // namespace detail
+
+// Deliver reports from a background thread. Allocating threads only queue a
+// fixed-size event; the drain thread formats it and calls the sink, which must
+// therefore be safe to call from that thread. Events beyond capacity are dropped
+// and counted. Calling it again replaces the queue, delivering what it holds.
+// Call disable_async_output() before exit so that queued reports are delivered.
+inline void enable_async_output(size_t capacity = 1024) {
+    auto* async = new detail::AsyncOutput(capacity);
+    if (detail::AsyncOutput* previous = detail::async_output.exchange(async)) {
+        while (detail::async_producers.load() != 0) std::this_thread::yield();
+        delete previous;
+    }
+}
+
+// Go back to reporting on the allocating thread, after delivering queued events
+inline void disable_async_output() {
+    if (detail::AsyncOutput* previous = detail::async_output.exchange(nullptr)) {
+        while (detail::async_producers.load() != 0) std::this_thread::yield();
+        delete previous;
+    }
+}
+
+// Wait until every report queued so far has reached the sink
+inline void flush_async_output() {
+    detail::async_producers.fetch_add(1);
+    if (detail::AsyncOutput* async = detail::async_output.load()) async->flush();
+    detail::async_producers.fetch_sub(1);
+}
+
+// Number of reports dropped because the async queue was full, since startup
+inline size_t async_dropped_events() {
+    return detail::async_dropped.load(std::memory_order_relaxed);
+}
+
+// Allocation statistics of one callsite. Each DEBUG_ALLOC site owns a static
+// instance, and container members share one per caller location
+// (detail::callsite_at); either registers itself once in a global lock-free
+// list. Updates are relaxed atomics. Only requests are seen, not frees, so a
+// site has no live bytes; allocation_stats<Tag>() tracks those per allocator tag.
+class CallsiteStats {
+public:
+    CallsiteStats(const char* file, int line, const char* function)
+        : file_(file), function_(function), line_(line) {
+        next_ = registry().load(std::memory_order_relaxed);
+        while (!registry().compare_exchange_weak(next_, this, std::memory_order_release,
+                                                 std::memory_order_relaxed)) {}
+    }
+
+    CallsiteStats(const CallsiteStats&) = delete;
+    CallsiteStats& operator=(const CallsiteStats&) = delete;
+
+    void record(size_t bytes) {
+        count_.fetch_add(1, std::memory_order_relaxed);
+        total_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        size_t largest = max_request_bytes_.load(std::memory_order_relaxed);
+        while (bytes > largest &&
+               !max_request_bytes_.compare_exchange_weak(largest, bytes, std::memory_order_relaxed)) {}
+    }
+
+    void reset() {
+        count_.store(0, std::memory_order_relaxed);
+        total_bytes_.store(0, std::memory_order_relaxed);
+        max_request_bytes_.store(0, std::memory_order_relaxed);
+    }
+
+    const char* file() const { return file_; }
+    int line() const { return line_; }
+    const char* function() const { return function_; }
+    size_t count() const { return count_.load(std::memory_order_relaxed); }
+    size_t total_bytes() const { return total_bytes_.load(std::memory_order_relaxed); }
+    size_t max_request_bytes() const { return max_request_bytes_.load(std::memory_order_relaxed); }
+    const CallsiteStats* next() const { return next_; }
+
+    // Head of the list of every site reached so far
+    static std::atomic<CallsiteStats*>& registry() {
+        static std::atomic<CallsiteStats*> head{nullptr};
+        return head;
+    }
+
+private:
+    const char* file_;
+    const char* function_;
+    int line_;
+    std::atomic<size_t> count_{0};
+    std::atomic<size_t> total_bytes_{0};
+    std::atomic<size_t> max_request_bytes_{0}; // largest single request
+    CallsiteStats* next_ = nullptr;
+};
+
+// Copy of one site's counters
+struct CallsiteSnapshot {
+    const char* file;
+    int line;
+    const char* function;
+    size_t count;
+    size_t total_bytes;
+    size_t max_request_bytes; // largest single request, not a high-water mark of live bytes
+};
+
+// Counters of every site reached so far, in no particular order
+inline std::vector<CallsiteSnapshot> callsite_stats() {
+    std::vector<CallsiteSnapshot> snapshot;
+    for (const CallsiteStats* site = CallsiteStats::registry().load(std::memory_order_acquire);
+         site; site = site->next()) {
+        snapshot.push_back(CallsiteSnapshot{site->file(), site->line(), site->function(),
+                                            site->count(), site->total_bytes(), site->max_request_bytes()});
+    }
+    return snapshot;
+}
+
+// The n sites with the most requested bytes, largest first
+inline std::vector<CallsiteSnapshot> top_callsites(size_t n) {
+    std::vector<CallsiteSnapshot> snapshot = callsite_stats();
+    const auto by_total = [](const CallsiteSnapshot& a, const CallsiteSnapshot& b) {
+        return a.total_bytes > b.total_bytes;
+    };
+    if (n < snapshot.size()) {
+        std::partial_sort(snapshot.begin(), snapshot.begin() + n, snapshot.end(), by_total);
+        snapshot.resize(n);
+    } else {
+        std::sort(snapshot.begin(), snapshot.end(), by_total);
+    }
+    return snapshot;
+}
+
+namespace detail {
+
+inline bool same_text(const char* a, const char* b) {
+    return a == b || std::strcmp(a, b) == 0;
+}
+
+// Lookups of callsite_at() that had to compare file and function names
+inline std::atomic<size_t>& callsite_text_lookups() {
+    static std::atomic<size_t> lookups{0};
+    return lookups;
+}
+
+// The statistics of the caller a container member was called from, one
+// descriptor per (file, line, function) interned on first use, in static
+// storage so a new site allocates nothing. The hot path is a lock-free probe
+// keyed on the location's pointers and line. Only a key seen for the first
+// time compares text, under a lock, so the same line reached through the
+// string literals of several translation units still shares one descriptor.
+// Sites beyond the capacity share one row.
+inline CallsiteStats& callsite_at(const source_location& location) {
+    constexpr size_t table_size = 2048; // power of two
+    enum : int { EMPTY, BUILDING, READY };
+    struct Slot {
+        std::atomic<int> state;
+        const char* file;
+        const char* function;
+        int line;
+        CallsiteStats* site;
+    };
+    static Slot slots[table_size] = {};
+    alignas(CallsiteStats) static unsigned char storage[table_size][sizeof(CallsiteStats)];
+    static size_t site_count = 0; // guarded by intern_mutex
+    static std::mutex intern_mutex;
+    const auto overflow = []() -> CallsiteStats& {
+        static CallsiteStats site("(other callsites)", 0, "");
+        return site;
+    };
+
+    const char* file = location.file_name();
+    const char* function = location.function_name();
+    const int line = static_cast<int>(location.line());
+    size_t hash = reinterpret_cast<uintptr_t>(file) ^ (reinterpret_cast<uintptr_t>(function) << 1);
+    hash = (hash ^ static_cast<size_t>(line)) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+
+    for (size_t probe = 0; probe < table_size; ++probe) {
+        Slot& slot = slots[(hash + probe) & (table_size - 1)];
+        int state = slot.state.load(std::memory_order_acquire);
+        if (state == EMPTY &&
+            slot.state.compare_exchange_strong(state, BUILDING, std::memory_order_acquire)) {
+            // New key: reuse the descriptor of the same text, or make one
+            callsite_text_lookups().fetch_add(1, std::memory_order_relaxed);
+            CallsiteStats* site = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(intern_mutex);
+                for (size_t i = 0; i < site_count && !site; ++i) {
+                    auto* known = reinterpret_cast<CallsiteStats*>(storage[i]);
+                    if (known->line() == line && same_text(known->file(), file) &&
+                        same_text(known->function(), function)) {
+                        site = known;
+                    }
+                }
+                if (!site) {
+                    site = site_count < table_size
+                        ? new (storage[site_count++]) CallsiteStats(file, line, function)
+                        : &overflow();
+                }
+            }
+            slot.file = file;
+            slot.function = function;
+            slot.line = line;
+            slot.site = site;
+            slot.state.store(READY, std::memory_order_release);
+            return *site;
+        }
+        while (state == BUILDING) { // another thread is filling this slot in
+            std::this_thread::yield();
+            state = slot.state.load(std::memory_order_acquire);
+        }
+        if (slot.file == file && slot.function == function && slot.line == line) {
+            return *slot.site;
+        }
+    }
+    return overflow();
+}
+
+} // namespace detail
+
+// Zero the counters of every site
+inline void reset_callsite_stats() {
+    for (CallsiteStats* site = CallsiteStats::registry().load(std::memory_order_acquire);
+         site; site = const_cast<CallsiteStats*>(site->next())) {
+        site->reset();
+    }
 }
 
 // Function to set memory threshold
 inline void set_memory_threshold(size_t threshold) {
-    memory_threshold = threshold;
+    detail::publish_config([&](Config& config) { config.memory_threshold = threshold; });
 }
 
 // Function to get current memory threshold
 inline size_t get_memory_threshold() {
-    return memory_threshold;
+    return detail::current_threshold();
+}
+
+// Reallocations a vector or string may go through before it is reported when
+// destroyed (0 turns growth reports off)
+inline void set_growth_report_threshold(size_t reallocations) {
+    detail::publish_config([&](Config& config) { config.growth_report_threshold = reallocations; });
+}
+
+inline size_t get_growth_report_threshold() {
+    return detail::growth_report_threshold.load(std::memory_order_relaxed);
+}
+
+// Attach a backtrace to every nth large-allocation report of each thread
+// (1 = all of them, 0 = none). Capturing costs the allocating thread a stack
+// walk; symbolization waits for the async drain thread (enable_async_output),
+// and synchronous reports carry raw addresses for symbolize_frame().
+inline void set_backtrace_sampling(size_t every_nth) {
+    detail::publish_config([&](Config& config) { config.backtrace_sample_rate = every_nth; });
+}
+
+inline size_t get_backtrace_sampling() {
+    return detail::backtrace_sample_rate.load(std::memory_order_relaxed);
+}
+
+// Memory held through SimpleAllocator, as returned by allocation_stats()
+struct AllocationStats {
+    size_t live_bytes;
+    size_t peak_bytes;   // high-water mark of live_bytes
+    size_t allocations;
+    size_t deallocations;
+};
+
+// Live-byte and count tracking for SimpleAllocator, one set per Tag (void is
+// the global set). Each thread batches its changes in a thread_local and
+// merges them into the shared counters every FLUSH_BYTES bytes or
+// FLUSH_EVENTS calls, so threads do not contend on one cache line. The shared
+// figures therefore lag each thread by less than one batch. A batch also
+// carries its own high point, so the peak is exact for a single thread.
+// Define DEBUG_CONTAINERS_NO_ALLOCATION_COUNTERS to compile the counters out.
+template<typename Tag>
+class AllocationCounters {
+public:
+    static constexpr int64_t FLUSH_BYTES = 64 * 1024;
+    static constexpr size_t FLUSH_EVENTS = 256;
+
+    static void on_allocate(size_t bytes) {
+        Local& local = local_counters();
+        local.delta += static_cast<int64_t>(bytes);
+        local.peak_delta = std::max(local.peak_delta, local.delta);
+        ++local.allocations;
+        if (local.delta >= FLUSH_BYTES || ++local.events >= FLUSH_EVENTS) local.flush();
+    }
+
+    static void on_deallocate(size_t bytes) {
+        Local& local = local_counters();
+        local.delta -= static_cast<int64_t>(bytes);
+        ++local.deallocations;
+        if (local.delta <= -FLUSH_BYTES || ++local.events >= FLUSH_EVENTS) local.flush();
+    }
+
+    // Shared counters, after merging the calling thread's batch
+    static AllocationStats stats() {
+        local_counters().flush();
+        const Shared& shared = shared_counters();
+        const int64_t live = shared.live_bytes.load(std::memory_order_relaxed);
+        return AllocationStats{
+            static_cast<size_t>(std::max<int64_t>(live, 0)),
+            shared.peak_bytes.load(std::memory_order_relaxed),
+            shared.allocations.load(std::memory_order_relaxed),
+            shared.deallocations.load(std::memory_order_relaxed)};
+    }
+
+    // Restart the high-water mark from the current live bytes
+    static void reset_peak() {
+        local_counters().flush();
+        Shared& shared = shared_counters();
+        shared.peak_bytes.store(
+            static_cast<size_t>(std::max<int64_t>(shared.live_bytes.load(std::memory_order_relaxed), 0)),
+            std::memory_order_relaxed);
+    }
+
+private:
+    struct Shared {
+        alignas(64) std::atomic<int64_t> live_bytes{0};
+        std::atomic<size_t> peak_bytes{0};
+        std::atomic<size_t> allocations{0};
+        std::atomic<size_t> deallocations{0};
+    };
+
+    struct Local {
+        int64_t delta = 0;
+        int64_t peak_delta = 0; // highest delta since the last flush
+        size_t events = 0;
+        size_t allocations = 0;
+        size_t deallocations = 0;
+
+        void flush() {
+            Shared& shared = shared_counters();
+            if (allocations) shared.allocations.fetch_add(allocations, std::memory_order_relaxed);
+            if (deallocations) shared.deallocations.fetch_add(deallocations, std::memory_order_relaxed);
+            if (delta != 0 || peak_delta != 0) {
+                const int64_t high = shared.live_bytes.fetch_add(delta, std::memory_order_relaxed) + peak_delta;
+                size_t peak = shared.peak_bytes.load(std::memory_order_relaxed);
+                while (high > static_cast<int64_t>(peak) &&
+                       !shared.peak_bytes.compare_exchange_weak(
+                           peak, static_cast<size_t>(high), std::memory_order_relaxed)) {}
+            }
+            delta = peak_delta = 0;
+            events = allocations = deallocations = 0;
+        }
+
+        ~Local() { flush(); }
+    };
+
+    static Shared& shared_counters() {
+        static Shared shared;
+        return shared;
+    }
+
+    static Local& local_counters() {
+        thread_local Local local;
+        return local;
+    }
+};
+
+// SimpleAllocator counters: the global set, or those of one Tag
+template<typename Tag = void>
+inline AllocationStats allocation_stats() {
+    return AllocationCounters<Tag>::stats();
 }
 
-// Simple allocator that tracks allocations
-template<typename T>
+template<typename Tag = void>
+inline void reset_allocation_peak() {
+    AllocationCounters<Tag>::reset_peak();
+}
+
+#ifdef DEBUG_CONTAINERS_DISABLE
+
+// Untracked pass-through to std::allocator
+template<typename T, typename Tag = void>
+class SimpleAllocator : public std::allocator<T> {
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = SimpleAllocator<U, Tag>;
+    };
+
+    SimpleAllocator() = default;
+    template<typename U>
+    SimpleAllocator(const SimpleAllocator<U, Tag>&) noexcept {}
+};
+
+#else
+
+// Simple allocator that tracks allocations. Tag selects an extra set of
+// allocation counters, e.g. one per container type; the global set always counts.
+template<typename T, typename Tag = void>
 class SimpleAllocator {
 public:
     using value_type = T;
     
     template<typename U>
     struct rebind {
-        using other = SimpleAllocator<U>;
+        using other = SimpleAllocator<U, Tag>;
     };
 
     SimpleAllocator() = default;
     template<typename U>
-    SimpleAllocator(const SimpleAllocator<U>&) noexcept {}
+    SimpleAllocator(const SimpleAllocator<U, Tag>&) noexcept {}
 
     T* allocate(size_t n) {
         size_t bytes = n * sizeof(T);
-        
-        if (bytes > memory_threshold) {
-            std::string message = "[DEBUG] Large allocation detected: " + 
-                                 std::to_string(bytes) + " bytes (" + 
-                                 std::to_string(bytes / (1024.0 * 1024.0)) + " MB)";
-            output_stream(message);
+        if (bytes > detail::current_threshold()) {
+            detail::report_large_allocation(bytes, nullptr, 0, nullptr);
         }
         
-        return static_cast<T*>(std::malloc(bytes));
+        T* ptr = static_cast<T*>(std::malloc(bytes));
+#ifndef DEBUG_CONTAINERS_NO_ALLOCATION_COUNTERS
+        if (ptr) {
+            AllocationCounters<void>::on_allocate(bytes);
+            if constexpr (!std::is_void<Tag>::value) AllocationCounters<Tag>::on_allocate(bytes);
+        }
+#endif
+        return ptr;
     }
 
-    void deallocate(T* ptr, size_t) noexcept {
+    void deallocate(T* ptr, size_t n) noexcept {
+#ifndef DEBUG_CONTAINERS_NO_ALLOCATION_COUNTERS
+        if (ptr) {
+            AllocationCounters<void>::on_deallocate(n * sizeof(T));
+            if constexpr (!std::is_void<Tag>::value) AllocationCounters<Tag>::on_deallocate(n * sizeof(T));
+        }
+#else
+        (void)n;
+#endif
         std::free(ptr);
     }
 };
 
-template<typename T, typename U>
-bool operator==(const SimpleAllocator<T>&, const SimpleAllocator<U>&) noexcept {
+#endif // DEBUG_CONTAINERS_DISABLE
+
+template<typename T, typename U, typename Tag>
+bool operator==(const SimpleAllocator<T, Tag>&, const SimpleAllocator<U, Tag>&) noexcept {
     return true;
 }
 
-template<typename T, typename U>
-bool operator!=(const SimpleAllocator<T>& lhs, const SimpleAllocator<U>& rhs) noexcept {
+template<typename T, typename U, typename Tag>
+bool operator!=(const SimpleAllocator<T, Tag>& lhs, const SimpleAllocator<U, Tag>& rhs) noexcept {
     return !(lhs == rhs);
 }
 
+namespace detail {
+
+// Bytes of all pool slabs taken from malloc so far
+inline std::atomic<size_t> pool_reserved_bytes{0};
+
+// Free lists of same-size nodes, one per thread, refilled from whole slabs.
+// Slabs are never returned to malloc: a node may be freed on another thread
+// than the one that allocated it, and simply joins that thread's list. A list
+// that grows past LOCAL_CAP nodes spills a slab's worth to a shared list.
+// Threads refill from it, a slab's worth at a time, before they carve a new
+// slab, so nodes built on one thread and freed on another keep circulating
+// instead of piling up on the freeing thread. When a thread exits its whole
+// list moves to the shared list.
+template<size_t NodeSize, size_t NodeAlign>
+class NodePool {
+public:
+    static constexpr size_t SLAB_BYTES = 16 * 1024;
+    static constexpr size_t NODES_PER_SLAB = NodeSize < SLAB_BYTES ? SLAB_BYTES / NodeSize : 1;
+    static constexpr size_t LOCAL_CAP = 2 * NODES_PER_SLAB;
+
+    static void* allocate() {
+        Local& local = local_list();
+        if (!local.head) {
+            if (local.exited) return take_shared_or_slab();
+            local.head = take_shared_list(local.count);
+            if (!local.head) {
+                local.head = new_slab();
+                if (!local.head) return nullptr;
+                local.count = NODES_PER_SLAB;
+            }
+        }
+        FreeNode* node = local.head;
+        local.head = node->next;
+        --local.count;
+        return node;
+    }
+
+    static void deallocate(void* ptr) {
+        FreeNode* node = static_cast<FreeNode*>(ptr);
+        Local& local = local_list();
+        if (local.exited) {
+            give_shared_list(node, node, 1);
+            return;
+        }
+        node->next = local.head;
+        local.head = node;
+        if (++local.count > LOCAL_CAP) spill(local);
+    }
+
+private:
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    // Trivially destructible, so it stays usable after the exit hook has run
+    struct Local {
+        FreeNode* head;
+        size_t count;
+        bool exited;
+    };
+
+    // Hands the thread's list to the shared list when the thread exits
+    struct ExitHook {
+        ~ExitHook() {
+            Local& local = local_list();
+            local.exited = true;
+            if (local.head) {
+                give_shared_list(local.head, last_node(local.head), local.count);
+                local.head = nullptr;
+                local.count = 0;
+            }
+        }
+    };
+
+    struct Shared {
+        std::mutex mutex;
+        FreeNode* head = nullptr;
+        size_t count = 0;
+    };
+
+    static Local& local_list() {
+        thread_local Local local{nullptr, 0, false};
+        thread_local ExitHook hook;
+        (void)hook;
+        return local;
+    }
+
+    static Shared& shared_list() {
+        static Shared* shared = new Shared(); // never destroyed: static containers free nodes late
+        return *shared;
+    }
+
+    // Move the most recently freed slab's worth of nodes to the shared list.
+    // A list holds at most a slab's worth after a refill, so a spill follows
+    // at least that many frees and walking costs one step per node freed.
+    static void spill(Local& local) {
+        FreeNode* head = local.head;
+        FreeNode* tail = head;
+        for (size_t i = 1; i < NODES_PER_SLAB; ++i) tail = tail->next;
+        local.head = tail->next;
+        local.count -= NODES_PER_SLAB;
+        give_shared_list(head, tail, NODES_PER_SLAB);
+    }
+
+    // Take up to a slab's worth of nodes from the shared list, one step per node
+    // taken; the rest stays there for other threads
+    static FreeNode* take_shared_list(size_t& count) {
+        Shared& shared = shared_list();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        FreeNode* head = shared.head;
+        count = 0;
+        if (!head) return nullptr;
+        FreeNode* tail = head;
+        count = 1;
+        while (count < NODES_PER_SLAB && tail->next) {
+            tail = tail->next;
+            ++count;
+        }
+        shared.head = tail->next;
+        shared.count -= count;
+        tail->next = nullptr;
+        return head;
+    }
+
+    static void give_shared_list(FreeNode* head, FreeNode* tail, size_t count) {
+        Shared& shared = shared_list();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        tail->next = shared.head;
+        shared.head = head;
+        shared.count += count;
+    }
+
+    static void* take_shared_or_slab() {
+        Shared& shared = shared_list();
+        {
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if (FreeNode* node = shared.head) {
+                shared.head = node->next;
+                --shared.count;
+                return node;
+            }
+        }
+        // The rest of a slab taken after exit goes to the shared list
+        FreeNode* slab = new_slab();
+        if (slab && slab->next) give_shared_list(slab->next, last_node(slab), NODES_PER_SLAB - 1);
+        return slab;
+    }
+
+    static FreeNode* last_node(FreeNode* head) {
+        while (head->next) head = head->next;
+        return head;
+    }
+
+    // Carve a new slab into a linked list of nodes
+    static FreeNode* new_slab() {
+        const size_t bytes = NODES_PER_SLAB * NodeSize;
+        void* slab = NodeAlign > alignof(std::max_align_t)
+            ? std::aligned_alloc(NodeAlign, (bytes + NodeAlign - 1) / NodeAlign * NodeAlign)
+            : std::malloc(bytes);
+        if (!slab) return nullptr;
+        pool_reserved_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        char* base = static_cast<char*>(slab);
+        for (size_t i = 0; i < NODES_PER_SLAB; ++i) {
+            reinterpret_cast<FreeNode*>(base + i * NodeSize)->next =
+                i + 1 < NODES_PER_SLAB ? reinterpret_cast<FreeNode*>(base + (i + 1) * NodeSize) : nullptr;
+        }
+        return reinterpret_cast<FreeNode*>(base);
+    }
+};
+
+} // namespace detail
+
+// Total bytes of node slabs held by PoolAllocator pools
+inline size_t pool_reserved_bytes() {
+    return detail::pool_reserved_bytes.load(std::memory_order_relaxed);
+}
+
+// Pool allocator for node containers (map, set, list, unordered_*). Single
+// node requests come from per-thread free lists of same-size nodes, refilled
+// with whole slabs; other requests, such as hash bucket arrays, go to malloc.
+// Reporting and counters see the same requests as SimpleAllocator does.
+template<typename T, typename Tag = void>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = PoolAllocator<U, Tag>;
+    };
+
+    PoolAllocator() = default;
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U, Tag>&) noexcept {}
+
+    T* allocate(size_t n) {
+        size_t bytes = n * sizeof(T);
+#ifndef DEBUG_CONTAINERS_DISABLE
+        if (bytes > detail::current_threshold()) {
+            detail::report_large_allocation(bytes, nullptr, 0, nullptr);
+        }
+#endif
+
+        T* ptr = static_cast<T*>(n == 1 ? Pool::allocate() : std::malloc(bytes));
+        if (!ptr) throw std::bad_alloc();
+#ifndef DEBUG_CONTAINERS_NO_ALLOCATION_COUNTERS
+        AllocationCounters<void>::on_allocate(bytes);
+        if constexpr (!std::is_void<Tag>::value) AllocationCounters<Tag>::on_allocate(bytes);
+#endif
+        return ptr;
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        if (!ptr) return;
+#ifndef DEBUG_CONTAINERS_NO_ALLOCATION_COUNTERS
+        AllocationCounters<void>::on_deallocate(n * sizeof(T));
+        if constexpr (!std::is_void<Tag>::value) AllocationCounters<Tag>::on_deallocate(n * sizeof(T));
+#endif
+        if (n == 1) {
+            Pool::deallocate(ptr);
+        } else {
+            std::free(ptr);
+        }
+    }
+
+private:
+    static constexpr size_t NODE_ALIGN = alignof(T) > alignof(void*) ? alignof(T) : alignof(void*);
+    static constexpr size_t NODE_SIZE =
+        (std::max(sizeof(T), sizeof(void*)) + NODE_ALIGN - 1) / NODE_ALIGN * NODE_ALIGN;
+    using Pool = detail::NodePool<NODE_SIZE, NODE_ALIGN>;
+};
+
+template<typename T, typename U, typename Tag>
+bool operator==(const PoolAllocator<T, Tag>&, const PoolAllocator<U, Tag>&) noexcept {
+    return true;
+}
+
+template<typename T, typename U, typename Tag>
+bool operator!=(const PoolAllocator<T, Tag>& lhs, const PoolAllocator<U, Tag>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+#ifdef DEBUG_CONTAINERS_DISABLE
+
+// The size expression is not evaluated
+#define DEBUG_ALLOC(size) do { (void)sizeof(size); } while(0)
+#define DEBUG_ALLOC_AT(size, location, operation) do { (void)sizeof(size); } while(0)
+
+template<typename T, typename Alloc = std::allocator<T>>
+using vector = std::vector<T, Alloc>;
+
+template<typename CharT, typename Traits = std::char_traits<CharT>, typename Alloc = std::allocator<CharT>>
+using basic_string = std::basic_string<CharT, Traits, Alloc>;
+
+using string = std::string;
+using wstring = std::wstring;
+
+template<typename Key, typename T, typename Compare = std::less<Key>, typename Alloc = std::allocator<std::pair<const Key, T>>>
+using map = std::map<Key, T, Compare, Alloc>;
+
+template<typename Key, typename Compare = std::less<Key>, typename Alloc = std::allocator<Key>>
+using set = std::set<Key, Compare, Alloc>;
+
+template<typename Key, typename Compare = std::less<Key>, typename Alloc = std::allocator<Key>>
+using multiset = std::multiset<Key, Compare, Alloc>;
+
+template<typename Key, typename T, typename Compare = std::less<Key>, typename Alloc = std::allocator<std::pair<const Key, T>>>
+using multimap = std::multimap<Key, T, Compare, Alloc>;
+
+template<typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, T>>>
+using unordered_map = std::unordered_map<Key, T, Hash, Pred, Alloc>;
+
+template<typename Key, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>, typename Alloc = std::allocator<Key>>
+using unordered_set = std::unordered_set<Key, Hash, Pred, Alloc>;
+
+template<typename Key, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>, typename Alloc = std::allocator<Key>>
+using unordered_multiset = std::unordered_multiset<Key, Hash, Pred, Alloc>;
+
+template<typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, T>>>
+using unordered_multimap = std::unordered_multimap<Key, T, Hash, Pred, Alloc>;
+
+template<typename T, typename Alloc = std::allocator<T>>
+using list = std::list<T, Alloc>;
+
+template<typename T, typename Alloc = std::allocator<T>>
+using deque = std::deque<T, Alloc>;
+
+template<typename T, typename Container = std::deque<T>>
+using queue = std::queue<T, Container>;
+
+template<typename T, typename Container = std::deque<T>>
+using stack = std::stack<T, Container>;
+
+template<typename T, typename Container = std::vector<T>, typename Compare = std::less<typename Container::value_type>>
+using priority_queue = std::priority_queue<T, Container, Compare>;
+
+#else
+
 // Macro for container allocations - automatically captures file and line
 #define DEBUG_ALLOC(size) \
     do { \
-        if ((size) > Debug::memory_threshold) { \
-            std::string message = "[DEBUG] Large allocation detected: " + \
-                                 std::to_string(size) + " bytes (" + \
-                                 std::to_string((size) / (1024.0 * 1024.0)) + " MB) at " + \
-                                 std::string(__FILE__) + ":" + std::to_string(__LINE__) + \
-                                 " in function '" + std::string(__FUNCTION__) + "'"; \
-            Debug::output_stream(message); \
+        const size_t debug_alloc_bytes = (size); \
+        if (debug_alloc_bytes == 0) break; \
+        static Debug::CallsiteStats debug_alloc_site(__FILE__, __LINE__, __FUNCTION__); \
+        debug_alloc_site.record(debug_alloc_bytes); \
+        if (debug_alloc_bytes > Debug::detail::current_threshold()) { \
+            Debug::detail::report_large_allocation( \
+                debug_alloc_bytes, __FILE__, __LINE__, __FUNCTION__); \
+        } \
+    } while(0)
+
+// DEBUG_ALLOC for container members: statistics are kept per caller passed
+// in location, the report also names the member in operation
+#define DEBUG_ALLOC_AT(size, location, operation) \
+    do { \
+        const size_t debug_alloc_bytes = (size); \
+        if (debug_alloc_bytes == 0) break; \
+        Debug::detail::callsite_at(location).record(debug_alloc_bytes); \
+        if (debug_alloc_bytes > Debug::detail::current_threshold()) { \
+            Debug::detail::report_large_allocation(debug_alloc_bytes, (location).file_name(), \
+                static_cast<int>((location).line()), (location).function_name(), operation); \
         } \
     } while(0)
 
+namespace detail {
+
+template<typename It, typename = void>
+struct is_input_iterator : std::false_type {};
+
+template<typename It>
+struct is_input_iterator<It, std::enable_if_t<std::is_convertible<
+    typename std::iterator_traits<It>::iterator_category, std::input_iterator_tag>::value>>
+    : std::true_type {};
+
+template<typename It>
+using require_input_iterator = std::enable_if_t<is_input_iterator<It>::value>;
+
+// Arguments of the (count, ...) and (first, last, ...) constructors, which
+// have overloads of their own that take the caller's location
+template<typename... Args>
+struct is_counted_or_range : std::false_type {};
+
+template<typename First>
+struct is_counted_or_range<First> : std::is_integral<std::decay_t<First>> {};
+
+template<typename First, typename Second, typename... Rest>
+struct is_counted_or_range<First, Second, Rest...>
+    : std::integral_constant<bool, std::is_integral<std::decay_t<First>>::value ||
+          (std::is_same<std::decay_t<First>, std::decay_t<Second>>::value &&
+           is_input_iterator<std::decay_t<First>>::value)> {};
+
+// A lone argument of the container's own type, even a non-const lvalue, which
+// belongs to the copy and move constructors rather than the forwarding one
+template<typename Self, typename... Args>
+struct is_self : std::false_type {};
+
+template<typename Self, typename Arg>
+struct is_self<Self, Arg> : std::is_base_of<Self, std::decay_t<Arg>> {};
+
+} // namespace detail
+
+// Grow-and-copy cycles of one container instance
+struct GrowthStats {
+    size_t reallocations;  // growths that moved existing elements
+    size_t bytes_copied;   // bytes of the elements moved by those growths
+    size_t peak_size;      // largest size seen, the reserve() that avoids them
+};
+
+namespace detail {
+
+inline void report_growth(const char* container, size_t element_size, const GrowthStats& stats) {
+    char buffer[MESSAGE_BUFFER_SIZE];
+    const int length = std::snprintf(
+        buffer, sizeof(buffer),
+        "[DEBUG] Repeated reallocation detected: %s of %zu-byte elements, %zu reallocations, "
+        "%zu bytes copied, suggested reserve(%zu)",
+        container, element_size, stats.reallocations, stats.bytes_copied, stats.peak_size);
+    if (length < 0) return;
+    ConfigReader config;
+    config->sink(std::string_view(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1)),
+                 config->sink_context);
+}
+
+// Counts the reallocations of one vector or string caused by insertions and
+// resizes (not reserve()), and reports them when the container is destroyed
+class GrowthTracker {
+public:
+    // Call after an operation that may have grown the container
+    void update(size_t old_capacity, size_t old_size, size_t new_capacity, size_t new_size,
+                size_t element_size) {
+        if (new_capacity > old_capacity && old_size > 0) {
+            ++stats_.reallocations;
+            stats_.bytes_copied += old_size * element_size;
+        }
+        stats_.peak_size = std::max(stats_.peak_size, new_size);
+    }
+
+    const GrowthStats& stats() const { return stats_; }
+
+    void report(const char* container, size_t element_size) const {
+        if (stats_.reallocations == 0) return;
+        const size_t threshold = growth_report_threshold.load(std::memory_order_relaxed);
+        if (threshold != 0 && stats_.reallocations >= threshold) {
+            report_growth(container, element_size, stats_);
+        }
+    }
+
+private:
+    GrowthStats stats_{0, 0, 0};
+};
+
+} // namespace detail
+
 // Vector
 template<typename T, typename Alloc = SimpleAllocator<T>>
 class vector : public std::vector<T, Alloc> {
 public:
     using base_type = std::vector<T, Alloc>;
+    using typename base_type::value_type;
+    using typename base_type::size_type;
+    using typename base_type::reference;
+    using typename base_type::iterator;
+    using typename base_type::const_iterator;
     
     vector() : base_type() {}
-    vector(size_t count) : base_type(count) {
-        DEBUG_ALLOC(count * sizeof(T));
+    explicit vector(size_type count, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(count, alloc) {
+        DEBUG_ALLOC_AT(base_type::capacity() * sizeof(T), location, "vector::vector");
+    }
+    vector(size_type count, const T& value, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(count, value, alloc) {
+        DEBUG_ALLOC_AT(base_type::capacity() * sizeof(T), location, "vector::vector");
     }
-    vector(size_t count, const T& value) : base_type(count, value) {
-        DEBUG_ALLOC(count * sizeof(T));
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    vector(InputIt first, InputIt last, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(first, last, alloc) {
+        DEBUG_ALLOC_AT(base_type::capacity() * sizeof(T), location, "vector::vector");
     }
-    vector(const vector& other) : base_type(other) {}
-    vector(vector&& other) noexcept : base_type(std::move(other)) {}
+    vector(std::initializer_list<T> values, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(values, alloc) {
+        DEBUG_ALLOC_AT(base_type::capacity() * sizeof(T), location, "vector::vector");
+    }
+    // The other std::vector constructors
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_counted_or_range<Args...>::value &&
+        !detail::is_self<vector, Args...>::value>>
+    explicit vector(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::capacity() * sizeof(T));
+    }
+    vector(const vector& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::capacity() * sizeof(T), location, "vector::vector");
+    }
+    vector(vector&& other) noexcept
+        : base_type(std::move(other)), growth_(std::exchange(other.growth_, {})) {}
     
     vector& operator=(const vector& other) {
+        const Growth before = growth();
         base_type::operator=(other);
+        DEBUG_ALLOC(grown_bytes(before, false));
         return *this;
     }
     
-    vector& operator=(vector&& other) noexcept {
+    vector& operator=(vector&& other) noexcept(
+        std::is_nothrow_move_assignable<base_type>::value) {
+        if (this != &other) {
+            // The old buffer is released here, so its history ends here too
+            growth_.report("Debug::vector", sizeof(T));
+            growth_ = std::exchange(other.growth_, {});
+        }
         base_type::operator=(std::move(other));
         return *this;
     }
     
-    void resize(size_t count) {
-        DEBUG_ALLOC(count * sizeof(T));
+    vector& operator=(std::initializer_list<T> values) {
+        const Growth before = growth();
+        base_type::operator=(values);
+        DEBUG_ALLOC(grown_bytes(before, false));
+        return *this;
+    }
+    
+    void assign(size_type count, const T& value, source_location location = source_location::current()) {
+        const Growth before = growth();
+        base_type::assign(count, value);
+        DEBUG_ALLOC_AT(grown_bytes(before, false), location, "vector::assign");
+    }
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void assign(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const Growth before = growth();
+        base_type::assign(first, last);
+        DEBUG_ALLOC_AT(grown_bytes(before, false), location, "vector::assign");
+    }
+    
+    void assign(std::initializer_list<T> values, source_location location = source_location::current()) {
+        const Growth before = growth();
+        base_type::assign(values);
+        DEBUG_ALLOC_AT(grown_bytes(before, false), location, "vector::assign");
+    }
+    
+    void resize(size_t count, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(T), location, "vector::resize");
+        const Growth before = growth();
         base_type::resize(count);
+        grown_bytes(before, true);
     }
     
-    void resize(size_t count, const T& value) {
-        DEBUG_ALLOC(count * sizeof(T));
+    void resize(size_t count, const T& value, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(T), location, "vector::resize");
+        const Growth before = growth();
         base_type::resize(count, value);
+        grown_bytes(before, true);
     }
     
-    void reserve(size_t new_cap) {
-        DEBUG_ALLOC(new_cap * sizeof(T));
+    void reserve(size_t new_cap, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(new_cap * sizeof(T), location, "vector::reserve");
         base_type::reserve(new_cap);
     }
+    
+    ~vector() {
+        growth_.report("Debug::vector", sizeof(T));
+    }
+    
+    void push_back(const T& value, source_location location = source_location::current()) {
+        const Growth before = growth();
+        base_type::push_back(value);
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "vector::push_back");
+    }
+    
+    void push_back(T&& value, source_location location = source_location::current()) {
+        const Growth before = growth();
+        base_type::push_back(std::move(value));
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "vector::push_back");
+    }
+    
+    template<typename... Args>
+    reference emplace_back(Args&&... args) {
+        const Growth before = growth();
+        reference element = base_type::emplace_back(std::forward<Args>(args)...);
+        DEBUG_ALLOC(grown_bytes(before, true));
+        return element;
+    }
+    
+    template<typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+        const Growth before = growth();
+        iterator it = base_type::emplace(pos, std::forward<Args>(args)...);
+        DEBUG_ALLOC(grown_bytes(before, true));
+        return it;
+    }
+    
+    iterator insert(const_iterator pos, const T& value, source_location location = source_location::current()) {
+        const Growth before = growth();
+        iterator it = base_type::insert(pos, value);
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "vector::insert");
+        return it;
+    }
+    
+    iterator insert(const_iterator pos, T&& value, source_location location = source_location::current()) {
+        const Growth before = growth();
+        iterator it = base_type::insert(pos, std::move(value));
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "vector::insert");
+        return it;
+    }
+    
+    iterator insert(const_iterator pos, size_type count, const T& value, source_location location = source_location::current()) {
+        const Growth before = growth();
+        iterator it = base_type::insert(pos, count, value);
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "vector::insert");
+        return it;
+    }
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    iterator insert(const_iterator pos, InputIt first, InputIt last, source_location location = source_location::current()) {
+        const Growth before = growth();
+        iterator it = base_type::insert(pos, first, last);
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "vector::insert");
+        return it;
+    }
+    
+    iterator insert(const_iterator pos, std::initializer_list<T> values, source_location location = source_location::current()) {
+        const Growth before = growth();
+        iterator it = base_type::insert(pos, values);
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "vector::insert");
+        return it;
+    }
+    
+    // Reallocations caused by insertions and resizes since construction
+    const GrowthStats& growth_stats() const {
+        return growth_.stats();
+    }
+    
+private:
+    struct Growth {
+        size_t capacity;
+        size_t size;
+    };
+    
+    Growth growth() const {
+        return Growth{base_type::capacity(), base_type::size()};
+    }
+    
+    // Bytes of the new storage if the last operation grew it, else 0;
+    // count_growth adds the growth to the reallocation statistics
+    size_t grown_bytes(const Growth& before, bool count_growth) {
+        if (count_growth) {
+            growth_.update(before.capacity, before.size, base_type::capacity(), base_type::size(), sizeof(T));
+        }
+        return base_type::capacity() > before.capacity ? base_type::capacity() * sizeof(T) : 0;
+    }
+    
+    detail::GrowthTracker growth_;
 };
 
 // String
@@ -144,38 +1648,222 @@ template<typename CharT, typename Traits = std::char_traits<CharT>, typename All
 class basic_string : public std::basic_string<CharT, Traits, Alloc> {
 public:
     using base_type = std::basic_string<CharT, Traits, Alloc>;
+    using typename base_type::size_type;
+    using typename base_type::const_iterator;
     
     basic_string() : base_type() {}
-    basic_string(size_t count, CharT ch) : base_type(count, ch) {
-        DEBUG_ALLOC(count * sizeof(CharT));
+    basic_string(size_type count, CharT ch, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(count, ch, alloc) {
+        DEBUG_ALLOC_AT(heap_bytes(), location, "basic_string::basic_string");
+    }
+    basic_string(const CharT* chars, source_location location = source_location::current()) : base_type(chars) {
+        DEBUG_ALLOC_AT(heap_bytes(), location, "basic_string::basic_string");
+    }
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    basic_string(InputIt first, InputIt last, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(first, last, alloc) {
+        DEBUG_ALLOC_AT(heap_bytes(), location, "basic_string::basic_string");
+    }
+    basic_string(std::initializer_list<CharT> chars, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(chars, alloc) {
+        DEBUG_ALLOC_AT(heap_bytes(), location, "basic_string::basic_string");
+    }
+    // The other std::basic_string constructors
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_counted_or_range<Args...>::value &&
+        !detail::is_self<basic_string, Args...>::value>>
+    explicit basic_string(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(heap_bytes());
+    }
+    basic_string(const basic_string& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(heap_bytes(), location, "basic_string::basic_string");
     }
-    basic_string(const basic_string& other) : base_type(other) {}
-    basic_string(basic_string&& other) noexcept : base_type(std::move(other)) {}
+    basic_string(basic_string&& other) noexcept
+        : base_type(std::move(other)), growth_(std::exchange(other.growth_, {})) {}
     
     basic_string& operator=(const basic_string& other) {
+        const Growth before = growth();
         base_type::operator=(other);
+        DEBUG_ALLOC(grown_bytes(before, false));
         return *this;
     }
     
-    basic_string& operator=(basic_string&& other) noexcept {
+    basic_string& operator=(basic_string&& other) noexcept(
+        std::is_nothrow_move_assignable<base_type>::value) {
+        if (this != &other) {
+            // The old buffer is released here, so its history ends here too
+            growth_.report("Debug::basic_string", sizeof(CharT));
+            growth_ = std::exchange(other.growth_, {});
+        }
+        base_type::operator=(std::move(other));
+        return *this;
+    }
+    
+    // std::basic_string results, e.g. c = a + b
+    basic_string& operator=(const base_type& other) {
+        const Growth before = growth();
+        base_type::operator=(other);
+        DEBUG_ALLOC(grown_bytes(before, false));
+        return *this;
+    }
+    
+    basic_string& operator=(base_type&& other) noexcept(
+        std::is_nothrow_move_assignable<base_type>::value) {
+        if (this != &other) {
+            growth_.report("Debug::basic_string", sizeof(CharT));
+            growth_ = {};
+        }
+        const Growth before = growth();
         base_type::operator=(std::move(other));
+        DEBUG_ALLOC(grown_bytes(before, false));
+        return *this;
+    }
+    
+    // Characters, character arrays, string views and initializer lists
+    template<typename Arg, typename = std::enable_if_t<
+        !std::is_base_of<base_type, std::decay_t<Arg>>::value>>
+    basic_string& operator=(Arg&& arg) {
+        const Growth before = growth();
+        base_type::operator=(std::forward<Arg>(arg));
+        DEBUG_ALLOC(grown_bytes(before, false));
+        return *this;
+    }
+    
+    basic_string& operator=(std::initializer_list<CharT> chars) {
+        const Growth before = growth();
+        base_type::operator=(chars);
+        DEBUG_ALLOC(grown_bytes(before, false));
         return *this;
     }
     
-    void resize(size_t count) {
-        DEBUG_ALLOC(count * sizeof(CharT));
+    template<typename... Args>
+    basic_string& assign(Args&&... args) {
+        const Growth before = growth();
+        base_type::assign(std::forward<Args>(args)...);
+        DEBUG_ALLOC(grown_bytes(before, false));
+        return *this;
+    }
+    
+    basic_string& assign(std::initializer_list<CharT> chars, source_location location = source_location::current()) {
+        const Growth before = growth();
+        base_type::assign(chars);
+        DEBUG_ALLOC_AT(grown_bytes(before, false), location, "basic_string::assign");
+        return *this;
+    }
+    
+    void resize(size_t count, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(CharT), location, "basic_string::resize");
+        const Growth before = growth();
         base_type::resize(count);
+        grown_bytes(before, true);
     }
     
-    void resize(size_t count, CharT ch) {
-        DEBUG_ALLOC(count * sizeof(CharT));
+    void resize(size_t count, CharT ch, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(CharT), location, "basic_string::resize");
+        const Growth before = growth();
         base_type::resize(count, ch);
+        grown_bytes(before, true);
     }
     
-    void reserve(size_t new_cap) {
-        DEBUG_ALLOC(new_cap * sizeof(CharT));
+    void reserve(size_t new_cap, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(new_cap * sizeof(CharT), location, "basic_string::reserve");
         base_type::reserve(new_cap);
     }
+    
+    ~basic_string() {
+        growth_.report("Debug::basic_string", sizeof(CharT));
+    }
+    
+    void push_back(CharT ch, source_location location = source_location::current()) {
+        const Growth before = growth();
+        base_type::push_back(ch);
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "basic_string::push_back");
+    }
+    
+    template<typename... Args>
+    basic_string& append(Args&&... args) {
+        const Growth before = growth();
+        base_type::append(std::forward<Args>(args)...);
+        DEBUG_ALLOC(grown_bytes(before, true));
+        return *this;
+    }
+    
+    basic_string& append(std::initializer_list<CharT> chars, source_location location = source_location::current()) {
+        const Growth before = growth();
+        base_type::append(chars);
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "basic_string::append");
+        return *this;
+    }
+    
+    template<typename Arg>
+    basic_string& operator+=(Arg&& arg) {
+        const Growth before = growth();
+        base_type::operator+=(std::forward<Arg>(arg));
+        DEBUG_ALLOC(grown_bytes(before, true));
+        return *this;
+    }
+    
+    basic_string& operator+=(std::initializer_list<CharT> chars) {
+        const Growth before = growth();
+        base_type::operator+=(chars);
+        DEBUG_ALLOC(grown_bytes(before, true));
+        return *this;
+    }
+    
+    template<typename... Args>
+    decltype(auto) insert(Args&&... args) {
+        const Growth before = growth();
+        decltype(auto) result = base_type::insert(std::forward<Args>(args)...);
+        DEBUG_ALLOC(grown_bytes(before, true));
+        return result;
+    }
+    
+    auto insert(const_iterator pos, std::initializer_list<CharT> chars, source_location location = source_location::current()) {
+        const Growth before = growth();
+        auto it = base_type::insert(pos, chars);
+        DEBUG_ALLOC_AT(grown_bytes(before, true), location, "basic_string::insert");
+        return it;
+    }
+    
+    template<typename... Args>
+    basic_string& replace(Args&&... args) {
+        const Growth before = growth();
+        base_type::replace(std::forward<Args>(args)...);
+        DEBUG_ALLOC(grown_bytes(before, true));
+        return *this;
+    }
+    
+    // Reallocations caused by insertions and resizes since construction
+    const GrowthStats& growth_stats() const {
+        return growth_.stats();
+    }
+    
+private:
+    struct Growth {
+        size_t capacity;
+        size_t size;
+    };
+    
+    Growth growth() const {
+        return Growth{base_type::capacity(), base_type::size()};
+    }
+    
+    // Short strings live inside the object
+    size_t heap_bytes() const {
+        static const size_t inline_capacity = std::basic_string<CharT, Traits>().capacity();
+        return base_type::capacity() > inline_capacity ? (base_type::capacity() + 1) * sizeof(CharT) : 0;
+    }
+    
+    // Bytes of the new storage if the last operation grew it, else 0;
+    // count_growth adds the growth to the reallocation statistics
+    size_t grown_bytes(const Growth& before, bool count_growth) {
+        if (count_growth) {
+            growth_.update(before.capacity, before.size, base_type::capacity(), base_type::size(), sizeof(CharT));
+        }
+        return base_type::capacity() > before.capacity ? heap_bytes() : 0;
+    }
+    
+    detail::GrowthTracker growth_;
 };
 
 using string = basic_string<char>;
@@ -186,20 +1874,60 @@ template<typename Key, typename T, typename Compare = std::less<Key>, typename A
 class map : public std::map<Key, T, Compare, Alloc> {
 public:
     using base_type = std::map<Key, T, Compare, Alloc>;
+    using typename base_type::value_type;
     
     map() : base_type() {}
-    map(const map& other) : base_type(other) {}
-    map(map&& other) noexcept : base_type(std::move(other)) {}
+    map(std::initializer_list<value_type> values, source_location location = source_location::current()) : base_type(values) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "map::map");
+    }
+    // Every other std::map constructor
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<map, Args...>::value>>
+    explicit map(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    template<typename... Args,
+             typename = std::enable_if_t<std::is_constructible<base_type, std::initializer_list<value_type>, Args&&...>::value>>
+    map(std::initializer_list<value_type> values, Args&&... args) : base_type(values, std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    map(const map& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "map::map");
+    }
+    map(map&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     map& operator=(const map& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    map& operator=(map&& other) noexcept {
+    map& operator=(map&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
+    
+    map& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    using base_type::insert; // single elements and nodes
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void insert(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "map::insert");
+    }
+    
+    void insert(std::initializer_list<value_type> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "map::insert");
+    }
 };
 
 // Set
@@ -207,20 +1935,60 @@ template<typename Key, typename Compare = std::less<Key>, typename Alloc = Simpl
 class set : public std::set<Key, Compare, Alloc> {
 public:
     using base_type = std::set<Key, Compare, Alloc>;
+    using typename base_type::value_type;
     
     set() : base_type() {}
-    set(const set& other) : base_type(other) {}
-    set(set&& other) noexcept : base_type(std::move(other)) {}
+    set(std::initializer_list<value_type> values, source_location location = source_location::current()) : base_type(values) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "set::set");
+    }
+    // Every other std::set constructor
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<set, Args...>::value>>
+    explicit set(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    template<typename... Args,
+             typename = std::enable_if_t<std::is_constructible<base_type, std::initializer_list<value_type>, Args&&...>::value>>
+    set(std::initializer_list<value_type> values, Args&&... args) : base_type(values, std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    set(const set& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "set::set");
+    }
+    set(set&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     set& operator=(const set& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    set& operator=(set&& other) noexcept {
+    set& operator=(set&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
+    
+    set& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    using base_type::insert; // single elements and nodes
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void insert(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "set::insert");
+    }
+    
+    void insert(std::initializer_list<value_type> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "set::insert");
+    }
 };
 
 // Multiset
@@ -228,20 +1996,60 @@ template<typename Key, typename Compare = std::less<Key>, typename Alloc = Simpl
 class multiset : public std::multiset<Key, Compare, Alloc> {
 public:
     using base_type = std::multiset<Key, Compare, Alloc>;
+    using typename base_type::value_type;
     
     multiset() : base_type() {}
-    multiset(const multiset& other) : base_type(other) {}
-    multiset(multiset&& other) noexcept : base_type(std::move(other)) {}
+    multiset(std::initializer_list<value_type> values, source_location location = source_location::current()) : base_type(values) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "multiset::multiset");
+    }
+    // Every other std::multiset constructor
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<multiset, Args...>::value>>
+    explicit multiset(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    template<typename... Args,
+             typename = std::enable_if_t<std::is_constructible<base_type, std::initializer_list<value_type>, Args&&...>::value>>
+    multiset(std::initializer_list<value_type> values, Args&&... args) : base_type(values, std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    multiset(const multiset& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "multiset::multiset");
+    }
+    multiset(multiset&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     multiset& operator=(const multiset& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    multiset& operator=(multiset&& other) noexcept {
+    multiset& operator=(multiset&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
+    
+    multiset& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    using base_type::insert; // single elements and nodes
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void insert(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "multiset::insert");
+    }
+    
+    void insert(std::initializer_list<value_type> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "multiset::insert");
+    }
 };
 
 // Multimap
@@ -249,20 +2057,60 @@ template<typename Key, typename T, typename Compare = std::less<Key>, typename A
 class multimap : public std::multimap<Key, T, Compare, Alloc> {
 public:
     using base_type = std::multimap<Key, T, Compare, Alloc>;
+    using typename base_type::value_type;
     
     multimap() : base_type() {}
-    multimap(const multimap& other) : base_type(other) {}
-    multimap(multimap&& other) noexcept : base_type(std::move(other)) {}
+    multimap(std::initializer_list<value_type> values, source_location location = source_location::current()) : base_type(values) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "multimap::multimap");
+    }
+    // Every other std::multimap constructor
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<multimap, Args...>::value>>
+    explicit multimap(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    template<typename... Args,
+             typename = std::enable_if_t<std::is_constructible<base_type, std::initializer_list<value_type>, Args&&...>::value>>
+    multimap(std::initializer_list<value_type> values, Args&&... args) : base_type(values, std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    multimap(const multimap& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "multimap::multimap");
+    }
+    multimap(multimap&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     multimap& operator=(const multimap& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    multimap& operator=(multimap&& other) noexcept {
+    multimap& operator=(multimap&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
+    
+    multimap& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    using base_type::insert; // single elements and nodes
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void insert(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "multimap::insert");
+    }
+    
+    void insert(std::initializer_list<value_type> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "multimap::insert");
+    }
 };
 
 // Unordered Map
@@ -270,25 +2118,72 @@ template<typename Key, typename T, typename Hash = std::hash<Key>, typename Pred
 class unordered_map : public std::unordered_map<Key, T, Hash, Pred, Alloc> {
 public:
     using base_type = std::unordered_map<Key, T, Hash, Pred, Alloc>;
+    using typename base_type::value_type;
     
     unordered_map() : base_type() {}
-    unordered_map(const unordered_map& other) : base_type(other) {}
-    unordered_map(unordered_map&& other) noexcept : base_type(std::move(other)) {}
+    unordered_map(std::initializer_list<value_type> values, source_location location = source_location::current()) : base_type(values) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "unordered_map::unordered_map");
+    }
+    // Every other std::unordered_map constructor
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<unordered_map, Args...>::value>>
+    explicit unordered_map(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    template<typename... Args,
+             typename = std::enable_if_t<std::is_constructible<base_type, std::initializer_list<value_type>, Args&&...>::value>>
+    unordered_map(std::initializer_list<value_type> values, Args&&... args) : base_type(values, std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    unordered_map(const unordered_map& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "unordered_map::unordered_map");
+    }
+    unordered_map(unordered_map&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     unordered_map& operator=(const unordered_map& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    unordered_map& operator=(unordered_map&& other) noexcept {
+    unordered_map& operator=(unordered_map&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
     
-    void reserve(size_t count) {
-        DEBUG_ALLOC(count * sizeof(std::pair<const Key, T>));
+    unordered_map& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    using base_type::insert; // single elements and nodes
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void insert(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "unordered_map::insert");
+    }
+    
+    void insert(std::initializer_list<value_type> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "unordered_map::insert");
+    }
+    
+    void reserve(size_t count, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(value_type), location, "unordered_map::reserve");
         base_type::reserve(count);
     }
+    
+    void rehash(size_t count, source_location location = source_location::current()) {
+        const size_t before = base_type::bucket_count();
+        base_type::rehash(count);
+        DEBUG_ALLOC_AT(base_type::bucket_count() > before ? base_type::bucket_count() * sizeof(void*) : 0,
+                       location, "unordered_map::rehash");
+    }
 };
 
 // Unordered Set
@@ -296,25 +2191,72 @@ template<typename Key, typename Hash = std::hash<Key>, typename Pred = std::equa
 class unordered_set : public std::unordered_set<Key, Hash, Pred, Alloc> {
 public:
     using base_type = std::unordered_set<Key, Hash, Pred, Alloc>;
+    using typename base_type::value_type;
     
     unordered_set() : base_type() {}
-    unordered_set(const unordered_set& other) : base_type(other) {}
-    unordered_set(unordered_set&& other) noexcept : base_type(std::move(other)) {}
+    unordered_set(std::initializer_list<value_type> values, source_location location = source_location::current()) : base_type(values) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "unordered_set::unordered_set");
+    }
+    // Every other std::unordered_set constructor
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<unordered_set, Args...>::value>>
+    explicit unordered_set(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    template<typename... Args,
+             typename = std::enable_if_t<std::is_constructible<base_type, std::initializer_list<value_type>, Args&&...>::value>>
+    unordered_set(std::initializer_list<value_type> values, Args&&... args) : base_type(values, std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    unordered_set(const unordered_set& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "unordered_set::unordered_set");
+    }
+    unordered_set(unordered_set&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     unordered_set& operator=(const unordered_set& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    unordered_set& operator=(unordered_set&& other) noexcept {
+    unordered_set& operator=(unordered_set&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
     
-    void reserve(size_t count) {
-        DEBUG_ALLOC(count * sizeof(Key));
+    unordered_set& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    using base_type::insert; // single elements and nodes
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void insert(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "unordered_set::insert");
+    }
+    
+    void insert(std::initializer_list<value_type> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "unordered_set::insert");
+    }
+    
+    void reserve(size_t count, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(value_type), location, "unordered_set::reserve");
         base_type::reserve(count);
     }
+    
+    void rehash(size_t count, source_location location = source_location::current()) {
+        const size_t before = base_type::bucket_count();
+        base_type::rehash(count);
+        DEBUG_ALLOC_AT(base_type::bucket_count() > before ? base_type::bucket_count() * sizeof(void*) : 0,
+                       location, "unordered_set::rehash");
+    }
 };
 
 // Unordered Multiset
@@ -322,25 +2264,72 @@ template<typename Key, typename Hash = std::hash<Key>, typename Pred = std::equa
 class unordered_multiset : public std::unordered_multiset<Key, Hash, Pred, Alloc> {
 public:
     using base_type = std::unordered_multiset<Key, Hash, Pred, Alloc>;
+    using typename base_type::value_type;
     
     unordered_multiset() : base_type() {}
-    unordered_multiset(const unordered_multiset& other) : base_type(other) {}
-    unordered_multiset(unordered_multiset&& other) noexcept : base_type(std::move(other)) {}
+    unordered_multiset(std::initializer_list<value_type> values, source_location location = source_location::current()) : base_type(values) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "unordered_multiset::unordered_multiset");
+    }
+    // Every other std::unordered_multiset constructor
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<unordered_multiset, Args...>::value>>
+    explicit unordered_multiset(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    template<typename... Args,
+             typename = std::enable_if_t<std::is_constructible<base_type, std::initializer_list<value_type>, Args&&...>::value>>
+    unordered_multiset(std::initializer_list<value_type> values, Args&&... args) : base_type(values, std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    unordered_multiset(const unordered_multiset& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "unordered_multiset::unordered_multiset");
+    }
+    unordered_multiset(unordered_multiset&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     unordered_multiset& operator=(const unordered_multiset& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    unordered_multiset& operator=(unordered_multiset&& other) noexcept {
+    unordered_multiset& operator=(unordered_multiset&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
     
-    void reserve(size_t count) {
-        DEBUG_ALLOC(count * sizeof(Key));
+    unordered_multiset& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    using base_type::insert; // single elements and nodes
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void insert(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "unordered_multiset::insert");
+    }
+    
+    void insert(std::initializer_list<value_type> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "unordered_multiset::insert");
+    }
+    
+    void reserve(size_t count, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(value_type), location, "unordered_multiset::reserve");
         base_type::reserve(count);
     }
+    
+    void rehash(size_t count, source_location location = source_location::current()) {
+        const size_t before = base_type::bucket_count();
+        base_type::rehash(count);
+        DEBUG_ALLOC_AT(base_type::bucket_count() > before ? base_type::bucket_count() * sizeof(void*) : 0,
+                       location, "unordered_multiset::rehash");
+    }
 };
 
 // Unordered Multimap
@@ -348,25 +2337,72 @@ template<typename Key, typename T, typename Hash = std::hash<Key>, typename Pred
 class unordered_multimap : public std::unordered_multimap<Key, T, Hash, Pred, Alloc> {
 public:
     using base_type = std::unordered_multimap<Key, T, Hash, Pred, Alloc>;
+    using typename base_type::value_type;
     
     unordered_multimap() : base_type() {}
-    unordered_multimap(const unordered_multimap& other) : base_type(other) {}
-    unordered_multimap(unordered_multimap&& other) noexcept : base_type(std::move(other)) {}
+    unordered_multimap(std::initializer_list<value_type> values, source_location location = source_location::current()) : base_type(values) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "unordered_multimap::unordered_multimap");
+    }
+    // Every other std::unordered_multimap constructor
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<unordered_multimap, Args...>::value>>
+    explicit unordered_multimap(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    template<typename... Args,
+             typename = std::enable_if_t<std::is_constructible<base_type, std::initializer_list<value_type>, Args&&...>::value>>
+    unordered_multimap(std::initializer_list<value_type> values, Args&&... args) : base_type(values, std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    unordered_multimap(const unordered_multimap& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "unordered_multimap::unordered_multimap");
+    }
+    unordered_multimap(unordered_multimap&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     unordered_multimap& operator=(const unordered_multimap& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    unordered_multimap& operator=(unordered_multimap&& other) noexcept {
+    unordered_multimap& operator=(unordered_multimap&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
     
-    void reserve(size_t count) {
-        DEBUG_ALLOC(count * sizeof(std::pair<const Key, T>));
+    unordered_multimap& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    using base_type::insert; // single elements and nodes
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void insert(InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "unordered_multimap::insert");
+    }
+    
+    void insert(std::initializer_list<value_type> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        base_type::insert(values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "unordered_multimap::insert");
+    }
+    
+    void reserve(size_t count, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(value_type), location, "unordered_multimap::reserve");
         base_type::reserve(count);
     }
+    
+    void rehash(size_t count, source_location location = source_location::current()) {
+        const size_t before = base_type::bucket_count();
+        base_type::rehash(count);
+        DEBUG_ALLOC_AT(base_type::bucket_count() > before ? base_type::bucket_count() * sizeof(void*) : 0,
+                       location, "unordered_multimap::rehash");
+    }
 };
 
 // List
@@ -374,26 +2410,108 @@ template<typename T, typename Alloc = SimpleAllocator<T>>
 class list : public std::list<T, Alloc> {
 public:
     using base_type = std::list<T, Alloc>;
+    using typename base_type::value_type;
+    using typename base_type::size_type;
+    using typename base_type::iterator;
+    using typename base_type::const_iterator;
     
     list() : base_type() {}
-    list(size_t count) : base_type(count) {
-        DEBUG_ALLOC(count * sizeof(T));
+    explicit list(size_type count, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(count, alloc) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "list::list");
+    }
+    list(size_type count, const T& value, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(count, value, alloc) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "list::list");
+    }
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    list(InputIt first, InputIt last, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(first, last, alloc) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "list::list");
+    }
+    list(std::initializer_list<T> values, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(values, alloc) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "list::list");
     }
-    list(size_t count, const T& value) : base_type(count, value) {
-        DEBUG_ALLOC(count * sizeof(T));
+    // The other std::list constructors
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_counted_or_range<Args...>::value &&
+        !detail::is_self<list, Args...>::value>>
+    explicit list(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
     }
-    list(const list& other) : base_type(other) {}
-    list(list&& other) noexcept : base_type(std::move(other)) {}
+    list(const list& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "list::list");
+    }
+    list(list&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     list& operator=(const list& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    list& operator=(list&& other) noexcept {
+    list& operator=(list&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
+    
+    list& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    void assign(size_type count, const T& value, source_location location = source_location::current()) {
+        base_type::assign(count, value);
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "list::assign");
+    }
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void assign(InputIt first, InputIt last, source_location location = source_location::current()) {
+        base_type::assign(first, last);
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "list::assign");
+    }
+    
+    void assign(std::initializer_list<T> values, source_location location = source_location::current()) {
+        base_type::assign(values);
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "list::assign");
+    }
+    
+    void resize(size_t count, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(T), location, "list::resize");
+        base_type::resize(count);
+    }
+    
+    void resize(size_t count, const T& value, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(T), location, "list::resize");
+        base_type::resize(count, value);
+    }
+    
+    using base_type::insert; // single elements
+    
+    iterator insert(const_iterator pos, size_type count, const T& value, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        iterator it = base_type::insert(pos, count, value);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "list::insert");
+        return it;
+    }
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    iterator insert(const_iterator pos, InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        iterator it = base_type::insert(pos, first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "list::insert");
+        return it;
+    }
+    
+    iterator insert(const_iterator pos, std::initializer_list<T> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        iterator it = base_type::insert(pos, values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "list::insert");
+        return it;
+    }
 };
 
 // Deque
@@ -401,36 +2519,108 @@ template<typename T, typename Alloc = SimpleAllocator<T>>
 class deque : public std::deque<T, Alloc> {
 public:
     using base_type = std::deque<T, Alloc>;
+    using typename base_type::value_type;
+    using typename base_type::size_type;
+    using typename base_type::iterator;
+    using typename base_type::const_iterator;
     
     deque() : base_type() {}
-    deque(size_t count) : base_type(count) {
-        DEBUG_ALLOC(count * sizeof(T));
+    explicit deque(size_type count, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(count, alloc) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "deque::deque");
+    }
+    deque(size_type count, const T& value, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(count, value, alloc) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "deque::deque");
     }
-    deque(size_t count, const T& value) : base_type(count, value) {
-        DEBUG_ALLOC(count * sizeof(T));
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    deque(InputIt first, InputIt last, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(first, last, alloc) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "deque::deque");
     }
-    deque(const deque& other) : base_type(other) {}
-    deque(deque&& other) noexcept : base_type(std::move(other)) {}
+    deque(std::initializer_list<T> values, const Alloc& alloc = Alloc(), source_location location = source_location::current())
+        : base_type(values, alloc) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "deque::deque");
+    }
+    // The other std::deque constructors
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_counted_or_range<Args...>::value &&
+        !detail::is_self<deque, Args...>::value>>
+    explicit deque(Args&&... args) : base_type(std::forward<Args>(args)...) {
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+    }
+    deque(const deque& other, source_location location = source_location::current()) : base_type(other) {
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "deque::deque");
+    }
+    deque(deque&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     deque& operator=(const deque& other) {
         base_type::operator=(other);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
         return *this;
     }
     
-    deque& operator=(deque&& other) noexcept {
+    deque& operator=(deque&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
     
-    void resize(size_t count) {
-        DEBUG_ALLOC(count * sizeof(T));
+    deque& operator=(std::initializer_list<value_type> values) {
+        base_type::operator=(values);
+        DEBUG_ALLOC(base_type::size() * sizeof(value_type));
+        return *this;
+    }
+    
+    void assign(size_type count, const T& value, source_location location = source_location::current()) {
+        base_type::assign(count, value);
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "deque::assign");
+    }
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    void assign(InputIt first, InputIt last, source_location location = source_location::current()) {
+        base_type::assign(first, last);
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "deque::assign");
+    }
+    
+    void assign(std::initializer_list<T> values, source_location location = source_location::current()) {
+        base_type::assign(values);
+        DEBUG_ALLOC_AT(base_type::size() * sizeof(value_type), location, "deque::assign");
+    }
+    
+    void resize(size_t count, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(T), location, "deque::resize");
         base_type::resize(count);
     }
     
-    void resize(size_t count, const T& value) {
-        DEBUG_ALLOC(count * sizeof(T));
+    void resize(size_t count, const T& value, source_location location = source_location::current()) {
+        DEBUG_ALLOC_AT(count * sizeof(T), location, "deque::resize");
         base_type::resize(count, value);
     }
+    
+    using base_type::insert; // single elements
+    
+    iterator insert(const_iterator pos, size_type count, const T& value, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        iterator it = base_type::insert(pos, count, value);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "deque::insert");
+        return it;
+    }
+    
+    template<typename InputIt, typename = detail::require_input_iterator<InputIt>>
+    iterator insert(const_iterator pos, InputIt first, InputIt last, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        iterator it = base_type::insert(pos, first, last);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "deque::insert");
+        return it;
+    }
+    
+    iterator insert(const_iterator pos, std::initializer_list<T> values, source_location location = source_location::current()) {
+        const size_t before = base_type::size();
+        iterator it = base_type::insert(pos, values);
+        DEBUG_ALLOC_AT((base_type::size() - before) * sizeof(value_type), location, "deque::insert");
+        return it;
+    }
 };
 
 // Queue (wrapper around deque)
@@ -440,15 +2630,20 @@ public:
     using base_type = std::queue<T, Container>;
     
     queue() : base_type() {}
+    // Every std::queue constructor; the container reports its own allocations
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<queue, Args...>::value>>
+    explicit queue(Args&&... args) : base_type(std::forward<Args>(args)...) {}
     queue(const queue& other) : base_type(other) {}
-    queue(queue&& other) noexcept : base_type(std::move(other)) {}
+    queue(queue&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     queue& operator=(const queue& other) {
         base_type::operator=(other);
         return *this;
     }
     
-    queue& operator=(queue&& other) noexcept {
+    queue& operator=(queue&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
@@ -461,15 +2656,20 @@ public:
     using base_type = std::stack<T, Container>;
     
     stack() : base_type() {}
+    // Every std::stack constructor; the container reports its own allocations
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<stack, Args...>::value>>
+    explicit stack(Args&&... args) : base_type(std::forward<Args>(args)...) {}
     stack(const stack& other) : base_type(other) {}
-    stack(stack&& other) noexcept : base_type(std::move(other)) {}
+    stack(stack&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     stack& operator=(const stack& other) {
         base_type::operator=(other);
         return *this;
     }
     
-    stack& operator=(stack&& other) noexcept {
+    stack& operator=(stack&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
@@ -482,20 +2682,27 @@ public:
     using base_type = std::priority_queue<T, Container, Compare>;
     
     priority_queue() : base_type() {}
+    // Every std::priority_queue constructor; the container reports its own allocations
+    template<typename... Args, typename = std::enable_if_t<
+        std::is_constructible<base_type, Args&&...>::value && !detail::is_self<priority_queue, Args...>::value>>
+    explicit priority_queue(Args&&... args) : base_type(std::forward<Args>(args)...) {}
     priority_queue(const priority_queue& other) : base_type(other) {}
-    priority_queue(priority_queue&& other) noexcept : base_type(std::move(other)) {}
+    priority_queue(priority_queue&& other) noexcept(std::is_nothrow_move_constructible<base_type>::value)
+        : base_type(std::move(other)) {}
     
     priority_queue& operator=(const priority_queue& other) {
         base_type::operator=(other);
         return *this;
     }
     
-    priority_queue& operator=(priority_queue&& other) noexcept {
+    priority_queue& operator=(priority_queue&& other) noexcept(std::is_nothrow_move_assignable<base_type>::value) {
         base_type::operator=(std::move(other));
         return *this;
     }
 };
 
+#endif // DEBUG_CONTAINERS_DISABLE
+
 } // namespace Debug
 
 #endif // SIMPLE_DEBUG_CONTAINERS_HPP
\ No newline at end of file
@@ -0,0 +1,268 @@
+/**
+ * Hot-path counters of the memory-monitored KD-tree
+ *
+ * Compiled in with NANOFLANN_MONITOR_COUNTERS; otherwise MonitorCounters stays
+ * all zero and counting costs nothing. Each thread counts into its own slot of
+ * the tree, so queries and build tasks do not share cache lines; a snapshot
+ * sums the slots on demand.
+ *
+ * Usage:
+ *   // -DNANOFLANN_MONITOR_COUNTERS
+ *   const nanoflann::MonitorCounters counters = index.getCounters();
+ *   index.reportCounters(); // one line through the Debug:: output sink
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef NANOFLANN_MONITOR_COUNTERS
+#include <chrono>
+#endif
+
+namespace nanoflann {
+
+/**
+ * Snapshot of the counters of one tree, summed over threads
+ */
+struct MonitorCounters {
+    uint64_t queries = 0;              //!< findNeighbors() calls, batches included
+    uint64_t nodes_visited = 0;        //!< inner nodes and leaves entered by searches
+    uint64_t leaves_scanned = 0;
+    uint64_t distance_evaluations = 0; //!< point distances computed in leaves
+    uint64_t pruned_branches = 0;      //!< far children skipped by the distance bound
+    uint64_t splits = 0;               //!< inner nodes split by the build
+    uint64_t split_ns = 0;             //!< build time choosing and applying splits
+    uint64_t bbox_updates = 0;         //!< leaf box computations and child box merges
+    uint64_t bbox_ns = 0;              //!< build time in those updates
+    uint64_t probes = 0;               //!< MemoryMonitor RSS probes
+    uint64_t probe_ns = 0;             //!< time spent in those probes
+
+    /**
+     * One line for a log: totals and per-query averages
+     */
+    std::string format() const {
+        const double per_query = queries ? 1.0 / static_cast<double>(queries) : 0.0;
+        char buffer[512];
+        const int length = std::snprintf(
+            buffer, sizeof(buffer),
+            "[nanoflann] counters: %llu queries, %.1f nodes / %.1f leaves / %.1f distances / "
+            "%.1f pruned per query; build: %llu splits in %.3f ms, %llu box updates in %.3f ms; "
+            "%llu probes in %.3f ms",
+            static_cast<unsigned long long>(queries), nodes_visited * per_query,
+            leaves_scanned * per_query, distance_evaluations * per_query, pruned_branches * per_query,
+            static_cast<unsigned long long>(splits), split_ns * 1e-6,
+            static_cast<unsigned long long>(bbox_updates), bbox_ns * 1e-6,
+            static_cast<unsigned long long>(probes), probe_ns * 1e-6);
+        return length > 0 ? std::string(buffer, std::min<size_t>(length, sizeof(buffer) - 1)) : std::string();
+    }
+};
+
+#ifdef NANOFLANN_MONITOR_COUNTERS
+
+namespace detail {
+
+/**
+ * Counts of the query running on this thread, added to the tree's slot once
+ * the query returns
+ */
+struct QueryTally {
+    uint64_t nodes_visited;
+    uint64_t leaves_scanned;
+    uint64_t distance_evaluations;
+    uint64_t pruned_branches;
+};
+
+inline QueryTally& queryTally() {
+    thread_local QueryTally tally{};
+    return tally;
+}
+
+/**
+ * Counters of one thread. Only that thread writes them (relaxed load and
+ * store, no read-modify-write); snapshots read them from any thread.
+ */
+struct alignas(64) CounterSlot {
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> nodes_visited{0};
+    std::atomic<uint64_t> leaves_scanned{0};
+    std::atomic<uint64_t> distance_evaluations{0};
+    std::atomic<uint64_t> pruned_branches{0};
+    std::atomic<uint64_t> splits{0};
+    std::atomic<uint64_t> split_ns{0};
+    std::atomic<uint64_t> bbox_updates{0};
+    std::atomic<uint64_t> bbox_ns{0};
+    std::atomic<uint64_t> probes{0};
+    std::atomic<uint64_t> probe_ns{0};
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void addTo(MonitorCounters& out) const {
+        out.queries += queries.load(std::memory_order_relaxed);
+        out.nodes_visited += nodes_visited.load(std::memory_order_relaxed);
+        out.leaves_scanned += leaves_scanned.load(std::memory_order_relaxed);
+        out.distance_evaluations += distance_evaluations.load(std::memory_order_relaxed);
+        out.pruned_branches += pruned_branches.load(std::memory_order_relaxed);
+        out.splits += splits.load(std::memory_order_relaxed);
+        out.split_ns += split_ns.load(std::memory_order_relaxed);
+        out.bbox_updates += bbox_updates.load(std::memory_order_relaxed);
+        out.bbox_ns += bbox_ns.load(std::memory_order_relaxed);
+        out.probes += probes.load(std::memory_order_relaxed);
+        out.probe_ns += probe_ns.load(std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (std::atomic<uint64_t>* counter : {&queries, &nodes_visited, &leaves_scanned,
+                                               &distance_evaluations, &pruned_branches, &splits,
+                                               &split_ns, &bbox_updates, &bbox_ns, &probes, &probe_ns}) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+/**
+ * Per-thread counter slots of one tree. Each live set holds a small index,
+ * reused after the set is destroyed, into a thread_local table of slots, so a
+ * thread that alternates between trees (the sub-indices of a dynamic tree)
+ * finds its slot without locking. Only the first use of a set from a thread
+ * takes the mutex.
+ */
+class ThreadCounterSet {
+public:
+    ThreadCounterSet() : id_(nextId()), index_(acquireIndex()) {}
+    ~ThreadCounterSet() { releaseIndex(index_); }
+
+    ThreadCounterSet(const ThreadCounterSet&) = delete;
+    ThreadCounterSet& operator=(const ThreadCounterSet&) = delete;
+
+    CounterSlot& local() {
+        std::vector<CacheEntry>& cache = threadCache();
+        if (index_ < cache.size() && cache[index_].set_id == id_) return *cache[index_].slot;
+        return registerThread(cache);
+    }
+
+    void addTo(MonitorCounters& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : slots_) entry.second->addTo(out);
+    }
+
+    /**
+     * Zero every slot; counts of searches running meanwhile may survive
+     */
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : slots_) entry.second->reset();
+    }
+
+private:
+    // The set id tells a live set from an earlier one that had the same index
+    struct CacheEntry {
+        uint64_t set_id;
+        CounterSlot* slot;
+    };
+
+    struct IndexPool {
+        std::mutex mutex;
+        std::vector<size_t> free;
+        size_t next = 0;
+    };
+
+    static std::vector<CacheEntry>& threadCache() {
+        thread_local std::vector<CacheEntry> cache;
+        return cache;
+    }
+
+    static IndexPool& indexPool() {
+        static IndexPool* pool = new IndexPool(); // never destroyed: static trees release late
+        return *pool;
+    }
+
+    static size_t acquireIndex() {
+        IndexPool& pool = indexPool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (pool.free.empty()) return pool.next++;
+        const size_t index = pool.free.back();
+        pool.free.pop_back();
+        return index;
+    }
+
+    static void releaseIndex(size_t index) {
+        IndexPool& pool = indexPool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.free.push_back(index);
+    }
+
+    // Never 0, which marks an empty cache entry, and never reused by a later set
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    CounterSlot& registerThread(std::vector<CacheEntry>& cache) {
+        const std::thread::id self = std::this_thread::get_id();
+        CounterSlot* slot = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& entry : slots_) {
+                if (entry.first == self) slot = entry.second.get();
+            }
+            if (!slot) {
+                slots_.emplace_back(self, std::make_unique<CounterSlot>());
+                slot = slots_.back().second.get();
+            }
+        }
+        if (cache.size() <= index_) cache.resize(index_ + 1, CacheEntry{0, nullptr});
+        cache[index_] = CacheEntry{id_, slot};
+        return *slot;
+    }
+
+    const uint64_t id_;
+    const size_t index_;
+    mutable std::mutex mutex_;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<CounterSlot>>> slots_;
+};
+
+/**
+ * Adds the lifetime of a scope to a time counter and one to an event counter
+ */
+class CounterTimer {
+public:
+    CounterTimer(std::atomic<uint64_t>& events, std::atomic<uint64_t>& ns)
+        : events_(events), ns_(ns), start_(std::chrono::steady_clock::now()) {}
+
+    ~CounterTimer() {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        CounterSlot::bump(events_, 1);
+        CounterSlot::bump(ns_, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    CounterTimer(const CounterTimer&) = delete;
+    CounterTimer& operator=(const CounterTimer&) = delete;
+
+private:
+    std::atomic<uint64_t>& events_;
+    std::atomic<uint64_t>& ns_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace detail
+
+#define NANOFLANN_MONITOR_COUNT(field, n) (::nanoflann::detail::queryTally().field += (n))
+
+#else
+
+#define NANOFLANN_MONITOR_COUNT(field, n) ((void)0)
+
+#endif // NANOFLANN_MONITOR_COUNTERS
+
+} // namespace nanoflann
@@ -0,0 +1,467 @@
+/**
+ * Memory-monitored dynamic KD-tree index
+ *
+ * Points are added and removed without rebuilding the whole index, modeled on
+ * nanoflann's KDTreeSingleIndexDynamicAdaptor: a small insert buffer is searched
+ * linearly, and full buffers are merged into logarithmic sub-indices (level k
+ * holds up to insert_buffer_size << k points), so each point is rebuilt into a
+ * larger sub-index O(log n) times. Removed points are filtered out at search
+ * time and dropped when their sub-index is next rebuilt.
+ *
+ * All sub-indices share one memory budget. When a merge would exceed it, the
+ * eviction policy decides between rethrowing MemoryLimitExceededException and
+ * dropping or compacting the oldest sub-indices, so the newest points stay
+ * indexed.
+ *
+ * Usage:
+ *   // The dataset grows by appending points; the index keeps a reference to it
+ *   MemoryMonitoredKDTreeDynamic<Distance, DatasetAdaptor, DIM, IndexType>
+ *       index(dim, dataset, params, memory_threshold_bytes);
+ *   cloud.append(scan);
+ *   index.addPoints(first_new, cloud.size());
+ *   index.removePoint(stale);
+ *   index.knnSearch(query, k, indices, dists);
+ */
+
+#pragma once
+
+#include "nanoflann_memory_monitor.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace nanoflann {
+
+/**
+ * The metric Distance evaluated on another data source, for the standard
+ * nanoflann metric templates <T, DataSource, DistanceType, IndexType>
+ */
+template <class Distance, class DataSource>
+struct rebind_metric;
+
+template <template <class, class, class, class> class Metric,
+          class T, class OldDataSource, class DistanceType, class IndexType, class DataSource>
+struct rebind_metric<Metric<T, OldDataSource, DistanceType, IndexType>, DataSource> {
+    using type = Metric<T, DataSource, DistanceType, IndexType>;
+};
+
+/**
+ * What a dynamic index does when indexing new points would exceed its budget
+ */
+enum class DynamicEvictionPolicy {
+    Throw,       //!< Rethrow MemoryLimitExceededException; the new points stay in the insert buffer
+    DropOldest,  //!< Drop the oldest sub-index and retry, until the merge fits
+    MergeOldest  //!< Rebuild the oldest sub-index holding removed points without them; drop when none is left
+};
+
+/**
+ * Configuration of MemoryMonitoredKDTreeDynamic
+ */
+struct MemoryMonitoredDynamicParams {
+    MemoryMonitoredDynamicParams(
+        size_t _insert_buffer_size = 64,
+        DynamicEvictionPolicy _eviction = DynamicEvictionPolicy::Throw)
+        : insert_buffer_size(_insert_buffer_size),
+          eviction(_eviction) {}
+
+    size_t insert_buffer_size; //!< Points searched linearly before they are merged into a sub-index
+    DynamicEvictionPolicy eviction;
+};
+
+/**
+ * Memory-monitored dynamic KD-tree index over a growing dataset
+ */
+template<typename Distance, typename DatasetAdaptor, int32_t DIM = -1, typename IndexType = uint32_t>
+class MemoryMonitoredKDTreeDynamic {
+public:
+    using ElementType = typename Distance::ElementType;
+    using DistanceType = typename Distance::DistanceType;
+    using Size = size_t;
+    using Dimension = int32_t;
+
+    /**
+     * Points of one sub-index, as a dataset of their own: point i is ids[i]
+     */
+    struct SubsetAdaptor {
+        const DatasetAdaptor* dataset;
+        const IndexType* ids;
+        size_t count;
+
+        size_t kdtree_get_point_count() const { return count; }
+        ElementType kdtree_get_pt(const size_t idx, const size_t dim) const {
+            return dataset->kdtree_get_pt(ids[idx], dim);
+        }
+        template <class BBOX>
+        bool kdtree_get_bbox(BBOX& /*bb*/) const { return false; }
+    };
+
+    using SubIndex = MemoryMonitoredKDTree<
+        typename rebind_metric<Distance, SubsetAdaptor>::type, SubsetAdaptor, DIM, IndexType>;
+
+    /**
+     * Build over the points already in the dataset
+     */
+    explicit MemoryMonitoredKDTreeDynamic(
+        const Dimension dimensionality,
+        const DatasetAdaptor& inputData,
+        const KDTreeSingleIndexAdaptorParams& params,
+        size_t memory_threshold_bytes,
+        const MemoryMonitorParams& monitor_params = {},
+        const MemoryMonitoredBuildParams& build_params = {},
+        const MemoryMonitoredDynamicParams& dynamic_params = {})
+        : dataset_(inputData),
+          dim_(DIM > 0 ? DIM : dimensionality),
+          index_params_(params),
+          monitor_params_(monitor_params),
+          build_params_(build_params),
+          dynamic_params_(dynamic_params),
+          memory_monitor_(memory_threshold_bytes, monitor_params),
+          distance_(inputData) {
+        if (dim_ <= 0) {
+            throw std::runtime_error("Error: dimensionality cannot be zero");
+        }
+        dynamic_params_.insert_buffer_size = std::max<size_t>(dynamic_params_.insert_buffer_size, 1);
+        addPoints(0, dataset_.kdtree_get_point_count());
+    }
+
+    MemoryMonitoredKDTreeDynamic(const MemoryMonitoredKDTreeDynamic&) = delete;
+    MemoryMonitoredKDTreeDynamic& operator=(const MemoryMonitoredKDTreeDynamic&) = delete;
+
+    ~MemoryMonitoredKDTreeDynamic() {
+        memory_monitor_.releaseAccountedBytes(accounted_bytes_);
+    }
+
+    /**
+     * Index dataset points [begin, end), e.g. the points of a new scan. Points
+     * that are already indexed are skipped.
+     * @throws MemoryLimitExceededException with DynamicEvictionPolicy::Throw, or
+     *         when the new points alone do not fit the budget. Points added
+     *         before the failure stay searchable in the insert buffer; the
+     *         rest are not added.
+     */
+    void addPoints(const IndexType begin, const IndexType end) {
+        if (end > location_.size()) {
+            location_.resize(end, NOT_INDEXED);
+        }
+        for (IndexType id = begin; id < end; ++id) {
+            if (location_[id] != NOT_INDEXED) continue;
+            if (buffer_.empty()) buffer_oldest_ = next_stamp_;
+            ++next_stamp_;
+            buffer_.push_back(id);
+            location_[id] = IN_BUFFER;
+            ++size_;
+            if (buffer_.size() >= dynamic_params_.insert_buffer_size) {
+                indexBuffer();
+            }
+        }
+        updateAccounting();
+    }
+
+    /**
+     * Stop returning a point. Its sub-index is not rebuilt; the entry is
+     * skipped by searches and dropped when the sub-index is next merged.
+     */
+    void removePoint(const IndexType id) {
+        if (id >= location_.size() || location_[id] == NOT_INDEXED) return;
+        if (location_[id] == IN_BUFFER) {
+            buffer_.erase(std::find(buffer_.begin(), buffer_.end(), id));
+        } else {
+            ++levels_[static_cast<size_t>(location_[id])]->removed;
+        }
+        location_[id] = NOT_INDEXED;
+        --size_;
+    }
+
+    /**
+     * Search every sub-index and the insert buffer. Result indices are dataset indices.
+     */
+    template <typename RESULTSET>
+    bool findNeighbors(
+        RESULTSET& result, const ElementType* vec,
+        const MonitoredSearchParameters& searchParams = {}) const {
+        MonitoredSearchParameters sub_params = searchParams;
+        sub_params.sorted = false;
+        for (size_t k = 0; k < levels_.size(); ++k) {
+            const Level* level = levels_[k].get();
+            if (!level) continue;
+            SubsetResultSet<RESULTSET> sub_result{result, level->ids.data(), location_.data(),
+                                                  static_cast<int8_t>(k)};
+            level->index->findNeighbors(sub_result, vec, sub_params);
+        }
+        for (const IndexType id : buffer_) {
+            const DistanceType dist = distance_.evalMetric(vec, id, static_cast<size_t>(dim_));
+            if (dist < result.worstDist()) result.addPoint(dist, id);
+        }
+        if (searchParams.sorted) result.sort();
+        return result.full();
+    }
+
+    Size knnSearch(
+        const ElementType* query_point, const Size num_closest,
+        IndexType* out_indices, DistanceType* out_distances) const {
+        nanoflann::KNNResultSet<DistanceType, IndexType> resultSet(num_closest);
+        resultSet.init(out_indices, out_distances);
+        findNeighbors(resultSet, query_point);
+        return resultSet.size();
+    }
+
+    /**
+     * Number of points currently returned by searches
+     */
+    Size size() const {
+        return size_;
+    }
+
+    /**
+     * Whether searches can return dataset point id
+     */
+    bool isIndexed(const IndexType id) const {
+        return id < location_.size() && location_[id] != NOT_INDEXED;
+    }
+
+    /**
+     * Number of built sub-indices
+     */
+    size_t getSubIndexCount() const {
+        size_t count = 0;
+        for (const auto& level : levels_) count += level ? 1 : 0;
+        return count;
+    }
+
+    /**
+     * Points dropped by the eviction policy so far
+     */
+    size_t getEvictedCount() const {
+        return evicted_;
+    }
+
+    /**
+     * Bytes owned by all sub-indices, their id lists and the index bookkeeping
+     */
+    size_t getAccountedBytes() const {
+        return memory_monitor_.getAccountedBytes();
+    }
+
+    /**
+     * Combined budget of the sub-indices
+     */
+    const MemoryMonitor& getMemoryMonitor() const {
+        return memory_monitor_;
+    }
+
+    size_t getMemoryThreshold() const {
+        return memory_monitor_.getMemoryThreshold();
+    }
+
+private:
+    static constexpr int8_t NOT_INDEXED = -1;
+    static constexpr int8_t IN_BUFFER = -2;
+
+    struct Level {
+        std::vector<IndexType> ids; // dataset index of each point of the sub-index
+        SubsetAdaptor adaptor;      // referenced by index, so a Level never moves
+        std::unique_ptr<SubIndex> index;
+        uint64_t oldest = 0;        // insertion stamp of the oldest point
+        size_t removed = 0;         // points of ids removed since the build
+    };
+
+    /**
+     * Result set forwarding the hits of one sub-index with dataset indices,
+     * skipping points removed since the sub-index was built
+     */
+    template <typename RESULTSET>
+    struct SubsetResultSet {
+        RESULTSET& result;
+        const IndexType* ids;
+        const int8_t* location;
+        int8_t level;
+
+        bool addPoint(DistanceType dist, IndexType local) {
+            const IndexType id = ids[local];
+            if (location[id] != level) return true;
+            return result.addPoint(dist, id);
+        }
+        DistanceType worstDist() const { return result.worstDist(); }
+        bool full() const { return result.full(); }
+        void sort() {}
+    };
+
+    /**
+     * Bytes of a level other than its sub-index
+     */
+    static size_t idBytes(const Level& level) {
+        return level.ids.capacity() * sizeof(IndexType);
+    }
+
+    size_t levelBytes(const Level& level) const {
+        return idBytes(level) + level.index->getAccountedBytes();
+    }
+
+    /**
+     * Re-account every sub-index, id list and the bookkeeping in memory_monitor_
+     */
+    void updateAccounting() {
+        size_t bytes = buffer_.capacity() * sizeof(IndexType) + location_.capacity() * sizeof(int8_t);
+        for (const auto& level : levels_) {
+            if (level) bytes += levelBytes(*level);
+        }
+        memory_monitor_.releaseAccountedBytes(accounted_bytes_);
+        memory_monitor_.addAccountedBytes(bytes);
+        accounted_bytes_ = bytes;
+    }
+
+    /**
+     * Build a sub-index over ids within what is left of the budget. The ids
+     * are moved into the sub-index, and left in place if the build fails.
+     * @throws MemoryLimitExceededException if it does not fit
+     */
+    std::unique_ptr<Level> buildLevel(std::vector<IndexType>& ids, uint64_t oldest) {
+        updateAccounting();
+        const size_t id_bytes = ids.capacity() * sizeof(IndexType);
+        if (memory_monitor_.checkMemoryLimit(id_bytes)) {
+            memory_monitor_.throwLimitExceeded("while merging sub-indices", id_bytes);
+        }
+        // Tree-byte budgets are shared: the new sub-index gets what the others leave.
+        // Process RSS is shared anyway, so RSS budgets are passed on unchanged.
+        size_t threshold = memory_monitor_.getMemoryThreshold();
+        if (monitor_params_.accounting == MemoryAccountingMode::TreeBytes) {
+            threshold -= std::min(threshold, memory_monitor_.getAccountedBytes() + id_bytes);
+        }
+        auto level = std::make_unique<Level>();
+        level->ids = std::move(ids);
+        level->oldest = oldest;
+        level->adaptor = SubsetAdaptor{&dataset_, level->ids.data(), level->ids.size()};
+        try {
+            level->index = std::make_unique<SubIndex>(
+                dim_, level->adaptor, index_params_, threshold, monitor_params_, build_params_);
+        } catch (...) {
+            ids = std::move(level->ids);
+            throw;
+        }
+        return level;
+    }
+
+    /**
+     * Merge the insert buffer and the levels below the first free one into
+     * that level, evicting per the policy while it does not fit
+     */
+    void indexBuffer() {
+        for (;;) {
+            size_t pos = 0;
+            while (pos < levels_.size() && levels_[pos]) ++pos;
+            std::vector<IndexType> ids(buffer_.begin(), buffer_.end());
+            uint64_t oldest = buffer_oldest_;
+            for (size_t k = 0; k < pos; ++k) {
+                appendLive(*levels_[k], static_cast<int8_t>(k), ids);
+                oldest = std::min(oldest, levels_[k]->oldest);
+            }
+            std::unique_ptr<Level> merged;
+            try {
+                merged = buildLevel(ids, oldest);
+            } catch (const MemoryLimitExceededException&) {
+                if (!evictOldest()) {
+                    updateAccounting();
+                    throw;
+                }
+                continue;
+            }
+            if (pos == levels_.size()) levels_.emplace_back();
+            for (size_t k = 0; k < pos; ++k) levels_[k].reset();
+            for (const IndexType id : merged->ids) location_[id] = static_cast<int8_t>(pos);
+            levels_[pos] = std::move(merged);
+            buffer_.clear();
+            updateAccounting();
+            return;
+        }
+    }
+
+    /**
+     * Append the ids of a level that were not removed since its build
+     */
+    void appendLive(const Level& level, int8_t k, std::vector<IndexType>& ids) const {
+        for (const IndexType id : level.ids) {
+            if (location_[id] == k) ids.push_back(id);
+        }
+    }
+
+    /**
+     * Free budget by the eviction policy
+     * @return false if nothing could be freed
+     */
+    bool evictOldest() {
+        if (dynamic_params_.eviction == DynamicEvictionPolicy::Throw) return false;
+        size_t oldest = levels_.size();
+        size_t oldest_with_removed = levels_.size();
+        for (size_t k = 0; k < levels_.size(); ++k) {
+            if (!levels_[k]) continue;
+            if (oldest == levels_.size() || levels_[k]->oldest < levels_[oldest]->oldest) oldest = k;
+            if (levels_[k]->removed > 0 &&
+                (oldest_with_removed == levels_.size() ||
+                 levels_[k]->oldest < levels_[oldest_with_removed]->oldest)) {
+                oldest_with_removed = k;
+            }
+        }
+        if (oldest == levels_.size()) return false;
+
+        if (dynamic_params_.eviction == DynamicEvictionPolicy::MergeOldest &&
+            oldest_with_removed != levels_.size()) {
+            // Free the old sub-index first, so the rebuild only needs room for the live points
+            const int8_t k = static_cast<int8_t>(oldest_with_removed);
+            std::unique_ptr<Level> level = std::move(levels_[oldest_with_removed]);
+            std::vector<IndexType> live;
+            live.reserve(level->ids.size() - level->removed);
+            appendLive(*level, k, live);
+            const uint64_t stamp = level->oldest;
+            level.reset();
+            if (!live.empty()) {
+                try {
+                    levels_[oldest_with_removed] = buildLevel(live, stamp);
+                } catch (const MemoryLimitExceededException&) {
+                    dropIds(live);
+                }
+            }
+            updateAccounting();
+            return true;
+        }
+
+        std::unique_ptr<Level> level = std::move(levels_[oldest]);
+        std::vector<IndexType> live;
+        appendLive(*level, static_cast<int8_t>(oldest), live);
+        dropIds(live);
+        level.reset();
+        updateAccounting();
+        return true;
+    }
+
+    /**
+     * Mark live points as no longer indexed and count them as evicted
+     */
+    void dropIds(const std::vector<IndexType>& ids) {
+        for (const IndexType id : ids) {
+            location_[id] = NOT_INDEXED;
+        }
+        evicted_ += ids.size();
+        size_ -= ids.size();
+    }
+
+    const DatasetAdaptor& dataset_;
+    const Dimension dim_;
+    const KDTreeSingleIndexAdaptorParams index_params_;
+    const MemoryMonitorParams monitor_params_;
+    const MemoryMonitoredBuildParams build_params_;
+    MemoryMonitoredDynamicParams dynamic_params_;
+    MemoryMonitor memory_monitor_;
+    Distance distance_;
+
+    std::vector<std::unique_ptr<Level>> levels_; // level k: null or up to insert_buffer_size << k points
+    std::vector<IndexType> buffer_;              // indexed points not in a sub-index yet
+    std::vector<int8_t> location_;               // per dataset point: its level, IN_BUFFER or NOT_INDEXED
+    uint64_t buffer_oldest_ = 0;
+    uint64_t next_stamp_ = 0;
+    size_t size_ = 0;
+    size_t evicted_ = 0;
+    size_t accounted_bytes_ = 0; // added to memory_monitor_ by updateAccounting()
+};
+
+} // namespace nanoflann
@@ -18,6 +18,10 @@
  *   } catch (const MemoryLimitExceededException& e) {
  *       // Handle memory limit exceeded
  *   }
+ *
+ *   // Save once, then map the file read-only at startup
+ *   index.saveIndex("map.kdtree");
+ *   loaded.loadIndex("map.kdtree");
  */
 
 #pragma once
@@ -27,7 +31,37 @@
 #include <sys/time.h>
 #include <stdexcept>
 #include <functional>
+#include <cerrno>
 #include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include "simd_leaf_kernel.hpp"
+#include "monitor_counters.hpp"
+#ifdef NANOFLANN_MONITOR_COUNTERS
+#include "../container_debug/debug_containers.hpp"
+#endif
+#ifndef NANOFLANN_NO_THREADS
+#include <future>
+#include <mutex>
+#include "work_stealing_pool.hpp"
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+// saveIndex() and loadIndex() need POSIX files and mappings
+#define NANOFLANN_MAPPED_INDEX 1
+#endif
 
 namespace nanoflann {
 
@@ -49,40 +83,285 @@ public:
         : std::runtime_error(message) {}
 };
 
+/**
+ * What a MemoryMonitor compares against its threshold
+ */
+enum class MemoryAccountingMode {
+    ProcessRSS, //!< Sampled resident set size of the whole process
+    TreeBytes   //!< Bytes owned by the monitored tree, counted internally (no syscalls)
+};
+
+/**
+ * Where a memory pressure event comes from
+ */
+enum class MemoryPressureSource {
+    Build, //!< A budget check of the build (tree threshold)
+    Query  //!< A bounded search filling its result buffer (query_memory_limit)
+};
+
+/**
+ * Passed to the memory pressure callback of a MemoryMonitor
+ */
+struct MemoryPressureEvent {
+    MemoryPressureSource source;
+    size_t usage; //!< Build: monitored usage. Query: bytes of the search's results
+    size_t limit; //!< Build: tree threshold. Query: query_memory_limit
+    bool exceeded; //!< The limit was reached; otherwise usage crossed pressure_ratio of it
+};
+
+/**
+ * Called on the thread that observed the pressure: build workers of a
+ * concurrent build may call it at the same time
+ */
+using MemoryPressureCallback = std::function<void(const MemoryPressureEvent&)>;
+
+/**
+ * Probe configuration for MemoryMonitor.
+ *
+ * Reading the process RSS costs a syscall, so checks are sampled: a real probe
+ * happens every `check_interval` checks, or as soon as `check_bytes_interval`
+ * bytes were reported since the last probe, whichever comes first. Between
+ * probes the cached RSS plus the bytes reported since then is compared to the
+ * threshold. Setting both intervals to 1 probes on every check.
+ */
+struct MemoryMonitorParams {
+    MemoryMonitorParams(
+        size_t _check_interval = 256,
+        size_t _check_bytes_interval = 1024 * 1024,
+        MemoryAccountingMode _accounting = MemoryAccountingMode::ProcessRSS,
+        size_t _query_memory_limit = 0,
+        double _pressure_ratio = 0.9)
+        : check_interval(_check_interval),
+          check_bytes_interval(_check_bytes_interval),
+          accounting(_accounting),
+          query_memory_limit(_query_memory_limit),
+          pressure_ratio(_pressure_ratio) {}
+
+    size_t check_interval;       //!< Probe at least every N checks (0 = never by count)
+    size_t check_bytes_interval; //!< Probe after this many bytes since the last probe (0 = never by bytes)
+    MemoryAccountingMode accounting; //!< Process RSS or tree-owned bytes
+    size_t query_memory_limit; //!< Result bytes of one bounded search, separate from the build threshold (0 = unlimited)
+    double pressure_ratio; //!< Fraction of a limit at which the pressure callback is first called
+};
+
 /**
  * Memory monitoring utility class
+ *
+ * A monitor can also be created as a worker of another monitor for concurrent
+ * builds. A worker keeps its own probe state and a thread-local count of
+ * accounted bytes, and merges that count into the shared monitor's atomic
+ * counter every WORKER_MERGE_BYTES (or the merge_bytes it was created with),
+ * so each worker may overshoot a TreeBytes budget by at most that amount.
  */
 class MemoryMonitor {
+public:
+    static constexpr size_t WORKER_MERGE_BYTES = 8 * BLOCKSIZE;
+
 private:
     size_t memory_threshold_;
-    std::function<size_t()> memory_checker_;
+    MemoryMonitorParams params_;
+
+    // Probe state; mutable so that const checks can refresh the cache
+    mutable size_t cached_usage_ = 0;
+    mutable size_t checks_since_probe_ = 0;
+    mutable size_t bytes_since_probe_ = 0;
+    mutable size_t probe_count_ = 0;
+    mutable bool   cache_valid_ = false;
+
+    // Bytes reported through addAccountedBytes(), used in TreeBytes mode
+    std::atomic<size_t> accounted_bytes_{0};
+
+    // Set for worker monitors: the shared budget and the bytes not yet merged into it
+    MemoryMonitor* shared_ = nullptr;
+    size_t pending_bytes_ = 0;
+    size_t merge_bytes_ = WORKER_MERGE_BYTES;
+
+    int    statm_fd_ = -1;
+    size_t page_size_ = 4096;
+
+    // Pressure callback and the level last reported to it: 0 below pressure_ratio, 1 above, 2 over the limit
+    MemoryPressureCallback pressure_callback_;
+    mutable std::atomic<int> pressure_level_{0};
+
+#ifdef NANOFLANN_MONITOR_COUNTERS
+    detail::ThreadCounterSet* counters_ = nullptr; // of the owning tree, counts the probes
+#endif
     
 public:
-    explicit MemoryMonitor(size_t memory_threshold_bytes) 
-        : memory_threshold_(memory_threshold_bytes) {
-        
-        // Set up memory checking function based on available methods
+    explicit MemoryMonitor(
+        size_t memory_threshold_bytes,
+        const MemoryMonitorParams& params = {}) 
+        : memory_threshold_(memory_threshold_bytes), params_(params) {
         #ifdef __linux__
-            memory_checker_ = [this]() { return getCurrentMemoryUsageLinux(); };
-        #else
-            memory_checker_ = [this]() { return getCurrentMemoryUsageFallback(); };
+            // Keep the descriptor open so each probe is a single pread()
+            statm_fd_ = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+            const long page_size = ::sysconf(_SC_PAGESIZE);
+            if (page_size > 0) page_size_ = static_cast<size_t>(page_size);
+        #endif
+    }
+
+    /**
+     * Worker monitor drawing from the accounted bytes of shared_budget
+     * @param merge_bytes pending bytes that trigger a merge (0 = merge every change)
+     */
+    MemoryMonitor(MemoryMonitor& shared_budget, const MemoryMonitorParams& params,
+                  size_t merge_bytes = WORKER_MERGE_BYTES)
+        : MemoryMonitor(shared_budget.getMemoryThreshold(), params) {
+        shared_ = &shared_budget;
+        merge_bytes_ = merge_bytes;
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        counters_ = shared_budget.counters_;
+#endif
+    }
+
+    ~MemoryMonitor() {
+        flush();
+        #ifdef __linux__
+            if (statm_fd_ >= 0) ::close(statm_fd_);
         #endif
     }
+
+    MemoryMonitor(const MemoryMonitor&) = delete;
+    MemoryMonitor& operator=(const MemoryMonitor&) = delete;
     
     /**
      * Check if current memory usage exceeds threshold
+     * @param bytes_requested bytes about to be allocated (counts toward the byte interval)
+     * @param headroom bytes that must stay free below the threshold (not counted as allocated)
      * @return true if memory limit exceeded
      */
-    bool checkMemoryLimit() const {
-        return memory_checker_() > memory_threshold_;
+    bool checkMemoryLimit(size_t bytes_requested = 0, size_t headroom = 0) const {
+        size_t usage;
+        if (params_.accounting == MemoryAccountingMode::TreeBytes) {
+            usage = getAccountedBytes() + bytes_requested;
+        } else {
+            bytes_since_probe_ += bytes_requested;
+            const bool probe_due = !cache_valid_ ||
+                (params_.check_interval && ++checks_since_probe_ >= params_.check_interval) ||
+                (params_.check_bytes_interval && bytes_since_probe_ >= params_.check_bytes_interval);
+            if (probe_due) {
+                probe();
+            }
+            usage = cached_usage_ + bytes_since_probe_;
+        }
+        const MemoryMonitor& root = shared_ ? *shared_ : *this;
+        if (root.pressure_callback_) root.notePressure(usage);
+        return usage + headroom > memory_threshold_;
+    }
+
+    /**
+     * Set the callback that build checks and bounded searches report pressure
+     * to. Build checks call it when the usage first reaches pressure_ratio of
+     * the threshold and again when it exceeds the threshold; it is armed again
+     * once a check sees the usage back below. Set it before building or
+     * searching; worker monitors report to their shared monitor's callback.
+     */
+    void setPressureCallback(MemoryPressureCallback callback) {
+        pressure_callback_ = std::move(callback);
+        pressure_level_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Pass event to the pressure callback, if there is one
+     */
+    void reportPressure(const MemoryPressureEvent& event) const {
+        const MemoryMonitor& root = shared_ ? *shared_ : *this;
+        if (root.pressure_callback_) root.pressure_callback_(event);
     }
     
     /**
-     * Get current memory usage in bytes
-     * @return memory usage in bytes
+     * Get current memory usage in bytes (always performs a fresh probe)
+     * @return memory usage in bytes; the accounted bytes in TreeBytes mode
      */
     size_t getCurrentMemoryUsage() const {
-        return memory_checker_();
+        if (params_.accounting == MemoryAccountingMode::TreeBytes) {
+            return getAccountedBytes();
+        }
+        probe();
+        return cached_usage_;
+    }
+
+    /**
+     * Record bytes now owned by the monitored structure
+     */
+    void addAccountedBytes(size_t bytes) {
+        if (shared_) {
+            pending_bytes_ += bytes;
+            if (pending_bytes_ >= merge_bytes_) flush();
+            return;
+        }
+        accounted_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    /**
+     * Record bytes no longer owned by the monitored structure
+     */
+    void releaseAccountedBytes(size_t bytes) {
+        if (shared_) {
+            const size_t from_pending = std::min(bytes, pending_bytes_);
+            pending_bytes_ -= from_pending;
+            if (bytes > from_pending) shared_->releaseAccountedBytes(bytes - from_pending);
+            return;
+        }
+        size_t current = accounted_bytes_.load(std::memory_order_relaxed);
+        while (!accounted_bytes_.compare_exchange_weak(
+                   current, current - std::min(bytes, current), std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * Get bytes currently accounted to the monitored structure
+     */
+    size_t getAccountedBytes() const {
+        if (shared_) {
+            return shared_->getAccountedBytes() + pending_bytes_;
+        }
+        return accounted_bytes_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Merge a worker's pending bytes into the shared budget
+     */
+    void flush() {
+        if (shared_ && pending_bytes_) {
+            shared_->addAccountedBytes(pending_bytes_);
+            pending_bytes_ = 0;
+        }
+    }
+
+    /**
+     * Accounts bytes for the lifetime of a scope (e.g. temporary bounding boxes)
+     */
+    class ScopedBytes {
+    public:
+        ScopedBytes(MemoryMonitor& monitor, size_t bytes)
+            : monitor_(monitor), bytes_(bytes) {
+            monitor_.addAccountedBytes(bytes_);
+        }
+        ~ScopedBytes() {
+            monitor_.releaseAccountedBytes(bytes_);
+        }
+        ScopedBytes(const ScopedBytes&) = delete;
+        ScopedBytes& operator=(const ScopedBytes&) = delete;
+
+    private:
+        MemoryMonitor& monitor_;
+        size_t bytes_;
+    };
+
+    /**
+     * Get the memory usage seen by the last probe, without probing again
+     * @return cached memory usage in bytes
+     */
+    size_t getCachedMemoryUsage() const {
+        return cached_usage_;
+    }
+
+    /**
+     * Invalidate the cached usage so the next check probes unconditionally
+     */
+    void invalidate() const {
+        cache_valid_ = false;
     }
     
     /**
@@ -93,26 +372,94 @@ public:
         return memory_threshold_;
     }
 
+    /**
+     * Throw the exception for a failed limit check, with the current usage and
+     * the threshold
+     * @param what what was being done, e.g. "during tree division"
+     * @param required bytes the step needed, reported when nonzero
+     */
+    [[noreturn]] void throwLimitExceeded(const std::string& what, size_t required = 0) const {
+        std::string message = "Memory limit exceeded " + what + ". "
+            "Current: " + std::to_string(getCurrentMemoryUsage()) + " bytes";
+        if (required) message += ", Required: " + std::to_string(required) + " bytes";
+        message += ", Threshold: " + std::to_string(getMemoryThreshold()) + " bytes";
+        throw MemoryLimitExceededException(message);
+    }
+
+    /**
+     * Get number of real probes performed so far
+     */
+    size_t getProbeCount() const {
+        return probe_count_;
+    }
+
+    const MemoryMonitorParams& getParams() const {
+        return params_;
+    }
+
+    void setParams(const MemoryMonitorParams& params) {
+        params_ = params;
+        invalidate();
+    }
+
+#ifdef NANOFLANN_MONITOR_COUNTERS
+    /**
+     * Count and time the probes of this monitor in counters
+     */
+    void setCounters(detail::ThreadCounterSet* counters) {
+        counters_ = counters;
+    }
+#endif
+
 private:
     /**
-     * Get current memory usage on Linux systems using /proc/self/status
+     * Report a build usage that moved to a higher pressure level
+     */
+    void notePressure(size_t usage) const {
+        const int level = usage > memory_threshold_ ? 2
+            : usage >= params_.pressure_ratio * static_cast<double>(memory_threshold_) ? 1 : 0;
+        if (level == pressure_level_.load(std::memory_order_relaxed)) return;
+        if (pressure_level_.exchange(level, std::memory_order_relaxed) < level) {
+            pressure_callback_({MemoryPressureSource::Build, usage, memory_threshold_, level == 2});
+        }
+    }
+
+    void probe() const {
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        std::optional<detail::CounterTimer> timer;
+        if (counters_) {
+            detail::CounterSlot& slot = counters_->local();
+            timer.emplace(slot.probes, slot.probe_ns);
+        }
+#endif
+        #ifdef __linux__
+            cached_usage_ = getCurrentMemoryUsageLinux();
+        #else
+            cached_usage_ = getCurrentMemoryUsageFallback();
+        #endif
+        cache_valid_ = true;
+        checks_since_probe_ = 0;
+        bytes_since_probe_ = 0;
+        ++probe_count_;
+    }
+
+    /**
+     * Get current memory usage on Linux systems using /proc/self/statm
      * @return memory usage in bytes
      */
     size_t getCurrentMemoryUsageLinux() const {
         #ifdef __linux__
-        FILE* file = fopen("/proc/self/status", "r");
-        if (file) {
-            char line[128];
-            size_t vm_rss = 0;
-            
-            while (fgets(line, 128, file) != nullptr) {
-                if (strncmp(line, "VmRSS:", 6) == 0) {
-                    sscanf(line, "VmRSS: %zu", &vm_rss);
-                    break;
-                }
+        if (statm_fd_ >= 0) {
+            // statm: "size resident shared text lib data dt", in pages
+            char buf[128];
+            const ssize_t n = ::pread(statm_fd_, buf, sizeof(buf) - 1, 0);
+            if (n > 0) {
+                buf[n] = '\0';
+                char* p = buf;
+                std::strtoull(p, &p, 10);
+                const unsigned long long resident = std::strtoull(p, nullptr, 10);
+                return static_cast<size_t>(resident) * page_size_;
             }
-            fclose(file);
-            return vm_rss * 1024; // Convert KB to bytes
         }
         #endif
         
@@ -134,27 +481,75 @@ private:
 
 /**
  * Memory-monitored pooled allocator that checks memory limits
+ *
+ * The allocator mirrors PooledAllocator's block policy (WORDSIZE rounding,
+ * BLOCKSIZE blocks) so it knows exactly when a request takes a new block from
+ * the system. Only those block bytes are reported to the monitor.
  */
 template<typename BaseAllocator = PooledAllocator>
 class MemoryMonitoredAllocator : public BaseAllocator {
 private:
     MemoryMonitor* memory_monitor_;
+    size_t remaining_ = 0;   // mirror of the base allocator's free bytes in the current block
+    size_t owned_bytes_ = 0; // bytes of all blocks taken from the system
     
 public:
     explicit MemoryMonitoredAllocator(MemoryMonitor* monitor = nullptr) 
         : BaseAllocator(), memory_monitor_(monitor) {}
+
+    ~MemoryMonitoredAllocator() {
+        free_all();
+    }
     
     /**
      * Override malloc to check memory limits
+     * @param enforce_limit false to account a new block without checking it,
+     *        for nodes a degrading build has to add past the budget
      */
-    void* malloc(const size_t req_size) {
-        if (memory_monitor_ && memory_monitor_->checkMemoryLimit()) {
-            throw MemoryLimitExceededException(
-                "Memory limit exceeded during allocation. "
-                "Current: " + std::to_string(memory_monitor_->getCurrentMemoryUsage()) + 
-                " bytes, Threshold: " + std::to_string(memory_monitor_->getMemoryThreshold()) + " bytes");
+    void* malloc(const size_t req_size, const bool enforce_limit = true) {
+        const size_t size = (req_size + (WORDSIZE - 1)) & ~(WORDSIZE - 1);
+        const size_t block_bytes = size > remaining_
+            ? (size > BLOCKSIZE ? size + WORDSIZE : BLOCKSIZE + WORDSIZE)
+            : 0;
+        
+        if (enforce_limit && memory_monitor_ && memory_monitor_->checkMemoryLimit(block_bytes)) {
+            memory_monitor_->throwLimitExceeded("during allocation");
+        }
+        
+        void* mem = BaseAllocator::malloc(req_size);
+        if (block_bytes) {
+            remaining_ = block_bytes - WORDSIZE;
+            owned_bytes_ += block_bytes;
+            if (memory_monitor_) memory_monitor_->addAccountedBytes(block_bytes);
         }
-        return BaseAllocator::malloc(req_size);
+        remaining_ -= size;
+        return mem;
+    }
+
+    /**
+     * Release all blocks and their accounted bytes
+     */
+    void free_all() {
+        BaseAllocator::free_all();
+        if (memory_monitor_) memory_monitor_->releaseAccountedBytes(owned_bytes_);
+        owned_bytes_ = 0;
+        remaining_ = 0;
+    }
+
+    /**
+     * Get bytes of all blocks currently taken from the system
+     */
+    size_t getOwnedBytes() const {
+        return owned_bytes_;
+    }
+
+    /**
+     * Shadow BaseAllocator::allocate, which would otherwise bind to the
+     * unmonitored BaseAllocator::malloc
+     */
+    template <typename T>
+    T* allocate(const size_t count = 1, const bool enforce_limit = true) {
+        return static_cast<T*>(this->malloc(sizeof(T) * count, enforce_limit));
     }
     
     /**
@@ -165,17 +560,265 @@ public:
     }
 };
 
+/**
+ * How a multi-threaded build (n_thread_build != 1) schedules subtrees
+ */
+enum class ConcurrentBuildMode {
+    SpawnTasks,  //!< One std::async task per subtree while fewer than n_thread_build run
+    WorkStealing //!< Tasks on a fixed WorkStealingPool, reused across builds
+};
+
+/**
+ * What a build does when the memory budget runs out while dividing the tree
+ */
+enum class MemoryLimitPolicy {
+    Throw,        //!< Throw MemoryLimitExceededException and release the partial tree
+    LargerLeaves, //!< Stop splitting: remaining ranges become leaves, searches stay exact
+    Subsample     //!< Stop splitting and keep leaf_max_size points of each remaining range
+};
+
+/**
+ * How the build chooses the split dimension and value of an inner node
+ */
+enum class SplitRule {
+    Middle,          //!< nanoflann's middleSplit_: spread of every wide dimension, cut near the middle
+    Median,          //!< Widest box dimension, cut at the median with nth_element: balanced, no spread scan
+    SlidingMidpoint, //!< Midpoint of the widest box dimension, slid to the nearest point if one side is empty
+    Sampled          //!< middleSplit_ with spreads estimated from SPLIT_SAMPLE_POINTS points of the range
+};
+
+/**
+ * How far a build under a degrading MemoryLimitPolicy fell short of a full tree
+ */
+struct BuildDegradation {
+    size_t degraded_leaves = 0; //!< ranges made leaves because the budget was reached
+    size_t skipped_nodes = 0;   //!< nodes a full build would have added below them (estimate)
+    size_t dropped_points = 0;  //!< points left out of the tree (Subsample)
+    size_t max_leaf_size = 0;   //!< points in the largest leaf of the built tree
+    bool point_storage_skipped = false; //!< reorder_points / simd_leaves copy did not fit
+
+    bool degraded() const {
+        return degraded_leaves != 0 || point_storage_skipped;
+    }
+};
+
+/**
+ * Predicted bytes of a build, from MemoryMonitoredKDTree::estimateMemoryFootprint()
+ */
+struct MemoryFootprint {
+    size_t index_storage = 0;  //!< vAcc_ and the root bounding box
+    size_t nodes = 0;          //!< tree nodes: pooled linked nodes and/or the compact array
+    size_t pool_slack = 0;     //!< unused tails of PooledAllocator blocks
+    size_t bounding_boxes = 0; //!< child boxes alive on the recursion stacks
+    size_t point_storage = 0;  //!< reordered point copy (reorder_points / simd_leaves)
+
+    /**
+     * Peak bytes of the build
+     */
+    size_t total() const {
+        return index_storage + nodes + pool_slack + bounding_boxes + point_storage;
+    }
+};
+
+/**
+ * RadiusResultSet holding at most max_results matches. The search stops at
+ * the first match past that and truncated() turns true; the matches kept are
+ * the first ones the traversal reached, not the nearest. The vector's capacity
+ * does not grow past max_results.
+ */
+template <typename _DistanceType, typename _IndexType = size_t>
+class BoundedRadiusResultSet {
+public:
+    using DistanceType = _DistanceType;
+    using IndexType    = _IndexType;
+
+    const DistanceType radius;
+    const size_t max_results;
+    std::vector<ResultItem<IndexType, DistanceType>>& m_indices_dists;
+
+    BoundedRadiusResultSet(
+        DistanceType radius_, size_t max_results_,
+        std::vector<ResultItem<IndexType, DistanceType>>& indices_dists)
+        : radius(radius_), max_results(max_results_), m_indices_dists(indices_dists) {
+        init();
+    }
+
+    void   init() { clear(); }
+    void   clear() { m_indices_dists.clear(); truncated_ = false; }
+    size_t size() const { return m_indices_dists.size(); }
+    size_t empty() const { return m_indices_dists.empty(); }
+    bool   full() const { return true; }
+    bool   truncated() const { return truncated_; }
+
+    bool addPoint(DistanceType dist, IndexType index) {
+        if (dist >= radius) return true;
+        if (m_indices_dists.size() == max_results) {
+            truncated_ = true;
+            return false;
+        }
+        if (m_indices_dists.size() == m_indices_dists.capacity()) {
+            m_indices_dists.reserve(std::min(max_results, std::max<size_t>(2 * m_indices_dists.capacity(), 16)));
+        }
+        m_indices_dists.emplace_back(index, dist);
+        return true;
+    }
+
+    DistanceType worstDist() const { return radius; }
+
+    void sort() {
+        std::sort(m_indices_dists.begin(), m_indices_dists.end(), IndexDist_Sorter());
+    }
+
+private:
+    bool truncated_ = false;
+};
+
+/**
+ * Build configuration of the memory-monitored KD-tree
+ */
+struct MemoryMonitoredBuildParams {
+    MemoryMonitoredBuildParams(
+        ConcurrentBuildMode _concurrent_mode = ConcurrentBuildMode::SpawnTasks,
+        size_t _task_cutoff = 4096,
+        bool _simd_leaves = false,
+        bool _reorder_points = false,
+        bool _compact_nodes = false,
+        MemoryLimitPolicy _limit_policy = MemoryLimitPolicy::Throw,
+        bool _check_footprint = false,
+        SplitRule _split_rule = SplitRule::Middle)
+        : concurrent_mode(_concurrent_mode),
+          task_cutoff(_task_cutoff),
+          simd_leaves(_simd_leaves),
+          reorder_points(_reorder_points),
+          compact_nodes(_compact_nodes),
+          limit_policy(_limit_policy),
+          check_footprint(_check_footprint),
+          split_rule(_split_rule) {}
+
+    ConcurrentBuildMode concurrent_mode;
+    size_t task_cutoff; //!< WorkStealing: subtrees with more points than this become tasks
+    bool simd_leaves; //!< Scan leaves with the SIMD kernel (L2 metrics, DIM 2-4, SoA layout); implies reorder_points
+    bool reorder_points; //!< Copy the points into leaf order after the build and search that copy
+    bool compact_nodes; //!< Store the tree as one array of CompactNodes instead of linked nodes
+    MemoryLimitPolicy limit_policy; //!< Out of budget while dividing: throw, or degrade the tree to fit
+    bool check_footprint; //!< Reject a build whose estimated footprint exceeds the threshold before allocating
+    SplitRule split_rule; //!< Split heuristic of inner nodes; the tree stays exact with any of them
+#ifndef NANOFLANN_NO_THREADS
+    std::shared_ptr<WorkStealingPool> thread_pool; //!< WorkStealing: pool to use, created with n_thread_build threads if null
+#endif
+};
+
+/**
+ * Per-query settings of the memory-monitored KD-tree: nanoflann's
+ * SearchParameters plus how to walk the tree. They travel with each call, so
+ * nothing a running query reads changes under it. A plain SearchParameters
+ * converts to one with the defaults.
+ */
+struct MonitoredSearchParameters : public SearchParameters {
+    MonitoredSearchParameters(float eps_ = 0, bool sorted_ = true, bool iterative_ = true)
+        : SearchParameters(eps_, sorted_), iterative(iterative_) {}
+    MonitoredSearchParameters(const SearchParameters& params) : SearchParameters(params) {}
+
+    bool iterative = true; //!< Search with an explicit stack when the tree depth fits
+#ifndef NANOFLANN_NO_THREADS
+    WorkStealingPool* thread_pool = nullptr; //!< Batches: pool that runs the chunks, the tree's own if null
+#endif
+};
+
+/**
+ * Layout of the reordered point copy (MemoryMonitoredBuildParams::reorder_points)
+ */
+enum class PointStorageLayout {
+    AoS, //!< point i at [i * dim, (i + 1) * dim)
+    SoA  //!< coordinate d of point i at [d * size + i]
+};
+
+/**
+ * True for metrics whose evalMetric() is the sum of accum_dist() over the
+ * dimensions, so they can be evaluated on the reordered point copy
+ */
+template <class Distance>
+struct is_additive_metric : is_l2_metric<Distance> {};
+
+template <class T, class DataSource, typename DistanceType, typename IndexType>
+struct is_additive_metric<L1_Adaptor<T, DataSource, DistanceType, IndexType>> : std::true_type {};
+
+namespace detail {
+
+/**
+ * Header of a saved index file. Sections are addressed by offset from the start
+ * of the file, so the file can be mapped at any address.
+ */
+struct MappedIndexHeader {
+    static constexpr uint32_t MAGIC = 0x4d4d4b44u; // "DKMM"
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t HAS_POINTS = 1u;
+    static constexpr size_t ALIGNMENT = 64;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t index_bytes;    // sizeof(IndexType)
+    uint32_t element_bytes;  // sizeof(ElementType)
+    uint32_t distance_bytes; // sizeof(DistanceType)
+    uint32_t layout;         // PointStorageLayout of the points section
+    uint32_t flags;
+    uint32_t dim;
+    uint64_t size;           // indexed points
+    uint64_t node_count;     // CompactNode entries
+    uint64_t tree_depth;
+    uint64_t max_leaf_size;
+    uint64_t bbox_offset;
+    uint64_t nodes_offset;
+    uint64_t vacc_offset;
+    uint64_t points_offset;
+    uint64_t file_bytes;
+    uint64_t checksum;       // of the header with this field zero
+
+    static uint64_t align(uint64_t offset) {
+        return (offset + ALIGNMENT - 1) & ~uint64_t(ALIGNMENT - 1);
+    }
+
+    /**
+     * FNV-1a of the header bytes, checksum excluded
+     */
+    uint64_t computeChecksum() const {
+        MappedIndexHeader copy = *this;
+        copy.checksum = 0;
+        unsigned char bytes[sizeof(MappedIndexHeader)];
+        std::memcpy(bytes, &copy, sizeof(bytes));
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (unsigned char byte : bytes) {
+            hash = (hash ^ byte) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+};
+
+} // namespace detail
+
 /**
  * Memory-monitored KD-tree base class
  */
 template<typename Derived, typename Distance, typename DatasetAdaptor, 
-         int32_t DIM = -1, typename IndexType = uint32_t>
+         int32_t DIM = -1, typename IndexType = uint32_t,
+         PointStorageLayout Layout = PointStorageLayout::SoA>
 class MemoryMonitoredKDTreeBase 
     : public KDTreeBaseClass<Derived, Distance, DatasetAdaptor, DIM, IndexType> {
     
 protected:
+#ifdef NANOFLANN_MONITOR_COUNTERS
+    mutable detail::ThreadCounterSet counters_; // first, so it outlives the monitors counting into it
+#endif
     MemoryMonitor memory_monitor_;
     MemoryMonitoredAllocator<> monitored_pool_;
+    size_t index_storage_bytes_ = 0; // vAcc_ capacity + root bounding box, as accounted
+    MemoryMonitoredBuildParams build_params_;
+    std::vector<typename Distance::ElementType> point_storage_; // points in vAcc_ order, laid out as Layout
+    bool use_leaf_kernel_ = false;
+#ifndef NANOFLANN_NO_THREADS
+    struct WorkerArena;
+    std::vector<std::unique_ptr<WorkerArena>> worker_arenas_; // pools of concurrent build tasks
+#endif
     
 public:
     using Base = KDTreeBaseClass<Derived, Distance, DatasetAdaptor, DIM, IndexType>;
@@ -186,54 +829,497 @@ public:
     using typename Base::BoundingBox;
     using typename Base::ElementType;
     using typename Base::DistanceType;
+    using typename Base::Interval;
+
+    /**
+     * Node of the compact layout. The first child of an inner node follows it in
+     * the array and the second is stored by index. The split values keep
+     * DistanceType, so a node takes 16 bytes for float distances (32 for a
+     * linked node) and 24 for double distances (40 for a linked node).
+     */
+    struct CompactNode {
+        uint32_t first;  //!< leaf: COMPACT_LEAF_FLAG | first vAcc_ offset; inner: split dimension
+        uint32_t second; //!< leaf: one past the last vAcc_ offset; inner: index of the second child
+        DistanceType divlow, divhigh;
+    };
+    static constexpr uint32_t COMPACT_LEAF_FLAG = 0x80000000u;
+    static constexpr size_t COMPACT_GROWTH_STEP = 64; // nodes
+
+    /**
+     * Points SplitRule::Sampled reads per range to estimate the spreads; smaller
+     * ranges use middleSplit_
+     */
+    static constexpr size_t SPLIT_SAMPLE_POINTS = 64;
+
+    /**
+     * Deepest tree the iterative search handles; deeper trees fall back to recursion
+     */
+    static constexpr size_t SEARCH_STACK_SIZE = 16 * sizeof(IndexType);
+
+protected:
+    std::vector<CompactNode> compact_nodes_; // tree in compact layout, root at 0
+    size_t tree_depth_ = 0; // nodes on the longest root-to-leaf path
+    BuildDegradation degradation_; // of the last build
+
+    // What searches read: the owned arrays after a build, the mapped file after loadIndex()
+    const IndexType*   vacc_view_ = nullptr;
+    const CompactNode* compact_view_ = nullptr;
+    const ElementType* point_view_ = nullptr;
+    size_t node_count_ = 0; // entries of compact_view_
+
+    void*  mapped_ = nullptr;
+    size_t mapped_bytes_ = 0;
+    size_t mapped_resident_ = 0; // resident bytes of the mapping, as accounted
+
+public:
     
-    explicit MemoryMonitoredKDTreeBase(size_t memory_threshold_bytes)
-        : memory_monitor_(memory_threshold_bytes) {
+    explicit MemoryMonitoredKDTreeBase(
+        size_t memory_threshold_bytes,
+        const MemoryMonitorParams& monitor_params = {},
+        const MemoryMonitoredBuildParams& build_params = {})
+        : memory_monitor_(memory_threshold_bytes, monitor_params),
+          build_params_(build_params) {
         monitored_pool_.setMemoryMonitor(&memory_monitor_);
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        memory_monitor_.setCounters(&counters_);
+#endif
+    }
+
+    ~MemoryMonitoredKDTreeBase() {
+        unmapIndex();
+    }
+
+    /**
+     * Get build configuration
+     */
+    const MemoryMonitoredBuildParams& getBuildParams() const {
+        return build_params_;
+    }
+
+    /**
+     * Set build configuration used by the next buildIndex()
+     */
+    void setBuildParams(const MemoryMonitoredBuildParams& build_params) {
+        build_params_ = build_params;
     }
     
     /**
-     * Override divideTree to use monitored allocator
+     * Release the monitored pool together with the base index
      */
-    NodePtr divideTree(Derived& obj, const Offset left, const Offset right, BoundingBox& bbox) {
-        // Check memory before allocation
-        if (memory_monitor_.checkMemoryLimit()) {
-            throw MemoryLimitExceededException(
-                "Memory limit exceeded during tree division. "
-                "Current: " + std::to_string(memory_monitor_.getCurrentMemoryUsage()) + 
-                " bytes, Threshold: " + std::to_string(memory_monitor_.getMemoryThreshold()) + " bytes");
-        }
-        
-        // Use monitored allocator instead of base allocator
-        NodePtr node = monitored_pool_.template allocate<typename Base::Node>();
-        const auto dims = (DIM > 0 ? DIM : obj.dim_);
+    void freeIndex(Derived& obj) {
+        monitored_pool_.free_all();
+        memory_monitor_.releaseAccountedBytes(point_storage_.capacity() * sizeof(ElementType));
+        point_storage_ = {};
+        use_leaf_kernel_ = false;
+        memory_monitor_.releaseAccountedBytes(compact_nodes_.capacity() * sizeof(CompactNode));
+        compact_nodes_ = {};
+        unmapIndex();
+        vacc_view_ = nullptr;
+        compact_view_ = nullptr;
+        point_view_ = nullptr;
+        node_count_ = 0;
+        tree_depth_ = 0;
+#ifndef NANOFLANN_NO_THREADS
+        worker_arenas_.clear();
+#endif
+        Base::freeIndex(obj);
+    }
 
-        /* If too few exemplars remain, then make this a leaf node. */
-        if ((right - left) <= static_cast<Offset>(obj.leaf_max_size_)) {
-            node->child1 = node->child2 = nullptr; /* Mark as leaf node. */
-            node->node_type.lr.left     = left;
-            node->node_type.lr.right    = right;
+    /**
+     * Memory used by the index: monitored pool blocks plus vAcc_
+     */
+    Size usedMemory(Derived& obj) {
+        Size pool_bytes = monitored_pool_.usedMemory + monitored_pool_.wastedMemory;
+#ifndef NANOFLANN_NO_THREADS
+        for (const auto& arena : worker_arenas_) {
+            pool_bytes += arena->pool.usedMemory + arena->pool.wastedMemory;
+        }
+#endif
+        return pool_bytes + obj.dataset_.kdtree_get_point_count() * sizeof(IndexType) +
+               point_storage_.capacity() * sizeof(ElementType) +
+               compact_nodes_.capacity() * sizeof(CompactNode) + mapped_bytes_;
+    }
 
-            // compute bounding-box of leaf points
-            for (Dimension i = 0; i < dims; ++i) {
-                bbox[i].low  = Base::dataset_get(obj, obj.vAcc_[left], i);
-                bbox[i].high = Base::dataset_get(obj, obj.vAcc_[left], i);
-            }
-            for (Offset k = left + 1; k < right; ++k) {
-                for (Dimension i = 0; i < dims; ++i) {
-                    const auto val = Base::dataset_get(obj, obj.vAcc_[k], i);
-                    if (bbox[i].low > val) bbox[i].low = val;
-                    if (bbox[i].high < val) bbox[i].high = val;
+    /**
+     * Number of nodes on the longest root-to-leaf path of the built tree
+     */
+    size_t getTreeDepth() const {
+        return tree_depth_;
+    }
+
+    /**
+     * How the last build degraded under build_params.limit_policy
+     */
+    const BuildDegradation& getBuildDegradation() const {
+        return degradation_;
+    }
+
+    /**
+     * Predict the peak bytes of building a tree over point_count points, without
+     * touching the dataset. The node count assumes the about 1.5 * point_count /
+     * leaf_max_size leaves the middle split produces on typical data; heavily
+     * duplicated points can need more.
+     */
+    static MemoryFootprint estimateMemoryFootprint(
+        const Size point_count, const Dimension dimensionality,
+        const KDTreeSingleIndexAdaptorParams& params = {},
+        const MemoryMonitoredBuildParams& build_params = {}) {
+        MemoryFootprint footprint;
+        if (point_count == 0) return footprint;
+        const size_t dims = static_cast<size_t>(DIM > 0 ? DIM : dimensionality);
+        const size_t bbox_bytes = dims * sizeof(Interval);
+        size_t threads = params.n_thread_build;
+        if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+#ifdef NANOFLANN_NO_THREADS
+        threads = 1;
+#endif
+        footprint.index_storage = point_count * sizeof(IndexType) + bbox_bytes;
+
+        const size_t leaf_size = std::max<size_t>(params.leaf_max_size, 1);
+        const size_t leaves = leaf_size == 1
+            ? point_count
+            : std::min<size_t>(point_count, (3 * point_count + 2 * leaf_size - 1) / (2 * leaf_size));
+        const size_t node_count = 2 * leaves - 1;
+
+        size_t depth = 1;
+        while ((size_t(1) << (depth - 1)) < leaves) ++depth;
+        footprint.bounding_boxes = threads * depth * 2 * bbox_bytes;
+
+        // Linked nodes come from pools; a concurrent build also links before flattening
+        if (!build_params.compact_nodes || threads > 1) {
+            const size_t node_bytes = (sizeof(typename Base::Node) + (WORDSIZE - 1)) & ~(WORDSIZE - 1);
+            const size_t blocks = (node_count + BLOCKSIZE / node_bytes - 1) / (BLOCKSIZE / node_bytes);
+            footprint.nodes += node_count * node_bytes;
+            // Every thread's pool leaves the tail of its last block unused
+            footprint.pool_slack = (blocks + threads - 1) * (BLOCKSIZE + WORDSIZE) - node_count * node_bytes;
+        }
+        if (build_params.compact_nodes) {
+            // Initial reserve, doubled while the estimate does not fit
+            size_t capacity = 2 * (point_count / leaf_size) + 1;
+            const size_t initial = capacity;
+            while (capacity < node_count) capacity = std::max<size_t>(COMPACT_GROWTH_STEP, capacity * 2);
+            footprint.nodes += capacity * sizeof(CompactNode);
+            // The old array is still alive while the last growth copies it
+            if (capacity != initial) footprint.nodes += capacity / 2 * sizeof(CompactNode);
+        }
+
+        if (is_additive_metric<Distance>::value && (build_params.reorder_points || build_params.simd_leaves)) {
+            footprint.point_storage = dims * point_count * sizeof(ElementType);
+        }
+        return footprint;
+    }
+
+    /**
+     * Whether the tree is stored in the compact node layout
+     */
+    bool usesCompactNodes() const {
+        return compact_view_ != nullptr;
+    }
+
+    /**
+     * Whether searches of this tree read points from the reordered copy
+     */
+    bool usesPointStorage() const {
+        return point_view_ != nullptr;
+    }
+
+    /**
+     * Whether the index is a file mapped by loadIndex()
+     */
+    bool usesMappedIndex() const {
+        return mapped_ != nullptr;
+    }
+
+    /**
+     * Re-measure the resident pages of a mapped index and account them in place
+     * of the previous measurement. Pages are faulted in as searches touch them,
+     * so call this periodically to keep a TreeBytes budget current.
+     * @return resident bytes of the mapping
+     */
+    size_t refreshMappedAccounting() {
+#ifdef NANOFLANN_MAPPED_INDEX
+        if (!mapped_) return 0;
+        const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        const size_t pages = (mapped_bytes_ + page_size - 1) / page_size;
+#ifdef __linux__
+        std::vector<unsigned char> residency(pages);
+#else
+        std::vector<char> residency(pages);
+#endif
+        size_t resident = mapped_bytes_; // without mincore(), count the whole mapping
+        if (::mincore(mapped_, mapped_bytes_, residency.data()) == 0) {
+            resident = 0;
+            for (size_t i = 0; i < pages; ++i) {
+                if (residency[i] & 1) resident += page_size;
+            }
+            resident = std::min(resident, mapped_bytes_);
+        }
+        memory_monitor_.releaseAccountedBytes(mapped_resident_);
+        memory_monitor_.addAccountedBytes(resident);
+        mapped_resident_ = resident;
+        return resident;
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * Whether searches of this tree run leaves through the SIMD leaf kernel
+     */
+    bool usesLeafKernel() const {
+        return use_leaf_kernel_;
+    }
+
+    /**
+     * Bytes the tree currently owns: pool blocks, vAcc_ capacity and bounding boxes
+     */
+    size_t getAccountedBytes() const {
+        return memory_monitor_.getAccountedBytes();
+    }
+
+    /**
+     * Check that vAcc_ can grow to hold point_count entries within the limit
+     */
+    void checkIndexStorage(Size point_count) const {
+        const size_t required =
+            std::max<size_t>(point_count, Base::vAcc_.capacity()) * sizeof(IndexType) + boundingBoxBytes();
+        if (required > index_storage_bytes_ &&
+            memory_monitor_.checkMemoryLimit(required - index_storage_bytes_)) {
+            memory_monitor_.throwLimitExceeded("while reserving index storage", required - index_storage_bytes_);
+        }
+    }
+
+    /**
+     * With build_params_.check_footprint, reject a build of point_count points
+     * whose estimated footprint cannot fit. A degrading limit_policy only needs
+     * the index storage and the headroom of one split.
+     */
+    void checkFootprint(Size point_count, const KDTreeSingleIndexAdaptorParams& params) const {
+        if (!build_params_.check_footprint) return;
+        const MemoryFootprint footprint =
+            estimateMemoryFootprint(point_count, Base::dim_, params, build_params_);
+        const size_t required = build_params_.limit_policy == MemoryLimitPolicy::Throw
+            ? footprint.total()
+            : footprint.index_storage + degradeHeadroom();
+        // The bytes of a previous build are replaced, not added to
+        const size_t owned = memory_monitor_.getAccountedBytes();
+        if (memory_monitor_.checkMemoryLimit(0, required > owned ? required - owned : 0)) {
+            throw MemoryLimitExceededException(
+                "Memory limit exceeded by the estimated build footprint. "
+                "Estimated: " + std::to_string(required) +
+                " bytes, Current: " + std::to_string(memory_monitor_.getCurrentMemoryUsage()) +
+                " bytes, Threshold: " + std::to_string(memory_monitor_.getMemoryThreshold()) + " bytes");
+        }
+    }
+
+    /**
+     * Account the current vAcc_ capacity and root bounding box
+     */
+    void commitIndexStorage() {
+        const size_t bytes = Base::vAcc_.capacity() * sizeof(IndexType) + boundingBoxBytes();
+        memory_monitor_.releaseAccountedBytes(index_storage_bytes_);
+        memory_monitor_.addAccountedBytes(bytes);
+        index_storage_bytes_ = bytes;
+    }
+
+    /**
+     * Point the search views at the owned arrays of a build
+     */
+    void bindViews() {
+        vacc_view_ = Base::vAcc_.data();
+        compact_view_ = compact_nodes_.empty() ? nullptr : compact_nodes_.data();
+        node_count_ = compact_nodes_.size();
+        point_view_ = point_storage_.empty() ? nullptr : point_storage_.data();
+    }
+
+    /**
+     * Release the mapping of a loaded index and its accounted resident bytes
+     */
+    void unmapIndex() {
+        if (!mapped_) return;
+#ifdef NANOFLANN_MAPPED_INDEX
+        ::munmap(mapped_, mapped_bytes_);
+#endif
+        memory_monitor_.releaseAccountedBytes(mapped_resident_);
+        mapped_ = nullptr;
+        mapped_bytes_ = 0;
+        mapped_resident_ = 0;
+    }
+
+    /**
+     * With reorder_points or simd_leaves, copy the points into point_storage_ in
+     * vAcc_ order so that a leaf is one contiguous run. Needs a metric that can be
+     * evaluated on the copy; other trees keep reading the dataset.
+     */
+    void buildPointStorage(const Derived& obj) {
+        if constexpr (is_additive_metric<Distance>::value) {
+            if (!build_params_.reorder_points && !build_params_.simd_leaves) return;
+            const size_t dims = static_cast<size_t>(DIM > 0 ? DIM : Base::dim_);
+            const size_t bytes = dims * Base::size_ * sizeof(ElementType);
+            if (memory_monitor_.checkMemoryLimit(bytes)) {
+                // A degrading build keeps its tree and searches the dataset instead
+                if (build_params_.limit_policy != MemoryLimitPolicy::Throw) {
+                    degradation_.point_storage_skipped = true;
+                    return;
                 }
+                memory_monitor_.throwLimitExceeded("while storing reordered points", bytes);
             }
+            point_storage_.resize(dims * Base::size_);
+            for (Size i = 0; i < Base::size_; ++i) {
+                for (size_t d = 0; d < dims; ++d) {
+                    point_storage_[storageOffset(i, d)] = Base::dataset_get(obj, Base::vAcc_[i], d);
+                }
+            }
+            memory_monitor_.addAccountedBytes(point_storage_.capacity() * sizeof(ElementType));
+            bindViews();
+            use_leaf_kernel_ = build_params_.simd_leaves && Layout == PointStorageLayout::SoA &&
+                leaf_kernel_supported<Distance, DIM, ElementType, DistanceType>::value;
+        } else {
+            (void)obj;
+        }
+    }
+
+    /**
+     * Position of coordinate d of the i-th point (in vAcc_ order) in point_storage_
+     */
+    size_t storageOffset(size_t i, size_t d) const {
+        if constexpr (Layout == PointStorageLayout::SoA) {
+            return d * Base::size_ + i;
+        } else {
+            return i * static_cast<size_t>(DIM > 0 ? DIM : Base::dim_) + d;
+        }
+    }
+
+    /**
+     * Leaf scan over point_storage_, through the SIMD kernel when enabled
+     */
+    template <class RESULTSET>
+    bool searchLeafStorage(
+        RESULTSET& result_set, const ElementType* vec, const Offset left, const Offset right) const {
+        const DistanceType worst_dist = result_set.worstDist();
+        if constexpr (Layout == PointStorageLayout::SoA &&
+                      leaf_kernel_supported<Distance, DIM, ElementType, DistanceType>::value) {
+            if (use_leaf_kernel_) {
+                // Distances of a block of points at a time, then the usual filter
+                constexpr Offset block_size = 64;
+                DistanceType dists[block_size];
+                for (Offset begin = left; begin < right; begin += block_size) {
+                    const Offset count = std::min(block_size, right - begin);
+                    leafL2Distances<DIM>(point_view_, Base::size_, begin, count, vec, dists);
+                    for (Offset j = 0; j < count; ++j) {
+                        if (dists[j] < worst_dist) {
+                            if (!result_set.addPoint(dists[j], vacc_view_[begin + j])) {
+                                return false;
+                            }
+                        }
+                    }
+                }
+                return true;
+            }
+        }
+        const auto& distance = static_cast<const Derived*>(this)->distance_;
+        const size_t dims = static_cast<size_t>(DIM > 0 ? DIM : Base::dim_);
+        for (Offset i = left; i < right; ++i) {
+            DistanceType dist = DistanceType();
+            for (size_t d = 0; d < dims; ++d) {
+                dist += distance.accum_dist(vec[d], point_view_[storageOffset(i, d)], d);
+            }
+            if (dist < worst_dist) {
+                if (!result_set.addPoint(dist, vacc_view_[i])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Storage of one bounding box
+     */
+    size_t boundingBoxBytes() const {
+        return static_cast<size_t>(DIM > 0 ? DIM : Base::dim_) * sizeof(Interval);
+    }
+
+    /**
+     * Budget a degrading build keeps free while it still splits: the pool blocks
+     * and child boxes of one split, plus a block for the leaves of the ranges
+     * still pending on the stack once splitting stops, for each of threads
+     * building at the same time
+     */
+    size_t degradeHeadroom(const size_t threads = 1) const {
+        return threads * (2 * (BLOCKSIZE + WORDSIZE) + 2 * boundingBoxBytes());
+    }
+
+    /**
+     * Under a degrading limit_policy, make [left, right) a leaf when the budget
+     * no longer allows a split. Subsample moves leaf_max_size evenly spaced
+     * points of the range to its front and shrinks right to them.
+     * @param over_limit the limit is already exceeded, e.g. by a jump of the
+     *        process RSS, so the range becomes a leaf without another check
+     * @return true if the range becomes a leaf
+     */
+    bool degradeToLeaf(const Derived& obj, const Offset left, Offset& right, const bool over_limit = false) {
+        if (build_params_.limit_policy == MemoryLimitPolicy::Throw ||
+            (!over_limit && !memory_monitor_.checkMemoryLimit(0, degradeHeadroom()))) {
+            return false;
+        }
+        degradeRange(obj, left, right, degradation_);
+        return true;
+    }
+
+    /**
+     * Record [left, right) in degradation as a range made a leaf, and subsample
+     * it under MemoryLimitPolicy::Subsample
+     */
+    void degradeRange(const Derived& obj, const Offset left, Offset& right, BuildDegradation& degradation) {
+        const Offset count = right - left;
+        const Offset leaf_size = std::max<Offset>(obj.leaf_max_size_, 1);
+        ++degradation.degraded_leaves;
+        degradation.skipped_nodes += 2 * ((count + leaf_size - 1) / leaf_size) - 2;
+        if (build_params_.limit_policy == MemoryLimitPolicy::Subsample) {
+            // Sources j * count / leaf_size grow faster than j, so each is still unmoved
+            for (Offset j = 1; j < leaf_size; ++j) {
+                std::swap(Base::vAcc_[left + j], Base::vAcc_[left + j * count / leaf_size]);
+            }
+            degradation.dropped_points += count - leaf_size;
+            right = left + leaf_size;
+        }
+    }
+
+    /**
+     * Override divideTree to use monitored allocator
+     */
+    NodePtr divideTree(Derived& obj, const Offset left, const Offset right, BoundingBox& bbox) {
+        // Check memory before allocation. Past the limit a degrading build still
+        // adds this node, its parent being split already, but as a leaf.
+        const bool over_limit = memory_monitor_.checkMemoryLimit();
+        if (over_limit && build_params_.limit_policy == MemoryLimitPolicy::Throw) {
+            memory_monitor_.throwLimitExceeded("during tree division");
+        }
+        
+        // Use monitored allocator instead of base allocator
+        NodePtr node = monitored_pool_.template allocate<typename Base::Node>(1, !over_limit);
+
+        /* If too few exemplars remain, then make this a leaf node. */
+        Offset leaf_right = right;
+        if ((right - left) <= static_cast<Offset>(obj.leaf_max_size_) ||
+            degradeToLeaf(obj, left, leaf_right, over_limit)) {
+            node->child1 = node->child2 = nullptr; /* Mark as leaf node. */
+            node->node_type.lr.left     = left;
+            node->node_type.lr.right    = leaf_right;
+
+            computeLeafBoundingBox(obj, left, leaf_right, bbox);
         } else {
             Offset       idx;
             Dimension    cutfeat;
             typename Base::DistanceType cutval;
-            Base::middleSplit_(obj, left, right - left, idx, cutfeat, cutval, bbox);
+            splitRange(obj, left, right - left, idx, cutfeat, cutval, bbox);
 
             node->node_type.sub.divfeat = cutfeat;
 
+            // The two child boxes are owned for the duration of the recursion
+            MemoryMonitor::ScopedBytes child_bboxes(memory_monitor_, 2 * boundingBoxBytes());
+
             BoundingBox left_bbox(bbox);
             left_bbox[cutfeat].high = cutval;
             node->child1 = this->divideTree(obj, left, left + idx, left_bbox);
@@ -242,39 +1328,988 @@ public:
             right_bbox[cutfeat].low = cutval;
             node->child2 = this->divideTree(obj, left + idx, right, right_bbox);
 
-            node->node_type.sub.divlow  = left_bbox[cutfeat].high;
-            node->node_type.sub.divhigh = right_bbox[cutfeat].low;
+            node->node_type.sub.divlow  = left_bbox[cutfeat].high;
+            node->node_type.sub.divhigh = right_bbox[cutfeat].low;
+
+            mergeBoundingBoxes(obj, left_bbox, right_bbox, bbox);
+        }
+
+        return node;
+    }
+
+    /**
+     * Build the tree straight into the compact node array
+     */
+    void buildCompactTree(Derived& obj) {
+        checkCompactRange();
+        size_t capacity = 2 * (Base::size_ / std::max<size_t>(obj.leaf_max_size_, 1)) + 1;
+        // A degrading build starts small when the estimate does not fit
+        if (build_params_.limit_policy != MemoryLimitPolicy::Throw &&
+            memory_monitor_.checkMemoryLimit(capacity * sizeof(CompactNode), degradeHeadroom())) {
+            capacity = COMPACT_GROWTH_STEP;
+        }
+        reserveCompactNodes(capacity);
+        divideTreeCompact(obj, 0, Base::size_, Base::root_bbox_);
+    }
+
+    /**
+     * Move a linked tree (from a concurrent build) into the compact node array
+     * and release its pools
+     */
+    void flattenTree() {
+        checkCompactRange();
+        reserveCompactNodes(2 * (Base::size_ / std::max<size_t>(Base::leaf_max_size_, 1)) + 1);
+        flattenNode(Base::root_node_);
+        Base::root_node_ = nullptr;
+        monitored_pool_.free_all();
+#ifndef NANOFLANN_NO_THREADS
+        worker_arenas_.clear();
+#endif
+    }
+
+    /**
+     * divideTree() for the compact layout
+     * @return index of the subtree root in compact_nodes_
+     */
+    uint32_t divideTreeCompact(Derived& obj, const Offset left, const Offset right, BoundingBox& bbox) {
+        const bool over_limit = memory_monitor_.checkMemoryLimit();
+        if (over_limit && build_params_.limit_policy == MemoryLimitPolicy::Throw) {
+            memory_monitor_.throwLimitExceeded("during tree division");
+        }
+
+        const uint32_t index = appendCompactNode();
+
+        /* If too few exemplars remain, then make this a leaf node. */
+        Offset leaf_right = right;
+        if ((right - left) <= static_cast<Offset>(obj.leaf_max_size_) ||
+            degradeToLeaf(obj, left, leaf_right, over_limit)) {
+            compact_nodes_[index].first  = COMPACT_LEAF_FLAG | static_cast<uint32_t>(left);
+            compact_nodes_[index].second = static_cast<uint32_t>(leaf_right);
+
+            computeLeafBoundingBox(obj, left, leaf_right, bbox);
+        } else {
+            Offset       idx;
+            Dimension    cutfeat;
+            DistanceType cutval;
+            splitRange(obj, left, right - left, idx, cutfeat, cutval, bbox);
+
+            // The two child boxes are owned for the duration of the recursion
+            MemoryMonitor::ScopedBytes child_bboxes(memory_monitor_, 2 * boundingBoxBytes());
+
+            // The first child lands right after this node
+            BoundingBox left_bbox(bbox);
+            left_bbox[cutfeat].high = cutval;
+            divideTreeCompact(obj, left, left + idx, left_bbox);
+
+            BoundingBox right_bbox(bbox);
+            right_bbox[cutfeat].low = cutval;
+            const uint32_t child2 = divideTreeCompact(obj, left + idx, right, right_bbox);
+
+            // The array may have grown, so index it again
+            CompactNode& node = compact_nodes_[index];
+            node.first   = static_cast<uint32_t>(cutfeat);
+            node.second  = child2;
+            node.divlow  = left_bbox[cutfeat].high;
+            node.divhigh = right_bbox[cutfeat].low;
+
+            mergeBoundingBoxes(obj, left_bbox, right_bbox, bbox);
+        }
+
+        return index;
+    }
+
+    /**
+     * Append a linked subtree to compact_nodes_ in depth-first order
+     */
+    uint32_t flattenNode(const NodePtr node) {
+        const uint32_t index = appendCompactNode();
+        if ((node->child1 == nullptr) && (node->child2 == nullptr)) {
+            compact_nodes_[index].first  = COMPACT_LEAF_FLAG | static_cast<uint32_t>(node->node_type.lr.left);
+            compact_nodes_[index].second = static_cast<uint32_t>(node->node_type.lr.right);
+        } else {
+            flattenNode(node->child1);
+            const uint32_t child2 = flattenNode(node->child2);
+            CompactNode& compact = compact_nodes_[index];
+            compact.first   = static_cast<uint32_t>(node->node_type.sub.divfeat);
+            compact.second  = child2;
+            compact.divlow  = node->node_type.sub.divlow;
+            compact.divhigh = node->node_type.sub.divhigh;
+        }
+        return index;
+    }
+
+    /**
+     * Write a linked subtree to out[index...] in the compact layout, as flattenNode() would
+     * @return one past the last index written
+     */
+    static uint32_t writeCompactNodes(const NodePtr node, CompactNode* out, const uint32_t index) {
+        if ((node->child1 == nullptr) && (node->child2 == nullptr)) {
+            out[index].first  = COMPACT_LEAF_FLAG | static_cast<uint32_t>(node->node_type.lr.left);
+            out[index].second = static_cast<uint32_t>(node->node_type.lr.right);
+            return index + 1;
+        }
+        const uint32_t child2 = writeCompactNodes(node->child1, out, index + 1);
+        const uint32_t end = writeCompactNodes(node->child2, out, child2);
+        out[index].first   = static_cast<uint32_t>(node->node_type.sub.divfeat);
+        out[index].second  = child2;
+        out[index].divlow  = node->node_type.sub.divlow;
+        out[index].divhigh = node->node_type.sub.divhigh;
+        return end;
+    }
+
+    static size_t countNodes(const NodePtr node) {
+        if ((node->child1 == nullptr) && (node->child2 == nullptr)) return 1;
+        return 1 + countNodes(node->child1) + countNodes(node->child2);
+    }
+
+    /**
+     * Offsets and node indices must fit the 31/32-bit fields of CompactNode
+     */
+    void checkCompactRange() const {
+        if (Base::size_ >= COMPACT_LEAF_FLAG) {
+            throw std::runtime_error(
+                "compact_nodes supports at most 2^31 - 1 points, got " + std::to_string(Base::size_));
+        }
+    }
+
+    /**
+     * Grow compact_nodes_ to hold at least capacity nodes, within the budget.
+     * A degrading build grows past it: the slots are for nodes it is already
+     * committed to, and the next divideTreeCompact() turns leaves anyway.
+     */
+    void reserveCompactNodes(size_t capacity) {
+        const size_t old_capacity = compact_nodes_.capacity();
+        if (capacity <= old_capacity) return;
+        const size_t bytes = (capacity - old_capacity) * sizeof(CompactNode);
+        if (build_params_.limit_policy == MemoryLimitPolicy::Throw && memory_monitor_.checkMemoryLimit(bytes)) {
+            memory_monitor_.throwLimitExceeded("while growing the compact node array", bytes);
+        }
+        compact_nodes_.reserve(capacity);
+        memory_monitor_.addAccountedBytes((compact_nodes_.capacity() - old_capacity) * sizeof(CompactNode));
+    }
+
+    uint32_t appendCompactNode() {
+        if (compact_nodes_.size() == compact_nodes_.capacity()) {
+            size_t capacity = std::max<size_t>(COMPACT_GROWTH_STEP, compact_nodes_.capacity() * 2);
+            // Near the budget a degrading build grows in steps its headroom covers
+            if (build_params_.limit_policy != MemoryLimitPolicy::Throw &&
+                memory_monitor_.checkMemoryLimit(
+                    (capacity - compact_nodes_.capacity()) * sizeof(CompactNode), degradeHeadroom())) {
+                capacity = compact_nodes_.capacity() + COMPACT_GROWTH_STEP;
+            }
+            reserveCompactNodes(capacity);
+        }
+        compact_nodes_.emplace_back();
+        return static_cast<uint32_t>(compact_nodes_.size() - 1);
+    }
+
+    /**
+     * Compute the bounding box of the points in [left, right)
+     */
+    void computeLeafBoundingBox(
+        const Derived& obj, const Offset left, const Offset right, BoundingBox& bbox) const {
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        detail::CounterSlot& slot = counters_.local();
+        detail::CounterTimer timer(slot.bbox_updates, slot.bbox_ns);
+#endif
+        const auto dims = (DIM > 0 ? DIM : obj.dim_);
+        for (Dimension i = 0; i < dims; ++i) {
+            bbox[i].low  = Base::dataset_get(obj, obj.vAcc_[left], i);
+            bbox[i].high = Base::dataset_get(obj, obj.vAcc_[left], i);
+        }
+        for (Offset k = left + 1; k < right; ++k) {
+            for (Dimension i = 0; i < dims; ++i) {
+                const auto val = Base::dataset_get(obj, obj.vAcc_[k], i);
+                if (bbox[i].low > val) bbox[i].low = val;
+                if (bbox[i].high < val) bbox[i].high = val;
+            }
+        }
+    }
+
+    /**
+     * Split the count points at ind with build_params_.split_rule. Points
+     * [ind, ind + index) end up at or below cutval on cutfeat and the rest at or
+     * above it, with 0 < index < count.
+     */
+    void splitRange(
+        const Derived& obj, const Offset ind, const Size count, Offset& index,
+        Dimension& cutfeat, DistanceType& cutval, const BoundingBox& bbox) {
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        detail::CounterSlot& slot = counters_.local();
+        detail::CounterTimer timer(slot.splits, slot.split_ns);
+#endif
+        switch (build_params_.split_rule) {
+        case SplitRule::Median:
+            medianSplit(obj, ind, count, index, cutfeat, cutval, bbox);
+            return;
+        case SplitRule::SlidingMidpoint:
+            slidingMidpointSplit(obj, ind, count, index, cutfeat, cutval, bbox);
+            return;
+        case SplitRule::Sampled:
+            if (count > SPLIT_SAMPLE_POINTS) {
+                sampledSplit(obj, ind, count, index, cutfeat, cutval, bbox);
+                return;
+            }
+            break;
+        case SplitRule::Middle:
+            break;
+        }
+        Base::middleSplit_(obj, ind, count, index, cutfeat, cutval, bbox);
+    }
+
+    /**
+     * Dimension with the widest span of bbox
+     */
+    Dimension widestDimension(const Derived& obj, const BoundingBox& bbox) const {
+        const auto dims = (DIM > 0 ? DIM : obj.dim_);
+        Dimension widest = 0;
+        for (Dimension i = 1; i < dims; ++i) {
+            if (bbox[i].high - bbox[i].low > bbox[widest].high - bbox[widest].low) widest = i;
+        }
+        return widest;
+    }
+
+    void medianSplit(
+        const Derived& obj, const Offset ind, const Size count, Offset& index,
+        Dimension& cutfeat, DistanceType& cutval, const BoundingBox& bbox) {
+        cutfeat = widestDimension(obj, bbox);
+        index = count / 2;
+        const auto begin = Base::vAcc_.begin() + ind;
+        std::nth_element(begin, begin + index, begin + count,
+            [this, &obj, cutfeat](IndexType a, IndexType b) {
+                return Base::dataset_get(obj, a, cutfeat) < Base::dataset_get(obj, b, cutfeat);
+            });
+        cutval = Base::dataset_get(obj, Base::vAcc_[ind + index], cutfeat);
+    }
+
+    void slidingMidpointSplit(
+        const Derived& obj, const Offset ind, const Size count, Offset& index,
+        Dimension& cutfeat, DistanceType& cutval, const BoundingBox& bbox) {
+        cutfeat = widestDimension(obj, bbox);
+        cutval = (bbox[cutfeat].low + bbox[cutfeat].high) / 2;
+        Offset lim1, lim2;
+        Base::planeSplit(obj, ind, count, cutfeat, cutval, lim1, lim2);
+        index = std::min<Offset>(std::max<Offset>(count / 2, lim1), lim2);
+        if (index > 0 && index < count) return;
+
+        // Every point is on one side: slide the cut to the closest of them
+        ElementType min_elem, max_elem;
+        Base::computeMinMax(obj, ind, count, cutfeat, min_elem, max_elem);
+        if (min_elem == max_elem) {
+            // No extent on the box's widest dimension; fall back to the point spreads
+            Base::middleSplit_(obj, ind, count, index, cutfeat, cutval, bbox);
+            return;
+        }
+        cutval = index == 0 ? min_elem : max_elem;
+        Base::planeSplit(obj, ind, count, cutfeat, cutval, lim1, lim2);
+        index = index == 0 ? lim2 : lim1;
+    }
+
+    void sampledSplit(
+        const Derived& obj, const Offset ind, const Size count, Offset& index,
+        Dimension& cutfeat, DistanceType& cutval, const BoundingBox& bbox) {
+        const auto dims = (DIM > 0 ? DIM : obj.dim_);
+        const Size stride = count / SPLIT_SAMPLE_POINTS;
+        cutfeat = 0;
+        ElementType max_spread = -1, min_elem = 0, max_elem = 0;
+        for (Dimension i = 0; i < dims; ++i) {
+            ElementType low = Base::dataset_get(obj, Base::vAcc_[ind], i);
+            ElementType high = low;
+            for (size_t k = 1; k < SPLIT_SAMPLE_POINTS; ++k) {
+                const ElementType val = Base::dataset_get(obj, Base::vAcc_[ind + k * stride], i);
+                if (val < low) low = val;
+                if (val > high) high = val;
+            }
+            if (high - low > max_spread) {
+                cutfeat = i;
+                max_spread = high - low;
+                min_elem = low;
+                max_elem = high;
+            }
+        }
+        // Clamped to sampled points, so neither side comes out empty
+        const DistanceType split_val = (bbox[cutfeat].low + bbox[cutfeat].high) / 2;
+        cutval = std::min<DistanceType>(std::max<DistanceType>(split_val, min_elem), max_elem);
+
+        Offset lim1, lim2;
+        Base::planeSplit(obj, ind, count, cutfeat, cutval, lim1, lim2);
+        index = std::min<Offset>(std::max<Offset>(count / 2, lim1), lim2);
+    }
+
+    /**
+     * Set bbox to the union of the two child boxes
+     */
+    void mergeBoundingBoxes(
+        const Derived& obj, const BoundingBox& left_bbox, const BoundingBox& right_bbox,
+        BoundingBox& bbox) const {
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        detail::CounterSlot& slot = counters_.local();
+        detail::CounterTimer timer(slot.bbox_updates, slot.bbox_ns);
+#endif
+        const auto dims = (DIM > 0 ? DIM : obj.dim_);
+        for (Dimension i = 0; i < dims; ++i) {
+            bbox[i].low  = std::min(left_bbox[i].low, right_bbox[i].low);
+            bbox[i].high = std::max(left_bbox[i].high, right_bbox[i].high);
+        }
+    }
+
+#ifndef NANOFLANN_NO_THREADS
+protected:
+    /**
+     * Pool and monitor owned by one concurrent build task. Nodes live in the
+     * pool, so arenas are kept until freeIndex().
+     */
+    struct WorkerArena {
+        WorkerArena(MemoryMonitor& shared_budget, size_t merge_bytes)
+            : monitor(shared_budget, shared_budget.getParams(), merge_bytes) {
+            pool.setMemoryMonitor(&monitor);
+        }
+
+        MemoryMonitor monitor;
+        MemoryMonitoredAllocator<> pool;
+    };
+
+    /**
+     * State shared by all tasks of one concurrent build
+     */
+    struct ConcurrentBuildContext {
+        std::atomic<unsigned int> thread_count{0u};
+        std::atomic<bool> cancelled{false};
+        std::mutex mutex;
+        std::exception_ptr error;
+
+        // Degrading builds: threads that may build at once, see degradeHeadroom(),
+        // and whether a task found the budget reached, after which every task
+        // makes its pending ranges leaves
+        size_t threads = 1;
+        std::atomic<bool> budget_reached{false};
+
+        // Work-stealing builds: the thread that started the build, its arena and
+        // the arena of each pool worker, all fixed for the whole build
+        std::thread::id caller;
+        WorkerArena* caller_arena = nullptr;
+        std::vector<WorkerArena*> worker_arenas;
+
+        /**
+         * Record the first failure and cancel every other task
+         */
+        void fail(std::exception_ptr e) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) error = e;
+            }
+            cancelled.store(true, std::memory_order_release);
+        }
+
+        /**
+         * Claim on one of the limit threads of divideTreeConcurrent, released
+         * when the guard is destroyed, also on exceptions
+         */
+        class ThreadSlot {
+        public:
+            ThreadSlot(ConcurrentBuildContext& ctx, size_t limit)
+                : ctx_(ctx), acquired_(++ctx.thread_count < limit) {
+                if (!acquired_) --ctx_.thread_count;
+            }
+            ~ThreadSlot() {
+                if (acquired_) --ctx_.thread_count;
+            }
+            ThreadSlot(const ThreadSlot&) = delete;
+            ThreadSlot& operator=(const ThreadSlot&) = delete;
+
+            explicit operator bool() const { return acquired_; }
+
+        private:
+            ConcurrentBuildContext& ctx_;
+            const bool acquired_;
+        };
+    };
+
+public:
+    /**
+     * Concurrent divideTree with budget enforcement. New subtree tasks are
+     * spawned while fewer than n_thread_build_ are running, each with its own
+     * WorkerArena. A task that exceeds the budget cancels all others; they
+     * stop at their next node.
+     */
+    NodePtr divideTreeConcurrent(
+        Derived& obj, const Offset left, const Offset right, BoundingBox& bbox,
+        ConcurrentBuildContext& ctx, MemoryMonitor& monitor, MemoryMonitoredAllocator<>& pool) {
+        bool over_limit = false;
+        NodePtr node = allocateConcurrentNode(ctx, monitor, pool, over_limit);
+
+        Offset leaf_right = right;
+        if ((right - left) <= static_cast<Offset>(obj.leaf_max_size_) ||
+            degradeConcurrent(obj, left, leaf_right, over_limit, ctx, monitor)) {
+            node->child1 = node->child2 = nullptr; /* Mark as leaf node. */
+            node->node_type.lr.left     = left;
+            node->node_type.lr.right    = leaf_right;
+
+            computeLeafBoundingBox(obj, left, leaf_right, bbox);
+        } else {
+            Offset       idx;
+            Dimension    cutfeat;
+            typename Base::DistanceType cutval;
+            splitRange(obj, left, right - left, idx, cutfeat, cutval, bbox);
+
+            node->node_type.sub.divfeat = cutfeat;
+
+            MemoryMonitor::ScopedBytes child_bboxes(monitor, 2 * boundingBoxBytes());
+
+            // Both boxes outlive the sibling task: the future is declared after
+            // them, and its destructor waits for the task
+            BoundingBox left_bbox(bbox);
+            left_bbox[cutfeat].high = cutval;
+            BoundingBox right_bbox(bbox);
+            right_bbox[cutfeat].low = cutval;
+
+            const typename ConcurrentBuildContext::ThreadSlot slot(ctx, Base::n_thread_build_);
+            std::future<NodePtr> right_future;
+            if (slot) {
+                WorkerArena& arena = addWorkerArena(ctx);
+                right_future = std::async(std::launch::async, [&, this]() {
+                    NodePtr child = this->divideTreeConcurrent(
+                        obj, left + idx, right, right_bbox, ctx, arena.monitor, arena.pool);
+                    arena.monitor.flush();
+                    return child;
+                });
+            }
+
+            try {
+                node->child1 = this->divideTreeConcurrent(
+                    obj, left, left + idx, left_bbox, ctx, monitor, pool);
+            } catch (...) {
+                // Cancel the sibling task and let it unwind before rethrowing
+                ctx.cancelled.store(true, std::memory_order_release);
+                if (right_future.valid()) right_future.wait();
+                throw;
+            }
+
+            if (right_future.valid()) {
+                node->child2 = right_future.get();
+            } else {
+                node->child2 = this->divideTreeConcurrent(
+                    obj, left + idx, right, right_bbox, ctx, monitor, pool);
+            }
+
+            node->node_type.sub.divlow  = left_bbox[cutfeat].high;
+            node->node_type.sub.divhigh = right_bbox[cutfeat].low;
+
+            mergeBoundingBoxes(obj, left_bbox, right_bbox, bbox);
+        }
+
+        return node;
+    }
+
+    /**
+     * Work-stealing divideTree with budget enforcement. Subtrees larger than
+     * build_params_.task_cutoff are queued as tasks; smaller ones are built by
+     * the thread that reached them, in the arena that thread took for the task
+     * (see taskArena()).
+     */
+    NodePtr divideTreeStealing(
+        Derived& obj, const Offset left, const Offset right, BoundingBox& bbox,
+        ConcurrentBuildContext& ctx, WorkStealingPool& thread_pool, WorkerArena& arena) {
+        bool over_limit = false;
+        NodePtr node = allocateConcurrentNode(ctx, arena.monitor, arena.pool, over_limit);
+
+        Offset leaf_right = right;
+        if ((right - left) <= static_cast<Offset>(obj.leaf_max_size_) ||
+            degradeConcurrent(obj, left, leaf_right, over_limit, ctx, arena.monitor)) {
+            node->child1 = node->child2 = nullptr; /* Mark as leaf node. */
+            node->node_type.lr.left     = left;
+            node->node_type.lr.right    = leaf_right;
+
+            computeLeafBoundingBox(obj, left, leaf_right, bbox);
+        } else {
+            Offset       idx;
+            Dimension    cutfeat;
+            typename Base::DistanceType cutval;
+            splitRange(obj, left, right - left, idx, cutfeat, cutval, bbox);
+
+            node->node_type.sub.divfeat = cutfeat;
+
+            MemoryMonitor::ScopedBytes child_bboxes(arena.monitor, 2 * boundingBoxBytes());
+
+            BoundingBox left_bbox(bbox);
+            left_bbox[cutfeat].high = cutval;
+            BoundingBox right_bbox(bbox);
+            right_bbox[cutfeat].low = cutval;
+
+            if ((right - left) > static_cast<Offset>(build_params_.task_cutoff)) {
+                WorkStealingPool::TaskGroup group;
+                thread_pool.submit(group, [&, this]() {
+                    node->child2 = this->divideTreeStealing(
+                        obj, left + idx, right, right_bbox, ctx, thread_pool, taskArena(ctx, thread_pool));
+                });
+                try {
+                    node->child1 = this->divideTreeStealing(
+                        obj, left, left + idx, left_bbox, ctx, thread_pool, arena);
+                } catch (...) {
+                    // Cancel the queued sibling and let it unwind before rethrowing
+                    ctx.cancelled.store(true, std::memory_order_release);
+                    try {
+                        thread_pool.wait(group);
+                    } catch (...) {
+                    }
+                    throw;
+                }
+                thread_pool.wait(group);
+            } else {
+                node->child1 = this->divideTreeStealing(
+                    obj, left, left + idx, left_bbox, ctx, thread_pool, arena);
+                node->child2 = this->divideTreeStealing(
+                    obj, left + idx, right, right_bbox, ctx, thread_pool, arena);
+            }
+
+            node->node_type.sub.divlow  = left_bbox[cutfeat].high;
+            node->node_type.sub.divhigh = right_bbox[cutfeat].low;
+
+            mergeBoundingBoxes(obj, left_bbox, right_bbox, bbox);
+        }
+
+        return node;
+    }
+
+    /**
+     * Build the tree on the work-stealing pool, creating the pool on first use
+     */
+    NodePtr buildOnThreadPool(Derived& obj, ConcurrentBuildContext& ctx) {
+        if (!build_params_.thread_pool) {
+            build_params_.thread_pool = std::make_shared<WorkStealingPool>(Base::n_thread_build_);
+        }
+        WorkStealingPool& thread_pool = *build_params_.thread_pool;
+
+        worker_arenas_.clear();
+        for (size_t i = 0; i <= thread_pool.size(); ++i) {
+            worker_arenas_.push_back(std::make_unique<WorkerArena>(memory_monitor_, workerMergeBytes()));
+        }
+        ctx.threads = thread_pool.size() + 1;
+        ctx.caller = std::this_thread::get_id();
+        ctx.caller_arena = worker_arenas_.back().get();
+        for (size_t i = 0; i < thread_pool.size(); ++i) {
+            ctx.worker_arenas.push_back(worker_arenas_[i].get());
+        }
+
+        NodePtr root = divideTreeStealing(
+            obj, 0, Base::size_, Base::root_bbox_, ctx, thread_pool, *ctx.caller_arena);
+        for (auto& arena : worker_arenas_) {
+            arena->monitor.flush();
+        }
+        return root;
+    }
+
+    /**
+     * Allocate a node for a concurrent build, recording a failure in ctx. Past
+     * the limit a degrading build still adds the node, as a leaf, and never
+     * throws for the budget: degradeConcurrent() keeps it.
+     * @param over_limit set if the limit is already exceeded
+     */
+    NodePtr allocateConcurrentNode(
+        ConcurrentBuildContext& ctx, MemoryMonitor& monitor, MemoryMonitoredAllocator<>& pool,
+        bool& over_limit) {
+        if (ctx.cancelled.load(std::memory_order_acquire)) {
+            throw MemoryLimitExceededException(
+                "Memory limit exceeded in another build task, tree construction cancelled");
+        }
+        const bool enforce = build_params_.limit_policy == MemoryLimitPolicy::Throw;
+        try {
+            over_limit = monitor.checkMemoryLimit();
+            if (over_limit && enforce) {
+                monitor.throwLimitExceeded("during concurrent tree division");
+            }
+            return pool.template allocate<typename Base::Node>(1, enforce);
+        } catch (...) {
+            ctx.fail(std::current_exception());
+            throw;
+        }
+    }
+
+    /**
+     * degradeToLeaf() for a concurrent build. The first task that finds the
+     * budget reached sets ctx.budget_reached; from then on every task makes its
+     * pending ranges leaves without checking again, so completed subtrees are
+     * kept and the build finishes in place.
+     */
+    bool degradeConcurrent(const Derived& obj, const Offset left, Offset& right, const bool over_limit,
+                           ConcurrentBuildContext& ctx, const MemoryMonitor& monitor) {
+        if (build_params_.limit_policy == MemoryLimitPolicy::Throw) return false;
+        if (!over_limit && !ctx.budget_reached.load(std::memory_order_relaxed) &&
+            !monitor.checkMemoryLimit(0, degradeHeadroom(ctx.threads))) {
+            return false;
+        }
+        ctx.budget_reached.store(true, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        degradeRange(obj, left, right, degradation_);
+        return true;
+    }
+
+    /**
+     * Pending bytes after which a worker monitor merges into the tree's. A
+     * degrading build merges every change, so the checks of each task see the
+     * bytes of all others.
+     */
+    size_t workerMergeBytes() const {
+        return build_params_.limit_policy == MemoryLimitPolicy::Throw ? MemoryMonitor::WORKER_MERGE_BYTES : 0;
+    }
+
+    /**
+     * Arena for a work-stealing task starting on the calling thread: the
+     * worker's own, the build caller's, or a new one for a thread outside the
+     * pool that picked the task up while waiting for another build on the
+     * same pool
+     */
+    WorkerArena& taskArena(ConcurrentBuildContext& ctx, WorkStealingPool& thread_pool) {
+        const int worker = thread_pool.currentWorkerIndex();
+        if (worker >= 0) return *ctx.worker_arenas[worker];
+        if (std::this_thread::get_id() == ctx.caller) return *ctx.caller_arena;
+        return addWorkerArena(ctx);
+    }
+
+    /**
+     * Create a worker arena for a new build task
+     */
+    WorkerArena& addWorkerArena(ConcurrentBuildContext& ctx) {
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        worker_arenas_.push_back(std::make_unique<WorkerArena>(memory_monitor_, workerMergeBytes()));
+        return *worker_arenas_.back();
+    }
+#endif
+    
+    /**
+     * Get memory monitor
+     */
+    const MemoryMonitor& getMemoryMonitor() const {
+        return memory_monitor_;
+    }
+
+    /**
+     * Set the callback that build checks and bounded searches report memory
+     * pressure to, see MemoryMonitor::setPressureCallback()
+     */
+    void setMemoryPressureCallback(MemoryPressureCallback callback) {
+        memory_monitor_.setPressureCallback(std::move(callback));
+    }
+
+    /**
+     * Hot-path counters summed over all threads that searched or built this
+     * tree; all zero unless compiled with NANOFLANN_MONITOR_COUNTERS
+     */
+    MonitorCounters getCounters() const {
+        MonitorCounters counters;
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        counters_.addTo(counters);
+#endif
+        return counters;
+    }
+
+    /**
+     * Zero the counters, e.g. between the build and a measured query phase
+     */
+    void resetCounters() {
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        counters_.reset();
+#endif
+    }
+
+    /**
+     * Write getCounters() as one line to the Debug:: output sink, the one set
+     * with Debug::set_output_stream() or Debug::set_output_sink()
+     */
+    void reportCounters() const {
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        Debug::write_output(getCounters().format());
+#endif
+    }
+
+#ifdef NANOFLANN_MONITOR_COUNTERS
+protected:
+    /**
+     * Add the calling thread's tally of a finished query to its slot
+     */
+    void recordQuery(const detail::QueryTally& tally) const {
+        detail::CounterSlot& slot = counters_.local();
+        detail::CounterSlot::bump(slot.queries, 1);
+        detail::CounterSlot::bump(slot.nodes_visited, tally.nodes_visited);
+        detail::CounterSlot::bump(slot.leaves_scanned, tally.leaves_scanned);
+        detail::CounterSlot::bump(slot.distance_evaluations, tally.distance_evaluations);
+        detail::CounterSlot::bump(slot.pruned_branches, tally.pruned_branches);
+    }
+
+public:
+#endif
+    
+    /**
+     * Get current memory usage
+     */
+    size_t getCurrentMemoryUsage() const {
+        return memory_monitor_.getCurrentMemoryUsage();
+    }
+    
+    /**
+     * Get memory threshold
+     */
+    size_t getMemoryThreshold() const {
+        return memory_monitor_.getMemoryThreshold();
+    }
+    
+    /**
+     * Called once the tree is built: records its depth for the search dispatch
+     */
+    void finishTree() {
+        bindViews();
+        if (usesCompactNodes()) {
+            tree_depth_ = subtreeDepth(uint32_t(0));
+            degradation_.max_leaf_size = maxLeafSize(uint32_t(0));
+        } else if (Base::root_node_) {
+            tree_depth_ = subtreeDepth(Base::root_node_);
+            degradation_.max_leaf_size = maxLeafSize(Base::root_node_);
+        }
+    }
+
+    /**
+     * Search the whole tree from the root, whichever layout and traversal apply
+     */
+    template <class RESULTSET>
+    void searchTree(
+        RESULTSET& result_set, const ElementType* vec, DistanceType mindist,
+        typename Base::distance_vector_t& dists, const float epsError,
+        const bool iterative_search) const {
+        const bool iterative = iterative_search && tree_depth_ <= SEARCH_STACK_SIZE;
+        if (usesCompactNodes()) {
+            if (iterative) {
+                searchLevelIterative(result_set, vec, uint32_t(0), mindist, dists, epsError);
+            } else {
+                searchLevelCompact(result_set, vec, 0, mindist, dists, epsError);
+            }
+        } else if (iterative) {
+            searchLevelIterative(result_set, vec, Base::root_node_, mindist, dists, epsError);
+        } else {
+            searchLevel(result_set, vec, Base::root_node_, mindist, dists, epsError);
+        }
+    }
+
+    /**
+     * searchLevel() without recursion, for either layout
+     *
+     * Walks down towards the query and pushes the far child of each split with
+     * the mindist it would be entered with. After a leaf, pending far children
+     * are popped and pruned against the current worstDist(), which is when the
+     * recursion would test them, so results are identical. The dists entries a
+     * far child changes are kept in an undo log and rolled back before a
+     * shallower pending child is entered.
+     */
+    template <class RESULTSET, typename NodeRef>
+    bool searchLevelIterative(
+        RESULTSET& result_set, const ElementType* vec, NodeRef node,
+        DistanceType mindist, typename Base::distance_vector_t& dists,
+        const float epsError) const {
+        struct Pending {
+            NodeRef      node;
+            DistanceType mindist;
+            DistanceType cut_dist;
+            Dimension    idx;
+            size_t       undo_size;
+        };
+        struct Undo {
+            Dimension    idx;
+            DistanceType dist;
+        };
+        std::array<Pending, SEARCH_STACK_SIZE> pending;
+        std::array<Undo, SEARCH_STACK_SIZE> undo;
+        size_t pending_size = 0;
+        size_t undo_size = 0;
+        const auto& distance = static_cast<const Derived*>(this)->distance_;
+
+        for (;;) {
+            while (!isLeafNode(node)) {
+                NANOFLANN_MONITOR_COUNT(nodes_visited, 1);
+                Dimension    idx;
+                DistanceType divlow, divhigh;
+                NodeRef      child1, child2;
+                nodeSplit(node, idx, divlow, divhigh, child1, child2);
+
+                /* Which child branch should be taken first? */
+                ElementType  val   = vec[idx];
+                DistanceType diff1 = val - divlow;
+                DistanceType diff2 = val - divhigh;
+                NodeRef      otherChild;
+                DistanceType cut_dist;
+                if ((diff1 + diff2) < 0) {
+                    node       = child1;
+                    otherChild = child2;
+                    cut_dist   = distance.accum_dist(val, divhigh, idx);
+                } else {
+                    node       = child2;
+                    otherChild = child1;
+                    cut_dist   = distance.accum_dist(val, divlow, idx);
+                }
+                pending[pending_size++] = Pending{
+                    otherChild, mindist + cut_dist - dists[idx], cut_dist, idx, undo_size};
+            }
 
-            for (Dimension i = 0; i < dims; ++i) {
-                bbox[i].low  = std::min(left_bbox[i].low, right_bbox[i].low);
-                bbox[i].high = std::max(left_bbox[i].high, right_bbox[i].high);
+            NANOFLANN_MONITOR_COUNT(nodes_visited, 1);
+            if (!searchLeaf(result_set, vec, leafLeft(node), leafRight(node))) {
+                // the resultset doesn't want to receive any more points, we're done searching!
+                return false;
+            }
+
+            // Resume at the deepest far child that is still worth visiting
+            for (;;) {
+                if (pending_size == 0) {
+                    while (undo_size > 0) {
+                        --undo_size;
+                        dists[undo[undo_size].idx] = undo[undo_size].dist;
+                    }
+                    return true;
+                }
+                const Pending& next = pending[--pending_size];
+                if (next.mindist * epsError <= result_set.worstDist()) {
+                    while (undo_size > next.undo_size) {
+                        --undo_size;
+                        dists[undo[undo_size].idx] = undo[undo_size].dist;
+                    }
+                    undo[undo_size++] = Undo{next.idx, dists[next.idx]};
+                    dists[next.idx] = next.cut_dist;
+                    mindist = next.mindist;
+                    node = next.node;
+                    break;
+                }
+                NANOFLANN_MONITOR_COUNT(pruned_branches, 1);
             }
         }
+    }
 
-        return node;
+    // Node access shared by the linked and compact layouts
+    static bool isLeafNode(const NodePtr node) {
+        return (node->child1 == nullptr) && (node->child2 == nullptr);
     }
-    
-    /**
-     * Get memory monitor
-     */
-    const MemoryMonitor& getMemoryMonitor() const {
-        return memory_monitor_;
+    bool isLeafNode(const uint32_t index) const {
+        return (compact_view_[index].first & COMPACT_LEAF_FLAG) != 0;
     }
-    
+    static Offset leafLeft(const NodePtr node) { return node->node_type.lr.left; }
+    static Offset leafRight(const NodePtr node) { return node->node_type.lr.right; }
+    Offset leafLeft(const uint32_t index) const {
+        return compact_view_[index].first & ~COMPACT_LEAF_FLAG;
+    }
+    Offset leafRight(const uint32_t index) const { return compact_view_[index].second; }
+    static void nodeSplit(
+        const NodePtr node, Dimension& idx, DistanceType& divlow, DistanceType& divhigh,
+        NodePtr& child1, NodePtr& child2) {
+        idx     = node->node_type.sub.divfeat;
+        divlow  = node->node_type.sub.divlow;
+        divhigh = node->node_type.sub.divhigh;
+        child1  = node->child1;
+        child2  = node->child2;
+    }
+    void nodeSplit(
+        const uint32_t index, Dimension& idx, DistanceType& divlow, DistanceType& divhigh,
+        uint32_t& child1, uint32_t& child2) const {
+        const CompactNode& node = compact_view_[index];
+        idx     = static_cast<Dimension>(node.first);
+        divlow  = node.divlow;
+        divhigh = node.divhigh;
+        child1  = index + 1;
+        child2  = node.second;
+    }
+
+    template <typename NodeRef>
+    size_t subtreeDepth(const NodeRef node) const {
+        if (isLeafNode(node)) return 1;
+        Dimension    idx;
+        DistanceType divlow, divhigh;
+        NodeRef      child1, child2;
+        nodeSplit(node, idx, divlow, divhigh, child1, child2);
+        return 1 + std::max(subtreeDepth(child1), subtreeDepth(child2));
+    }
+
+    template <typename NodeRef>
+    size_t maxLeafSize(const NodeRef node) const {
+        if (isLeafNode(node)) return leafRight(node) - leafLeft(node);
+        Dimension    idx;
+        DistanceType divlow, divhigh;
+        NodeRef      child1, child2;
+        nodeSplit(node, idx, divlow, divhigh, child1, child2);
+        return std::max(maxLeafSize(child1), maxLeafSize(child2));
+    }
+
     /**
-     * Get current memory usage
+     * Check the points of a leaf, [left, right) in vAcc_
      */
-    size_t getCurrentMemoryUsage() const {
-        return memory_monitor_.getCurrentMemoryUsage();
+    template <class RESULTSET>
+    bool searchLeaf(
+        RESULTSET& result_set, const ElementType* vec, const Offset left, const Offset right) const {
+        NANOFLANN_MONITOR_COUNT(leaves_scanned, 1);
+        NANOFLANN_MONITOR_COUNT(distance_evaluations, right - left);
+        if (point_view_) return searchLeafStorage(result_set, vec, left, right);
+        DistanceType worst_dist = result_set.worstDist();
+        for (Offset i = left; i < right; ++i) {
+            const IndexType accessor = vacc_view_[i];
+            DistanceType    dist     = static_cast<const Derived*>(this)->distance_.evalMetric(
+                       vec, accessor, (DIM > 0 ? DIM : Base::dim_));
+            if (dist < worst_dist) {
+                if (!result_set.addPoint(dist, vacc_view_[i])) {
+                    // the resultset doesn't want to receive any more
+                    // points, we're done searching!
+                    return false;
+                }
+            }
+        }
+        return true;
     }
-    
+
     /**
-     * Get memory threshold
+     * searchLevel() over the compact node array
      */
-    size_t getMemoryThreshold() const {
-        return memory_monitor_.getMemoryThreshold();
+    template <class RESULTSET>
+    bool searchLevelCompact(
+        RESULTSET& result_set, const ElementType* vec, const uint32_t index,
+        DistanceType mindist, typename Base::distance_vector_t& dists,
+        const float epsError) const {
+        NANOFLANN_MONITOR_COUNT(nodes_visited, 1);
+        const CompactNode& node = compact_view_[index];
+        if (node.first & COMPACT_LEAF_FLAG) {
+            return searchLeaf(result_set, vec, node.first & ~COMPACT_LEAF_FLAG, node.second);
+        }
+
+        /* Which child branch should be taken first? */
+        Dimension    idx   = static_cast<Dimension>(node.first);
+        ElementType  val   = vec[idx];
+        DistanceType diff1 = val - node.divlow;
+        DistanceType diff2 = val - node.divhigh;
+        const auto&  distance = static_cast<const Derived*>(this)->distance_;
+
+        uint32_t     bestChild;
+        uint32_t     otherChild;
+        DistanceType cut_dist;
+        if ((diff1 + diff2) < 0) {
+            bestChild  = index + 1;
+            otherChild = node.second;
+            cut_dist   = distance.accum_dist(val, node.divhigh, idx);
+        } else {
+            bestChild  = node.second;
+            otherChild = index + 1;
+            cut_dist   = distance.accum_dist(val, node.divlow, idx);
+        }
+
+        if (!searchLevelCompact(result_set, vec, bestChild, mindist, dists, epsError)) {
+            return false;
+        }
+
+        DistanceType dst = dists[idx];
+        mindist          = mindist + cut_dist - dst;
+        dists[idx]       = cut_dist;
+        if (mindist * epsError <= result_set.worstDist()) {
+            if (!searchLevelCompact(result_set, vec, otherChild, mindist, dists, epsError)) {
+                return false;
+            }
+        } else {
+            NANOFLANN_MONITOR_COUNT(pruned_branches, 1);
+        }
+        dists[idx] = dst;
+        return true;
     }
-    
+
     /**
      * Search level implementation
      */
@@ -283,23 +2318,10 @@ public:
         RESULTSET& result_set, const ElementType* vec, const NodePtr node,
         DistanceType mindist, typename Base::distance_vector_t& dists,
         const float epsError) const {
+        NANOFLANN_MONITOR_COUNT(nodes_visited, 1);
         /* If this is a leaf node, then do check and return. */
         if ((node->child1 == nullptr) && (node->child2 == nullptr)) {
-            DistanceType worst_dist = result_set.worstDist();
-            for (Offset i = node->node_type.lr.left;
-                 i < node->node_type.lr.right; ++i) {
-                const IndexType accessor = Base::vAcc_[i];
-                DistanceType    dist     = static_cast<const Derived*>(this)->distance_.evalMetric(
-                           vec, accessor, (DIM > 0 ? DIM : Base::dim_));
-                if (dist < worst_dist) {
-                    if (!result_set.addPoint(dist, Base::vAcc_[i])) {
-                        // the resultset doesn't want to receive any more
-                        // points, we're done searching!
-                        return false;
-                    }
-                }
-            }
-            return true;
+            return searchLeaf(result_set, vec, node->node_type.lr.left, node->node_type.lr.right);
         }
 
         /* Which child branch should be taken first? */
@@ -340,6 +2362,8 @@ public:
                 // done searching!
                 return false;
             }
+        } else {
+            NANOFLANN_MONITOR_COUNT(pruned_branches, 1);
         }
         dists[idx] = dst;
         return true;
@@ -373,16 +2397,17 @@ public:
 /**
  * Memory-monitored KD-tree single index adaptor
  */
-template<typename Distance, typename DatasetAdaptor, int32_t DIM = -1, typename IndexType = uint32_t>
+template<typename Distance, typename DatasetAdaptor, int32_t DIM = -1, typename IndexType = uint32_t,
+         PointStorageLayout Layout = PointStorageLayout::SoA>
 class MemoryMonitoredKDTree 
     : public MemoryMonitoredKDTreeBase<
-          MemoryMonitoredKDTree<Distance, DatasetAdaptor, DIM, IndexType>,
-          Distance, DatasetAdaptor, DIM, IndexType> {
+          MemoryMonitoredKDTree<Distance, DatasetAdaptor, DIM, IndexType, Layout>,
+          Distance, DatasetAdaptor, DIM, IndexType, Layout> {
     
 public:
     using Base = MemoryMonitoredKDTreeBase<
-        MemoryMonitoredKDTree<Distance, DatasetAdaptor, DIM, IndexType>,
-        Distance, DatasetAdaptor, DIM, IndexType>;
+        MemoryMonitoredKDTree<Distance, DatasetAdaptor, DIM, IndexType, Layout>,
+        Distance, DatasetAdaptor, DIM, IndexType, Layout>;
     using typename Base::ElementType;
     using typename Base::DistanceType;
     using typename Base::Dimension;
@@ -392,6 +2417,11 @@ public:
     const DatasetAdaptor dataset_;
     const KDTreeSingleIndexAdaptorParams indexParams;
     Distance distance_;
+
+    /**
+     * Fewest points per thread for which the initial scan is split across threads
+     */
+    static constexpr Size PARALLEL_INIT_MIN_POINTS = Size(1) << 15;
     
     /**
      * Constructor with memory threshold
@@ -400,8 +2430,10 @@ public:
         const Dimension dimensionality, 
         const DatasetAdaptor& inputData,
         const KDTreeSingleIndexAdaptorParams& params,
-        size_t memory_threshold_bytes)
-        : Base(memory_threshold_bytes),
+        size_t memory_threshold_bytes,
+        const MemoryMonitorParams& monitor_params = {},
+        const MemoryMonitoredBuildParams& build_params = {})
+        : Base(memory_threshold_bytes, monitor_params, build_params),
           dataset_(inputData),
           indexParams(params),
           distance_(inputData) {
@@ -420,16 +2452,30 @@ public:
         const Dimension dimensionality, 
         const DatasetAdaptor& inputData,
         size_t memory_threshold_bytes,
-        const KDTreeSingleIndexAdaptorParams& params = {})
-        : MemoryMonitoredKDTree(dimensionality, inputData, params, memory_threshold_bytes) {
+        const KDTreeSingleIndexAdaptorParams& params = {},
+        const MemoryMonitorParams& monitor_params = {},
+        const MemoryMonitoredBuildParams& build_params = {})
+        : MemoryMonitoredKDTree(dimensionality, inputData, params, memory_threshold_bytes, monitor_params, build_params) {
         (void)dimensionality; // Suppress unused parameter warning
     }
     
 private:
+#ifndef NANOFLANN_NO_THREADS
+    // Runs batch queries whose search parameters name no thread_pool; created by
+    // the first such batch that has more than one chunk. Batches hold a
+    // reference, so setQueryThreads() can replace it while they run.
+    mutable std::shared_ptr<WorkStealingPool> query_pool_;
+    size_t query_threads_ = 0; // workers of query_pool_, 0 for hardware_concurrency()
+    mutable std::mutex query_pool_mutex_;
+#endif
+
     void init(const Dimension dimensionality) {
         Base::dim_ = dimensionality;
         Base::leaf_max_size_ = indexParams.leaf_max_size;
         Base::n_thread_build_ = indexParams.n_thread_build;
+        if (Base::n_thread_build_ == 0) {
+            Base::n_thread_build_ = std::max(std::thread::hardware_concurrency(), 1u);
+        }
         
         if (Base::dim_ == 0) {
             throw std::runtime_error("Error: dimensionality cannot be zero");
@@ -440,8 +2486,111 @@ private:
             throw std::runtime_error("Error: dataset is empty");
         }
         
-        init_vind();
-        computeBoundingBox(Base::root_bbox_);
+        // buildIndex() makes the only pass over the dataset, also for a deferred tree
+        Base::checkFootprint(Base::size_, indexParams);
+    }
+
+    void buildSequential() {
+        if (Base::build_params_.compact_nodes) {
+            Base::buildCompactTree(*this);
+        } else {
+            Base::root_node_ = Base::divideTree(*this, 0, Base::size_, Base::root_bbox_);
+        }
+    }
+
+#ifndef NANOFLANN_NO_THREADS
+    void buildConcurrent() {
+        typename Base::ConcurrentBuildContext ctx;
+        ctx.threads = Base::n_thread_build_;
+        try {
+            if (Base::build_params_.concurrent_mode == ConcurrentBuildMode::WorkStealing) {
+                Base::root_node_ = Base::buildOnThreadPool(*this, ctx);
+            } else {
+                Base::root_node_ = Base::divideTreeConcurrent(
+                    *this, 0, Base::size_, Base::root_bbox_, ctx,
+                    Base::memory_monitor_, Base::monitored_pool_);
+            }
+        } catch (...) {
+            // Report the failure that caused the cancellation, not a cancelled task
+            if (ctx.error) std::rethrow_exception(ctx.error);
+            throw;
+        }
+        if (Base::build_params_.compact_nodes) Base::flattenTree();
+    }
+#endif
+
+#ifndef NANOFLANN_NO_THREADS
+    /**
+     * Pool for batch queries: the one the search parameters name, else the
+     * tree's own pool of getQueryThreads() workers
+     * @return nullptr if batches run on the calling thread
+     */
+    std::shared_ptr<WorkStealingPool> queryPool(const MonitoredSearchParameters& searchParams) const {
+        if (searchParams.thread_pool) {
+            return std::shared_ptr<WorkStealingPool>(std::shared_ptr<void>(), searchParams.thread_pool);
+        }
+        std::lock_guard<std::mutex> lock(query_pool_mutex_);
+        const size_t threads = queryThreads();
+        if (threads <= 1) return nullptr;
+        if (!query_pool_) query_pool_ = std::make_shared<WorkStealingPool>(threads);
+        return query_pool_;
+    }
+
+    size_t queryThreads() const {
+        return query_threads_ ? query_threads_ : std::max(std::thread::hardware_concurrency(), 1u);
+    }
+#endif
+
+    /**
+     * Run body(begin, end, dists) over [0, num_queries) in chunks, on queryPool()
+     * when there is more than one chunk. dists is a per-thread scratch buffer that
+     * outlives the call, so steady-state batches do not allocate it.
+     */
+    template <typename Body>
+    void forEachQueryChunk(const Size num_queries, Size chunk_size,
+                           const MonitoredSearchParameters& searchParams, Body&& body) const {
+        if (num_queries == 0) return;
+        chunk_size = std::max<Size>(chunk_size, 1);
+        static thread_local typename Base::distance_vector_t scratch;
+#ifndef NANOFLANN_NO_THREADS
+        const std::shared_ptr<WorkStealingPool> thread_pool =
+            num_queries > chunk_size ? queryPool(searchParams) : nullptr;
+        if (thread_pool) {
+            WorkStealingPool::TaskGroup group;
+            for (Size begin = 0; begin < num_queries; begin += chunk_size) {
+                const Size end = std::min(begin + chunk_size, num_queries);
+                thread_pool->submit(group, [&body, begin, end]() {
+                    body(begin, end, scratch);
+                });
+            }
+            thread_pool->wait(group);
+            return;
+        }
+#endif
+        body(Size(0), num_queries, scratch);
+    }
+
+    /**
+     * Radius search into matches under query_memory_limit, reporting the
+     * outcome to the pressure callback
+     */
+    Size searchRadiusBounded(
+        const ElementType* query_point, const DistanceType radius,
+        std::vector<ResultItem<IndexType, DistanceType>>& matches,
+        typename Base::distance_vector_t& dists, bool& truncated,
+        const MonitoredSearchParameters& searchParams) const {
+        using Match = ResultItem<IndexType, DistanceType>;
+        const MemoryMonitor& monitor = Base::getMemoryMonitor();
+        const size_t limit = monitor.getParams().query_memory_limit;
+        const size_t max_results = limit ? limit / sizeof(Match) : std::numeric_limits<size_t>::max();
+        nanoflann::BoundedRadiusResultSet<DistanceType, IndexType> resultSet(radius, max_results, matches);
+        findNeighbors(resultSet, query_point, dists, searchParams);
+        truncated = resultSet.truncated();
+        const size_t bytes = resultSet.size() * sizeof(Match);
+        if (limit && (truncated || bytes >= monitor.getParams().pressure_ratio * static_cast<double>(limit))) {
+            monitor.reportPressure({MemoryPressureSource::Query, bytes, limit, truncated});
+        }
+        return resultSet.size();
     }
     
 public:
@@ -451,56 +2600,383 @@ public:
     void buildIndex() {
         Base::size_ = dataset_.kdtree_get_point_count();
         Base::size_at_index_build_ = Base::size_;
-        init_vind();
+        Base::checkFootprint(Base::size_, indexParams);
+        if (Base::size_ == 0) {
+            Base::vAcc_.clear();
+            Base::freeIndex(*this);
+            return;
+        }
+        initIndexAndBoundingBox();
         Base::freeIndex(*this);
         Base::size_at_index_build_ = Base::size_;
         
-        if (Base::size_ == 0) return;
-        
-        computeBoundingBox(Base::root_bbox_);
-        
-        // Check memory before starting tree construction
+        // Check memory before starting tree construction (fresh probe)
+        Base::getMemoryMonitor().invalidate();
         if (Base::getMemoryMonitor().checkMemoryLimit()) {
-            throw MemoryLimitExceededException(
-                "Memory limit exceeded before tree construction. "
-                "Current: " + std::to_string(Base::getCurrentMemoryUsage()) + 
-                " bytes, Threshold: " + std::to_string(Base::getMemoryThreshold()) + " bytes");
+            Base::getMemoryMonitor().throwLimitExceeded("before tree construction");
         }
         
-        // construct the tree
-        if (Base::n_thread_build_ == 1) {
-            Base::root_node_ = Base::divideTree(*this, 0, Base::size_, Base::root_bbox_);
-        } else {
+        // construct the tree; a failed build releases what it allocated
+        Base::degradation_ = {};
+        try {
+            if (Base::n_thread_build_ == 1) {
+                buildSequential();
+            } else {
             #ifndef NANOFLANN_NO_THREADS
-                std::atomic<unsigned int> thread_count(0u);
-                std::mutex mutex;
-                Base::root_node_ = Base::divideTreeConcurrent(
-                    *this, 0, Base::size_, Base::root_bbox_, thread_count, mutex);
+                buildConcurrent();
             #else
                 throw std::runtime_error("Multithreading is disabled");
             #endif
+            }
+            Base::finishTree();
+            Base::buildPointStorage(*this);
+        } catch (...) {
+            Base::freeIndex(*this);
+            throw;
+        }
+    }
+
+#ifdef NANOFLANN_MAPPED_INDEX
+    /**
+     * Write the built index to path as one flat file: header, root bounding box,
+     * nodes in the compact layout, vAcc_ and, when the tree has them, the
+     * reordered points. A tree of either layout can be saved; loadIndex() maps it.
+     *
+     * The file is written as path + ".tmp", synced and then renamed over path,
+     * so processes that still map an earlier file keep its contents, and a
+     * crash never leaves a partial file at path. The header goes in last.
+     */
+    void saveIndex(const std::string& path) const {
+        using Header = detail::MappedIndexHeader;
+        if (!Base::root_node_ && !Base::usesCompactNodes())
+            throw std::runtime_error("[nanoflann] saveIndex() called before building the index.");
+        const size_t dims = static_cast<size_t>(DIM > 0 ? DIM : Base::dim_);
+        if (!Base::usesCompactNodes()) Base::checkCompactRange();
+
+        Header header{};
+        header.magic          = Header::MAGIC;
+        header.version        = Header::VERSION;
+        header.index_bytes    = sizeof(IndexType);
+        header.element_bytes  = sizeof(ElementType);
+        header.distance_bytes = sizeof(DistanceType);
+        header.layout         = static_cast<uint32_t>(Layout);
+        header.flags          = Base::usesPointStorage() ? Header::HAS_POINTS : 0u;
+        header.dim            = static_cast<uint32_t>(dims);
+        header.size           = Base::size_;
+        header.node_count     = Base::usesCompactNodes() ? Base::node_count_ : Base::countNodes(Base::root_node_);
+        header.tree_depth     = Base::tree_depth_;
+        header.max_leaf_size  = Base::degradation_.max_leaf_size;
+        header.bbox_offset    = Header::align(sizeof(Header));
+        header.nodes_offset   = Header::align(header.bbox_offset + dims * sizeof(typename Base::Interval));
+        header.vacc_offset    = Header::align(
+            header.nodes_offset + header.node_count * sizeof(typename Base::CompactNode));
+        header.points_offset  = Header::align(header.vacc_offset + header.size * sizeof(IndexType));
+        header.file_bytes     = header.points_offset +
+            (Base::usesPointStorage() ? dims * header.size * sizeof(ElementType) : 0);
+
+        // Fill the file through a shared mapping, so nothing is staged on the heap
+        const std::string temp_path = path + ".tmp";
+        const int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot create index file " + temp_path + ": " + std::strerror(errno));
+        }
+        const auto fail = [&](const char* what) {
+            const int error = errno;
+            ::close(fd);
+            ::unlink(temp_path.c_str());
+            throw std::runtime_error(std::string("Cannot ") + what + " index file " + temp_path + ": " +
+                                     std::strerror(error));
+        };
+        // Reserve the blocks up front: a store into a sparse mapping on a full
+        // disk raises SIGBUS instead of returning an error
+        if (const int error = reserveFile(fd, header.file_bytes)) {
+            errno = error;
+            fail("size");
         }
+        void* map = ::mmap(nullptr, header.file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) fail("map");
+        char* bytes = static_cast<char*>(map);
+        auto* bbox = reinterpret_cast<typename Base::Interval*>(bytes + header.bbox_offset);
+        for (size_t d = 0; d < dims; ++d) bbox[d] = Base::root_bbox_[d];
+        auto* nodes = reinterpret_cast<typename Base::CompactNode*>(bytes + header.nodes_offset);
+        if (Base::usesCompactNodes()) {
+            std::memcpy(nodes, Base::compact_view_, header.node_count * sizeof(typename Base::CompactNode));
+        } else {
+            Base::writeCompactNodes(Base::root_node_, nodes, 0);
+        }
+        std::memcpy(bytes + header.vacc_offset, Base::vacc_view_, header.size * sizeof(IndexType));
+        if (Base::usesPointStorage()) {
+            std::memcpy(bytes + header.points_offset, Base::point_view_,
+                        dims * header.size * sizeof(ElementType));
+        }
+        // A zeroed header until the payload is complete, so a torn file never loads
+        header.checksum = header.computeChecksum();
+        std::memcpy(bytes, &header, sizeof(Header));
+        const bool synced = ::msync(map, header.file_bytes, MS_SYNC) == 0;
+        ::munmap(map, header.file_bytes);
+        if (!synced || ::fsync(fd) != 0) fail("sync");
+        if (::close(fd) != 0) {
+            const int error = errno;
+            ::unlink(temp_path.c_str());
+            throw std::runtime_error("Cannot write index file " + temp_path + ": " + std::strerror(error));
+        }
+        if (::rename(temp_path.c_str(), path.c_str()) != 0) {
+            const int error = errno;
+            ::unlink(temp_path.c_str());
+            throw std::runtime_error("Cannot replace index file " + path + ": " + std::strerror(error));
+        }
+    }
+
+    /**
+     * Replace the index with a file written by saveIndex(), mapped read-only.
+     * Processes mapping one file share its pages. The file must have been
+     * saved from the same dataset; it stays mapped until freeIndex(),
+     * buildIndex() or destruction.
+     *
+     * With verify, loading walks the nodes and vAcc_ once, O(n), so a damaged
+     * or hostile file is rejected instead of sending searches out of bounds:
+     * child indices, split dimensions, leaf ranges, point indices and the tree
+     * depth are checked. Without it only the header and the root bounding box
+     * are read, so loading takes the same time for any index size; pass false
+     * only for files this host wrote or otherwise trusts.
+     *
+     * Only resident pages of the mapping count against the budget: ProcessRSS
+     * sees them in the resident set, and TreeBytes accounts what mincore()
+     * reports at load and on refreshMappedAccounting().
+     *
+     * @param path  file written by saveIndex()
+     * @param verify  check the node and vAcc_ sections, not only the header
+     */
+    void loadIndex(const std::string& path, bool verify = true) {
+        using Header = detail::MappedIndexHeader;
+        Base::freeIndex(*this);
+
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open index file " + path + ": " + std::strerror(errno));
+        }
+        struct stat file_stat;
+        void* map = MAP_FAILED;
+        size_t file_bytes = 0;
+        if (::fstat(fd, &file_stat) == 0 && static_cast<size_t>(file_stat.st_size) >= sizeof(Header)) {
+            file_bytes = static_cast<size_t>(file_stat.st_size);
+            map = ::mmap(nullptr, file_bytes, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            throw std::runtime_error("Cannot map index file " + path);
+        }
+
+        Header header;
+        std::memcpy(&header, map, sizeof(Header));
+        const size_t dims = static_cast<size_t>(DIM > 0 ? DIM : Base::dim_);
+        const bool has_points = (header.flags & Header::HAS_POINTS) != 0;
+        const char* problem = nullptr;
+        if (header.magic != Header::MAGIC || header.version != Header::VERSION) {
+            problem = "not a saved index";
+        } else if (header.checksum != header.computeChecksum()) {
+            problem = "corrupted header";
+        } else if (header.index_bytes != sizeof(IndexType) || header.element_bytes != sizeof(ElementType) ||
+                   header.distance_bytes != sizeof(DistanceType) || header.dim != dims) {
+            problem = "saved with other index, element or distance types, or dimensionality";
+        } else if (header.size != dataset_.kdtree_get_point_count()) {
+            problem = "saved from a dataset with another point count";
+        } else if (has_points && header.layout != static_cast<uint32_t>(Layout)) {
+            problem = "points saved in another PointStorageLayout";
+        } else if (header.file_bytes != file_bytes) {
+            problem = "truncated";
+        } else if (!validSections(header, dims, has_points)) {
+            problem = "sections out of bounds";
+        } else if (verify && !validNodes(static_cast<const char*>(map), header, dims)) {
+            problem = "invalid nodes";
+        }
+        if (problem) {
+            ::munmap(map, file_bytes);
+            throw std::runtime_error("Invalid index file " + path + ": " + problem);
+        }
+
+        // The mapped vAcc_ replaces the owned one
+        std::vector<IndexType>().swap(Base::vAcc_);
+        Base::commitIndexStorage();
+        const char* bytes = static_cast<const char*>(map);
+        const auto* bbox = reinterpret_cast<const typename Base::Interval*>(bytes + header.bbox_offset);
+        resize(Base::root_bbox_, dims);
+        for (size_t d = 0; d < dims; ++d) Base::root_bbox_[d] = bbox[d];
+        Base::size_ = header.size;
+        Base::size_at_index_build_ = Base::size_;
+
+        Base::mapped_ = map;
+        Base::mapped_bytes_ = file_bytes;
+        Base::vacc_view_ = reinterpret_cast<const IndexType*>(bytes + header.vacc_offset);
+        Base::compact_view_ = reinterpret_cast<const typename Base::CompactNode*>(bytes + header.nodes_offset);
+        Base::node_count_ = header.node_count;
+        Base::point_view_ = has_points ? reinterpret_cast<const ElementType*>(bytes + header.points_offset) : nullptr;
+        Base::use_leaf_kernel_ = has_points && Base::build_params_.simd_leaves &&
+            Layout == PointStorageLayout::SoA && is_additive_metric<Distance>::value &&
+            leaf_kernel_supported<Distance, DIM, ElementType, DistanceType>::value;
+        Base::tree_depth_ = header.tree_depth;
+        Base::degradation_ = {};
+        Base::degradation_.max_leaf_size = header.max_leaf_size;
+
+        Base::refreshMappedAccounting();
+        if (Base::getMemoryMonitor().checkMemoryLimit()) {
+            Base::freeIndex(*this);
+            Base::getMemoryMonitor().throwLimitExceeded("by the resident pages of index file " + path);
+        }
+    }
+
+private:
+    /**
+     * Size fd to bytes with its blocks allocated
+     * @return 0, or the error number
+     */
+    static int reserveFile(int fd, uint64_t bytes) {
+#if defined(__APPLE__)
+        fstore_t store{F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(bytes), 0};
+        if (::fcntl(fd, F_PREALLOCATE, &store) == -1) return errno;
+        return ::ftruncate(fd, static_cast<off_t>(bytes)) == 0 ? 0 : errno;
+#else
+        return ::posix_fallocate(fd, 0, static_cast<off_t>(bytes));
+#endif
+    }
+
+    /**
+     * Whether the sections of a saved index lie in order inside the file, each
+     * aligned and large enough for what the header says it holds
+     */
+    static bool validSections(const detail::MappedIndexHeader& header, size_t dims, bool has_points) {
+        using Header = detail::MappedIndexHeader;
+        const uint64_t offsets[] = {header.bbox_offset, header.nodes_offset, header.vacc_offset,
+                                    header.points_offset};
+        for (uint64_t offset : offsets) {
+            if (offset % Header::ALIGNMENT != 0) return false;
+        }
+        // Divisions rather than products, so a hostile count cannot overflow
+        const auto fits = [](uint64_t begin, uint64_t end, uint64_t count, uint64_t item_bytes) {
+            return begin <= end && count <= (end - begin) / item_bytes;
+        };
+        return header.bbox_offset >= sizeof(Header) && header.node_count > 0 &&
+               header.points_offset <= header.file_bytes &&
+               fits(header.bbox_offset, header.nodes_offset, dims, sizeof(typename Base::Interval)) &&
+               header.nodes_offset < header.vacc_offset &&
+               fits(header.nodes_offset, header.vacc_offset, header.node_count,
+                    sizeof(typename Base::CompactNode)) &&
+               fits(header.vacc_offset, header.points_offset, header.size, sizeof(IndexType)) &&
+               (!has_points || fits(header.points_offset, header.file_bytes, header.size,
+                                    dims * sizeof(ElementType)));
+    }
+
+    /**
+     * Whether the nodes of a saved index form one tree in the compact layout:
+     * every node reached once from the root, children after their parent,
+     * split dimensions below dims, leaf ranges inside vAcc_, vAcc_ entries
+     * below the point count and the depth the header records
+     */
+    static bool validNodes(const char* bytes, const detail::MappedIndexHeader& header, size_t dims) {
+        using CompactNode = typename Base::CompactNode;
+        const auto* nodes = reinterpret_cast<const CompactNode*>(bytes + header.nodes_offset);
+        const auto* vacc = reinterpret_cast<const IndexType*>(bytes + header.vacc_offset);
+        const uint64_t count = header.node_count;
+        for (uint64_t i = 0; i < header.size; ++i) {
+            if (static_cast<uint64_t>(vacc[i]) >= header.size) return false;
+        }
+
+        // Explicit stack, so a degenerate file cannot exhaust the call stack
+        std::vector<bool> reached(count, false);
+        std::vector<std::pair<uint64_t, uint64_t>> stack{{0, 1}}; // node, depth
+        uint64_t visited = 0;
+        uint64_t depth = 0;
+        while (!stack.empty()) {
+            const auto [index, level] = stack.back();
+            stack.pop_back();
+            if (reached[index]) return false;
+            reached[index] = true;
+            ++visited;
+            depth = std::max(depth, level);
+            const CompactNode& node = nodes[index];
+            if (node.first & Base::COMPACT_LEAF_FLAG) {
+                const uint64_t left = node.first & ~Base::COMPACT_LEAF_FLAG;
+                if (left > node.second || node.second > header.size) return false;
+                continue;
+            }
+            // The first child follows its parent, the second comes after it
+            if (node.first >= dims || index + 1 >= count ||
+                node.second <= index + 1 || node.second >= count) {
+                return false;
+            }
+            stack.emplace_back(node.second, level + 1);
+            stack.emplace_back(index + 1, level + 1);
+        }
+        return visited == count && depth == header.tree_depth;
     }
+
+public:
+#endif // NANOFLANN_MAPPED_INDEX
     
+    /**
+     * Scratch buffers of repeated searches on one thread. Every buffer keeps
+     * its capacity, so once a context has seen the largest k and radius result
+     * of a workload, knnSearch() and radiusSearch() through it do not allocate.
+     * A context is not tied to one tree and must not be shared between threads.
+     */
+    struct QueryContext {
+        typename Base::distance_vector_t dists;   //!< per-dimension distances of findNeighbors()
+        std::vector<IndexType> indices;           //!< knnSearch(): the first found entries
+        std::vector<DistanceType> distances;      //!< knnSearch(): sorted, matching indices
+        std::vector<ResultItem<IndexType, DistanceType>> matches; //!< radiusSearch() results
+    };
+
+    /**
+     * Query context sized for this tree's dimensionality, with room for
+     * max_neighbors kNN results and radius matches
+     */
+    QueryContext makeQueryContext(const Size max_neighbors = 0) const {
+        QueryContext ctx;
+        resize(ctx.dists, (DIM > 0 ? DIM : Base::dim_));
+        ctx.indices.resize(max_neighbors);
+        ctx.distances.resize(max_neighbors);
+        ctx.matches.reserve(max_neighbors);
+        return ctx;
+    }
+
     // Implement search methods
     template <typename RESULTSET>
     bool findNeighbors(
         RESULTSET& result, const ElementType* vec,
-        const SearchParameters& searchParams = {}) const {
+        const MonitoredSearchParameters& searchParams = {}) const {
+        // fixed or variable-sized container (depending on DIM)
+        typename Base::distance_vector_t dists;
+        return findNeighbors(result, vec, dists, searchParams);
+    }
+
+    /**
+     * findNeighbors() with a caller-owned distance scratch buffer, so repeated
+     * queries on one thread do not allocate when DIM is dynamic
+     */
+    template <typename RESULTSET>
+    bool findNeighbors(
+        RESULTSET& result, const ElementType* vec,
+        typename Base::distance_vector_t& dists,
+        const MonitoredSearchParameters& searchParams = {}) const {
         assert(vec);
         if (Base::size(*this) == 0) return false;
-        if (!Base::root_node_)
+        if (!Base::root_node_ && !Base::usesCompactNodes())
             throw std::runtime_error(
                 "[nanoflann] findNeighbors() called before building the index.");
         float epsError = 1 + searchParams.eps;
 
-        // fixed or variable-sized container (depending on DIM)
-        typename Base::distance_vector_t dists;
         // Fill it with zeros.
         auto zero = static_cast<decltype(result.worstDist())>(0);
         assign(dists, (DIM > 0 ? DIM : Base::dim_), zero);
         DistanceType dist = Base::computeInitialDistances(*this, vec, dists);
-        Base::searchLevel(result, vec, Base::root_node_, dist, dists, epsError);
+#ifdef NANOFLANN_MONITOR_COUNTERS
+        detail::QueryTally& tally = detail::queryTally();
+        tally = detail::QueryTally{};
+        Base::searchTree(result, vec, dist, dists, epsError, searchParams.iterative);
+        Base::recordQuery(tally);
+#else
+        Base::searchTree(result, vec, dist, dists, epsError, searchParams.iterative);
+#endif
 
         if (searchParams.sorted) result.sort();
 
@@ -509,21 +2985,169 @@ public:
 
     Size knnSearch(
         const ElementType* query_point, const Size num_closest,
-        IndexType* out_indices, DistanceType* out_distances) const {
+        IndexType* out_indices, DistanceType* out_distances,
+        const MonitoredSearchParameters& searchParams = {}) const {
         nanoflann::KNNResultSet<DistanceType, IndexType> resultSet(num_closest);
         resultSet.init(out_indices, out_distances);
-        findNeighbors(resultSet, query_point);
+        findNeighbors(resultSet, query_point, searchParams);
         return resultSet.size();
     }
 
     Size radiusSearch(
         const ElementType* query_point, const DistanceType radius,
-        std::vector<std::pair<IndexType, DistanceType>>& IndicesDists) const {
+        std::vector<ResultItem<IndexType, DistanceType>>& IndicesDists,
+        const MonitoredSearchParameters& searchParams = {}) const {
         nanoflann::RadiusResultSet<DistanceType, IndexType> resultSet(radius, IndicesDists);
-        findNeighbors(resultSet, query_point);
+        findNeighbors(resultSet, query_point, searchParams);
         return resultSet.size();
     }
-    
+
+    /**
+     * knnSearch() into ctx.indices / ctx.distances, which grow to num_closest
+     * on first use
+     * @return number of results, the valid prefix of the context's buffers
+     */
+    Size knnSearch(
+        QueryContext& ctx, const ElementType* query_point, const Size num_closest,
+        const MonitoredSearchParameters& searchParams = {}) const {
+        if (ctx.indices.size() < num_closest) {
+            ctx.indices.resize(num_closest);
+            ctx.distances.resize(num_closest);
+        }
+        nanoflann::KNNResultSet<DistanceType, IndexType> resultSet(num_closest);
+        resultSet.init(ctx.indices.data(), ctx.distances.data());
+        findNeighbors(resultSet, query_point, ctx.dists, searchParams);
+        return resultSet.size();
+    }
+
+    /**
+     * radiusSearch() into ctx.matches, which is cleared first and keeps its capacity
+     */
+    Size radiusSearch(
+        QueryContext& ctx, const ElementType* query_point, const DistanceType radius,
+        const MonitoredSearchParameters& searchParams = {}) const {
+        nanoflann::RadiusResultSet<DistanceType, IndexType> resultSet(radius, ctx.matches);
+        findNeighbors(resultSet, query_point, ctx.dists, searchParams);
+        return resultSet.size();
+    }
+
+    /**
+     * radiusSearch() under the query budget, MemoryMonitorParams::query_memory_limit
+     *
+     * The search stops once the matches would need more than that many bytes,
+     * keeping the matches found so far (not necessarily the nearest) and setting
+     * truncated. A truncated search reports an exceeded MemoryPressureSource::Query
+     * event to the pressure callback; one whose matches reach pressure_ratio of
+     * the limit reports a pressure event. With no limit set this is radiusSearch().
+     */
+    Size radiusSearchBounded(
+        const ElementType* query_point, const DistanceType radius,
+        std::vector<ResultItem<IndexType, DistanceType>>& IndicesDists, bool& truncated,
+        const MonitoredSearchParameters& searchParams = {}) const {
+        typename Base::distance_vector_t dists;
+        return searchRadiusBounded(query_point, radius, IndicesDists, dists, truncated, searchParams);
+    }
+
+    /**
+     * radiusSearchBounded() into ctx.matches
+     */
+    Size radiusSearchBounded(
+        QueryContext& ctx, const ElementType* query_point, const DistanceType radius, bool& truncated,
+        const MonitoredSearchParameters& searchParams = {}) const {
+        return searchRadiusBounded(query_point, radius, ctx.matches, ctx.dists, truncated, searchParams);
+    }
+
+#ifndef NANOFLANN_NO_THREADS
+    /**
+     * Workers of the pool that runs batches given no thread_pool. Batches
+     * already running finish on the previous pool.
+     * @param threads  0 for std::thread::hardware_concurrency(), 1 for the calling thread only
+     */
+    void setQueryThreads(const size_t threads) {
+        std::lock_guard<std::mutex> lock(query_pool_mutex_);
+        query_threads_ = threads;
+        query_pool_.reset();
+    }
+
+    size_t getQueryThreads() const {
+        std::lock_guard<std::mutex> lock(query_pool_mutex_);
+        return queryThreads();
+    }
+#endif
+
+    /**
+     * kNN search for a batch of query points
+     *
+     * Query q is read from queries[q * dim] and its results are written to
+     * out_indices / out_distances[q * num_closest], sorted by distance. The
+     * batch is split into chunks of chunk_size queries that run on
+     * searchParams.thread_pool when one is set, else on a pool of
+     * getQueryThreads() workers the tree creates on first use, one per
+     * hardware thread unless setQueryThreads() says otherwise. With a count
+     * of 1 and no pool given they run on the calling thread.
+     * Nothing is allocated per query. searchParams applies to every query.
+     *
+     * @param out_counts optional, receives the number of results of each query
+     *        (less than num_closest only if the index holds fewer points)
+     */
+    void knnSearchBatch(
+        const ElementType* queries, const Size num_queries, const Size num_closest,
+        IndexType* out_indices, DistanceType* out_distances,
+        Size* out_counts = nullptr, const Size chunk_size = 256,
+        const MonitoredSearchParameters& searchParams = {}) const {
+        const Size dims = DIM > 0 ? DIM : Base::dim_;
+        forEachQueryChunk(num_queries, chunk_size, searchParams, [&](Size begin, Size end,
+                typename Base::distance_vector_t& dists) {
+            for (Size q = begin; q < end; ++q) {
+                Size found = 0;
+                if (num_closest > 0) {
+                    nanoflann::KNNResultSet<DistanceType, IndexType> resultSet(num_closest);
+                    resultSet.init(out_indices + q * num_closest, out_distances + q * num_closest);
+                    findNeighbors(resultSet, queries + q * dims, dists, searchParams);
+                    found = resultSet.size();
+                }
+                if (out_counts) out_counts[q] = found;
+            }
+        });
+    }
+
+    /**
+     * Radius search for a batch of query points, keeping at most max_results
+     * neighbours per query
+     *
+     * Same layout and threading as knnSearchBatch(): query q writes up to
+     * max_results neighbours closer than radius, nearest first, to
+     * out_indices / out_distances[q * max_results] and their number to
+     * out_counts[q]. As for radiusSearch(), radius is in the units of the
+     * distance metric (squared for L2).
+     */
+    void radiusSearchBatch(
+        const ElementType* queries, const Size num_queries,
+        const DistanceType radius, const Size max_results,
+        IndexType* out_indices, DistanceType* out_distances,
+        Size* out_counts, const Size chunk_size = 256,
+        const MonitoredSearchParameters& searchParams = {}) const {
+        assert(out_counts);
+        const Size dims = DIM > 0 ? DIM : Base::dim_;
+        forEachQueryChunk(num_queries, chunk_size, searchParams, [&](Size begin, Size end,
+                typename Base::distance_vector_t& dists) {
+            for (Size q = begin; q < end; ++q) {
+                Size found = 0;
+                if (max_results > 0) {
+                    // A kNN set whose initial worst distance is the radius keeps the
+                    // nearest max_results points inside it, already sorted
+                    nanoflann::KNNResultSet<DistanceType, IndexType> resultSet(max_results);
+                    DistanceType* dist_out = out_distances + q * max_results;
+                    resultSet.init(out_indices + q * max_results, dist_out);
+                    dist_out[max_results - 1] = radius;
+                    findNeighbors(resultSet, queries + q * dims, dists, searchParams);
+                    found = resultSet.size();
+                }
+                out_counts[q] = found;
+            }
+        });
+    }
+
     // Forward the required interface methods
     Size kdtree_get_point_count() const { return dataset_.kdtree_get_point_count(); }
     ElementType kdtree_get_pt(const IndexType idx, size_t dim) const { return dataset_.kdtree_get_pt(idx, dim); }
@@ -531,21 +3155,87 @@ public:
     template <class BBOX>
     bool kdtree_get_bbox(BBOX& bb) const { return dataset_.kdtree_get_bbox(bb); }
     
+    /**
+     * Fill vAcc_ with 0..size_-1, as nanoflann does; buildIndex() does this in
+     * initIndexAndBoundingBox() instead
+     */
     void init_vind() {
+        Base::checkIndexStorage(Base::size_);
         Base::vAcc_.resize(Base::size_);
-        for (Size i = 0; i < Base::size_; ++i) {
-            Base::vAcc_[i] = i;
-        }
+        Base::commitIndexStorage();
+        std::iota(Base::vAcc_.begin(), Base::vAcc_.end(), IndexType(0));
     }
     
+    /**
+     * Bounding box of the dataset: the adaptor's kdtree_get_bbox() when it
+     * provides one, else one pass over the points. Leaves vAcc_ alone.
+     */
     void computeBoundingBox(typename Base::BoundingBox& bbox) {
+        resize(bbox, (DIM > 0 ? DIM : Base::dim_));
+        if (dataset_.kdtree_get_bbox(bbox)) return;
+        if (Base::size_ == 0) {
+            throw std::runtime_error("[nanoflann] computeBoundingBox() called but no data points found.");
+        }
+        scanRange(0, Base::size_, bbox, false);
+    }
+    
+    /**
+     * Fill vAcc_ with 0..size_-1 and compute root_bbox_ in the same pass over the
+     * dataset, split across n_thread_build_ threads for large datasets. The
+     * adaptor's kdtree_get_bbox() replaces the reduction when it provides a box.
+     */
+    void initIndexAndBoundingBox() {
+        Base::checkIndexStorage(Base::size_);
+        Base::vAcc_.resize(Base::size_);
+        Base::commitIndexStorage();
+        resize(Base::root_bbox_, (DIM > 0 ? DIM : Base::dim_));
+        if (dataset_.kdtree_get_bbox(Base::root_bbox_)) {
+            std::iota(Base::vAcc_.begin(), Base::vAcc_.end(), IndexType(0));
+            return;
+        }
+
+        size_t threads = 1;
+#ifndef NANOFLANN_NO_THREADS
+        threads = std::max<size_t>(1, std::min<size_t>(Base::n_thread_build_, Base::size_ / PARALLEL_INIT_MIN_POINTS));
+#endif
+        if (threads == 1) {
+            scanRange(0, Base::size_, Base::root_bbox_);
+            return;
+        }
+#ifndef NANOFLANN_NO_THREADS
+        MemoryMonitor::ScopedBytes chunk_bboxes(Base::memory_monitor_, threads * Base::boundingBoxBytes());
+        std::vector<typename Base::BoundingBox> bboxes(threads, Base::root_bbox_);
+        const Size chunk = (Base::size_ + threads - 1) / threads;
+        std::vector<std::future<void>> tasks;
+        for (size_t t = 1; t < threads; ++t) {
+            tasks.push_back(std::async(std::launch::async, [this, &bboxes, chunk, t]() {
+                scanRange(t * chunk, std::min<Size>((t + 1) * chunk, Base::size_), bboxes[t]);
+            }));
+        }
+        scanRange(0, chunk, bboxes[0]);
+        for (auto& task : tasks) task.get();
+        Base::mergeBoundingBoxes(*this, bboxes[0], bboxes[1], Base::root_bbox_);
+        for (size_t t = 2; t < threads; ++t) {
+            Base::mergeBoundingBoxes(*this, Base::root_bbox_, bboxes[t], Base::root_bbox_);
+        }
+#endif
+    }
+
+    /**
+     * Bounding box of [begin, end) and, with fill_index, its vAcc_ entries,
+     * one read per coordinate
+     */
+    void scanRange(const Size begin, const Size end, typename Base::BoundingBox& bbox,
+                   const bool fill_index = true) {
         const auto dims = (DIM > 0 ? DIM : Base::dim_);
+        if (fill_index) Base::vAcc_[begin] = static_cast<IndexType>(begin);
         for (Dimension i = 0; i < dims; ++i) {
-            bbox[i].low = bbox[i].high = dataset_.kdtree_get_pt(Base::vAcc_[0], i);
+            bbox[i].low = bbox[i].high = dataset_.kdtree_get_pt(begin, i);
         }
-        for (Size k = 1; k < Base::size_; ++k) {
+        for (Size k = begin + 1; k < end; ++k) {
+            if (fill_index) Base::vAcc_[k] = static_cast<IndexType>(k);
             for (Dimension i = 0; i < dims; ++i) {
-                const auto val = dataset_.kdtree_get_pt(Base::vAcc_[k], i);
+                const auto val = dataset_.kdtree_get_pt(k, i);
                 if (bbox[i].low > val) bbox[i].low = val;
                 if (bbox[i].high < val) bbox[i].high = val;
             }
@@ -0,0 +1,167 @@
+/**
+ * SIMD leaf kernel for L2 KD-tree searches
+ *
+ * Computes the squared L2 distance from one query to a run of points stored
+ * structure-of-arrays (all x, then all y, ...), DIM = 2, 3 or 4. Uses AVX2 on
+ * x86-64: always when the translation unit is compiled with it (-mavx2 /
+ * -march=native), otherwise through a function compiled for AVX2 that GCC and
+ * Clang builds select at run time when the CPU has it. NEON on AArch64, and a
+ * plain loop the compiler can vectorize otherwise.
+ *
+ * Usage:
+ *   // coords[d * stride + i] is coordinate d of point i
+ *   nanoflann::leafL2Distances<3>(coords, stride, begin, count, query, out);
+ */
+
+#pragma once
+
+#include "../../../nanoflann/include/nanoflann.hpp"
+#include <cstddef>
+#include <type_traits>
+// NANOFLANN_LEAF_AVX2: 2 = AVX2 at compile time, 1 = chosen at run time
+#if defined(__AVX2__)
+#define NANOFLANN_LEAF_AVX2 2
+#define NANOFLANN_LEAF_AVX2_TARGET
+#include <immintrin.h>
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NANOFLANN_LEAF_AVX2 1
+#define NANOFLANN_LEAF_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace nanoflann {
+
+/**
+ * True for the nanoflann squared-L2 metrics the leaf kernel can replace
+ */
+template <class Distance>
+struct is_l2_metric : std::false_type {};
+
+template <class T, class DataSource, typename DistanceType, typename IndexType>
+struct is_l2_metric<L2_Adaptor<T, DataSource, DistanceType, IndexType>> : std::true_type {};
+
+template <class T, class DataSource, typename DistanceType, typename IndexType>
+struct is_l2_metric<L2_Simple_Adaptor<T, DataSource, DistanceType, IndexType>> : std::true_type {};
+
+/**
+ * Whether leafL2Distances() can serve a tree with this metric, dimension and types
+ */
+template <class Distance, int32_t DIM, typename ElementType, typename DistanceType>
+struct leaf_kernel_supported
+    : std::integral_constant<bool,
+          is_l2_metric<Distance>::value && DIM >= 2 && DIM <= 4 &&
+          std::is_same<ElementType, DistanceType>::value &&
+          (std::is_same<ElementType, float>::value || std::is_same<ElementType, double>::value)> {};
+
+namespace detail {
+
+template <int DIM, typename T>
+inline void leafL2DistancesScalar(
+    const T* coords, size_t stride, size_t begin, size_t count, const T* query, T* out) {
+    for (size_t j = 0; j < count; ++j) {
+        T dist = T();
+        for (int d = 0; d < DIM; ++d) {
+            const T diff = coords[d * stride + begin + j] - query[d];
+            dist += diff * diff;
+        }
+        out[j] = dist;
+    }
+}
+
+#if defined(NANOFLANN_LEAF_AVX2)
+/**
+ * The AVX2 part of leafL2Distances(): fills whole vectors of out and returns
+ * how many entries it wrote
+ */
+template <int DIM, typename T>
+NANOFLANN_LEAF_AVX2_TARGET inline size_t leafL2DistancesAvx2(
+    const T* coords, size_t stride, size_t begin, size_t count, const T* query, T* out) {
+    size_t j = 0;
+    if constexpr (std::is_same<T, float>::value) {
+        __m256 q[DIM];
+        for (int d = 0; d < DIM; ++d) q[d] = _mm256_set1_ps(query[d]);
+        for (; j + 8 <= count; j += 8) {
+            __m256 acc = _mm256_setzero_ps();
+            for (int d = 0; d < DIM; ++d) {
+                const __m256 diff = _mm256_sub_ps(
+                    _mm256_loadu_ps(coords + d * stride + begin + j), q[d]);
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(diff, diff));
+            }
+            _mm256_storeu_ps(out + j, acc);
+        }
+    } else {
+        __m256d q[DIM];
+        for (int d = 0; d < DIM; ++d) q[d] = _mm256_set1_pd(query[d]);
+        for (; j + 4 <= count; j += 4) {
+            __m256d acc = _mm256_setzero_pd();
+            for (int d = 0; d < DIM; ++d) {
+                const __m256d diff = _mm256_sub_pd(
+                    _mm256_loadu_pd(coords + d * stride + begin + j), q[d]);
+                acc = _mm256_add_pd(acc, _mm256_mul_pd(diff, diff));
+            }
+            _mm256_storeu_pd(out + j, acc);
+        }
+    }
+    return j;
+}
+#endif
+
+/**
+ * Whether leafL2Distances() runs its AVX2 path on this machine
+ */
+inline bool leafKernelUsesAvx2() {
+#if NANOFLANN_LEAF_AVX2 == 2
+    return true;
+#elif NANOFLANN_LEAF_AVX2 == 1
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+} // namespace detail
+
+/**
+ * out[j] = squared L2 distance between query and point begin + j, for j < count
+ */
+template <int DIM, typename T>
+inline void leafL2Distances(
+    const T* coords, size_t stride, size_t begin, size_t count, const T* query, T* out) {
+    static_assert(DIM >= 2 && DIM <= 4, "leaf kernel supports DIM 2 to 4");
+    size_t j = 0;
+#if defined(NANOFLANN_LEAF_AVX2)
+    if (detail::leafKernelUsesAvx2()) {
+        j = detail::leafL2DistancesAvx2<DIM>(coords, stride, begin, count, query, out);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if constexpr (std::is_same<T, float>::value) {
+        float32x4_t q[DIM];
+        for (int d = 0; d < DIM; ++d) q[d] = vdupq_n_f32(query[d]);
+        for (; j + 4 <= count; j += 4) {
+            float32x4_t acc = vdupq_n_f32(0.0f);
+            for (int d = 0; d < DIM; ++d) {
+                const float32x4_t diff = vsubq_f32(vld1q_f32(coords + d * stride + begin + j), q[d]);
+                acc = vaddq_f32(acc, vmulq_f32(diff, diff));
+            }
+            vst1q_f32(out + j, acc);
+        }
+    } else {
+        float64x2_t q[DIM];
+        for (int d = 0; d < DIM; ++d) q[d] = vdupq_n_f64(query[d]);
+        for (; j + 2 <= count; j += 2) {
+            float64x2_t acc = vdupq_n_f64(0.0);
+            for (int d = 0; d < DIM; ++d) {
+                const float64x2_t diff = vsubq_f64(vld1q_f64(coords + d * stride + begin + j), q[d]);
+                acc = vaddq_f64(acc, vmulq_f64(diff, diff));
+            }
+            vst1q_f64(out + j, acc);
+        }
+    }
+#endif
+    detail::leafL2DistancesScalar<DIM>(coords, stride, begin + j, count - j, query, out + j);
+}
+
+} // namespace nanoflann
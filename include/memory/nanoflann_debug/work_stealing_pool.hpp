@@ -0,0 +1,264 @@
+/**
+ * Work-stealing thread pool
+ *
+ * A fixed set of worker threads, each owning a task deque. Workers pop their
+ * own deque LIFO and steal from the others FIFO, so recursive fork/join work
+ * such as KD-tree construction stays balanced on unbalanced inputs. Threads
+ * that wait for a task group help by running queued tasks, and sleep only
+ * while there are none, until a task is submitted or the group finishes.
+ *
+ * The pool is created once and reused, e.g. across repeated buildIndex() calls.
+ *
+ * Usage:
+ *   nanoflann::WorkStealingPool pool(8);
+ *   nanoflann::WorkStealingPool::TaskGroup group;
+ *   pool.submit(group, [&]() { ... });
+ *   pool.wait(group); // rethrows the first exception thrown by a task
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nanoflann {
+
+class WorkStealingPool {
+public:
+    /**
+     * Set of tasks that can be waited for together
+     */
+    class TaskGroup {
+    public:
+        TaskGroup() = default;
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        /**
+         * Number of submitted tasks that have not finished yet
+         */
+        size_t pending() const {
+            return pending_.load(std::memory_order_acquire);
+        }
+
+    private:
+        friend class WorkStealingPool;
+
+        void fail(std::exception_ptr e) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = e;
+        }
+
+        std::atomic<size_t> pending_{0};
+        std::mutex mutex_;
+        std::exception_ptr error_;
+    };
+
+    /**
+     * @param num_threads number of worker threads (0 = one per hardware thread)
+     */
+    explicit WorkStealingPool(size_t num_threads = 0) {
+        if (num_threads == 0) {
+            num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        // One deque per worker, plus one for tasks submitted from outside the pool
+        for (size_t i = 0; i <= num_threads; ++i) {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+        threads_.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i) {
+            threads_.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        stop_.store(true);
+        {
+            std::lock_guard<std::mutex> lock(park_mutex_);
+            ++wake_generation_;
+        }
+        idle_cv_.notify_all();
+        waiter_cv_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * Number of worker threads
+     */
+    size_t size() const {
+        return threads_.size();
+    }
+
+    /**
+     * Index of the calling worker thread, or -1 if the caller is not a worker of this pool
+     */
+    int currentWorkerIndex() const {
+        return current_pool_ == this ? current_index_ : -1;
+    }
+
+    /**
+     * Queue a task. From a worker it goes to that worker's own deque.
+     */
+    void submit(TaskGroup& group, std::function<void()> task) {
+        group.pending_.fetch_add(1, std::memory_order_relaxed);
+        const int worker = currentWorkerIndex();
+        Queue& queue = *queues_[worker >= 0 ? static_cast<size_t>(worker) : threads_.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(Task{std::move(task), &group});
+        }
+        queued_.fetch_add(1);
+        wakeOne();
+    }
+
+    /**
+     * Run queued tasks until every task of the group has finished
+     * @throws the first exception thrown by a task of the group
+     */
+    void wait(TaskGroup& group) {
+        const int worker = currentWorkerIndex();
+        const size_t home = worker >= 0 ? static_cast<size_t>(worker) : threads_.size();
+        while (group.pending() > 0) {
+            if (!runOne(home)) {
+                park(&group);
+            }
+        }
+        if (group.error_) {
+            std::exception_ptr error = group.error_;
+            group.error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        TaskGroup* group;
+    };
+
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /**
+     * Pop from the home deque, or steal from the others
+     * @return true if a task was run
+     */
+    bool runOne(size_t home) {
+        Task task;
+        if (!popBack(home, task)) {
+            bool stolen = false;
+            for (size_t k = 1; k < queues_.size() && !stolen; ++k) {
+                stolen = stealFront((home + k) % queues_.size(), task);
+            }
+            if (!stolen) return false;
+        }
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        try {
+            task.fn();
+        } catch (...) {
+            task.group->fail(std::current_exception());
+        }
+        // The group may be gone once its waiter sees zero, so only the pool is used after this
+        if (task.group->pending_.fetch_sub(1) == 1 && waiters_.load() > 0) {
+            { std::lock_guard<std::mutex> lock(park_mutex_); }
+            waiter_cv_.notify_all();
+        }
+        return true;
+    }
+
+    bool popBack(size_t index, Task& task) {
+        Queue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool stealFront(size_t index, Task& task) {
+        Queue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    void workerLoop(size_t index) {
+        current_pool_ = this;
+        current_index_ = static_cast<int>(index);
+        while (!stop_.load()) {
+            if (runOne(index)) continue;
+            park(nullptr);
+        }
+    }
+
+    /**
+     * Sleep until a task is submitted, the group finishes (when waiting for
+     * one) or the pool stops. A sleeper registers before it looks at queued_
+     * and the group, and submit() and the last task of a group change those
+     * before they look at the sleeper counts, so one side always sees the other.
+     */
+    void park(const TaskGroup* group) {
+        std::atomic<size_t>& sleepers = group ? waiters_ : idle_;
+        std::condition_variable& cv = group ? waiter_cv_ : idle_cv_;
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        sleepers.fetch_add(1);
+        const uint64_t generation = wake_generation_;
+        cv.wait(lock, [&]() {
+            return stop_.load() || queued_.load() > 0 || wake_generation_ != generation ||
+                   (group && group->pending_.load() == 0);
+        });
+        sleepers.fetch_sub(1);
+    }
+
+    /**
+     * Wake one sleeper for a submitted task: an idle worker if there is one,
+     * else a thread waiting for a group, which runs the task meanwhile
+     */
+    void wakeOne() {
+        const bool idle = idle_.load() > 0;
+        if (!idle && waiters_.load() == 0) return;
+        {
+            std::lock_guard<std::mutex> lock(park_mutex_);
+            ++wake_generation_;
+        }
+        (idle ? idle_cv_ : waiter_cv_).notify_one();
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stop_{false};
+    std::atomic<size_t> queued_{0};
+
+    // Parking of idle workers and of group waiters without work to run. Each
+    // wakeup bumps the generation, so a woken sleeper knows it was meant.
+    std::mutex park_mutex_;
+    std::condition_variable idle_cv_;
+    std::condition_variable waiter_cv_;
+    uint64_t wake_generation_ = 0;
+    std::atomic<size_t> idle_{0};
+    std::atomic<size_t> waiters_{0};
+
+    static inline thread_local const WorkStealingPool* current_pool_ = nullptr;
+    static inline thread_local int current_index_ = -1;
+};
+
+} // namespace nanoflann
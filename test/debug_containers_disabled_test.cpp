@@ -0,0 +1,56 @@
+#ifndef DEBUG_CONTAINERS_DISABLE
+#define DEBUG_CONTAINERS_DISABLE
+#endif
+#include <gtest/gtest.h>
+#include <memory/container_debug/debug_containers.hpp>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// With DEBUG_CONTAINERS_DISABLE the Debug:: names are the std:: containers
+static_assert(std::is_same<Debug::vector<int>, std::vector<int>>::value, "vector");
+static_assert(std::is_same<Debug::string, std::string>::value, "string");
+static_assert(std::is_same<Debug::map<int, double>, std::map<int, double>>::value, "map");
+static_assert(std::is_same<Debug::unordered_set<int>, std::unordered_set<int>>::value, "unordered_set");
+static_assert(std::is_same<Debug::list<int>, std::list<int>>::value, "list");
+static_assert(std::is_same<Debug::queue<int>, std::queue<int>>::value, "queue");
+static_assert(std::is_same<Debug::priority_queue<int>, std::priority_queue<int>>::value, "priority_queue");
+static_assert(std::is_empty<Debug::SimpleAllocator<int>>::value, "SimpleAllocator holds no state");
+
+class DebugContainersDisabledTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        Debug::set_memory_threshold(1000);
+        Debug::set_output_sink([](std::string_view, void* context) {
+            ++*static_cast<int*>(context);
+        }, &reports);
+    }
+
+    void TearDown() override {
+        Debug::set_memory_threshold(Debug::DEFAULT_MEMORY_THRESHOLD);
+        Debug::set_output_sink(Debug::detail::stderr_sink);
+    }
+
+    int reports = 0;
+};
+
+// Nothing is reported or counted, and explicitly named allocators still work
+TEST_F(DebugContainersDisabledTest, NoTracking) {
+    struct PlannerTag {};
+    Debug::vector<double, Debug::SimpleAllocator<double, PlannerTag>> path;
+    path.reserve(10000);
+    path.resize(5000, 1.0);
+    EXPECT_EQ(path.size(), 5000u);
+
+    Debug::map<int, int, std::less<int>, Debug::PoolAllocator<std::pair<const int, int>>> pooled;
+    for (int i = 0; i < 1000; ++i) pooled[i] = i;
+    EXPECT_EQ(pooled.size(), 1000u);
+
+    int evaluated = 0;
+    DEBUG_ALLOC(++evaluated * 100000);
+    EXPECT_EQ(evaluated, 0);
+
+    EXPECT_EQ(reports, 0);
+    EXPECT_EQ(Debug::allocation_stats<PlannerTag>().allocations, 0u);
+    EXPECT_EQ(Debug::allocation_stats().live_bytes, 0u);
+}
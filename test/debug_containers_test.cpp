@@ -2,6 +2,31 @@
 #include <memory/container_debug/debug_containers.hpp>
 #include <iostream>
 #include <sstream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <cstring>
+#include <new>
+
+// Count global operator new calls, to check that reporting does not allocate
+static std::atomic<size_t> g_operator_new_calls{0};
+
+void* operator new(size_t size) {
+    g_operator_new_calls.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+// Not inlined, so GCC does not pair the free() with a new-expression and warn
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
 
 class DebugContainersTest : public ::testing::Test {
 protected:
@@ -601,6 +626,657 @@ TEST_F(DebugContainersTest, AllocatorFunctionality) {
     EXPECT_TRUE(output.str().empty());
 }
 
+// Test the string_view sink: same messages, no heap allocation while reporting
+TEST_F(DebugContainersTest, ZeroAllocationSink) {
+    struct Capture {
+        char text[Debug::MESSAGE_BUFFER_SIZE];
+        size_t size = 0;
+        size_t count = 0;
+    };
+    Capture capture;
+    Debug::set_output_sink([](std::string_view message, void* context) {
+        auto* c = static_cast<Capture*>(context);
+        std::memcpy(c->text, message.data(), message.size());
+        c->size = message.size();
+        ++c->count;
+    }, &capture);
+    
+    Debug::vector<int> vec;
+    const size_t before = g_operator_new_calls.load();
+    vec.reserve(5000); // DEBUG_ALLOC, then SimpleAllocator::allocate
+    const size_t after = g_operator_new_calls.load();
+    EXPECT_EQ(after, before);
+    EXPECT_EQ(capture.count, 2u);
+    const std::string last(capture.text, capture.size);
+    EXPECT_EQ(last, "[DEBUG] Large allocation detected: 20000 bytes (0.019073 MB)");
+    
+    capture.count = 0;
+    Debug::string str;
+    str.resize(5000);
+    EXPECT_GE(capture.count, 1u);
+    const std::string message(capture.text, capture.size);
+    EXPECT_TRUE(message.find("Large allocation detected") != std::string::npos);
+    
+    // The std::function stream still receives the same text
+    std::stringstream output;
+    Debug::set_output_stream([&output](const std::string& message) {
+        output << message << std::endl;
+    });
+    Debug::vector<int> vec2;
+    vec2.reserve(5000);
+    EXPECT_TRUE(output.str().find("TestBody") != std::string::npos);
+    EXPECT_TRUE(output.str().find("(vector::reserve)") != std::string::npos);
+    EXPECT_TRUE(output.str().find("[DEBUG] Large allocation detected: 20000 bytes (0.019073 MB)\n") != std::string::npos);
+    
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+// Test the asynchronous output mode: delivery from the drain thread and drop counting
+TEST_F(DebugContainersTest, AsyncOutput) {
+    struct Capture {
+        std::atomic<size_t> count{0};
+        std::atomic<bool> other_thread{false};
+        std::thread::id caller;
+        char last[Debug::MESSAGE_BUFFER_SIZE];
+        size_t last_size = 0;
+    };
+    Capture capture;
+    capture.caller = std::this_thread::get_id();
+    Debug::set_output_sink([](std::string_view message, void* context) {
+        auto* c = static_cast<Capture*>(context);
+        if (std::this_thread::get_id() != c->caller) c->other_thread = true;
+        std::memcpy(c->last, message.data(), message.size());
+        c->last_size = message.size();
+        c->count.fetch_add(1);
+    }, &capture);
+    
+    Debug::enable_async_output(64);
+    {
+        Debug::vector<int> vec;
+        vec.reserve(5000); // DEBUG_ALLOC, then SimpleAllocator::allocate
+    }
+    Debug::flush_async_output();
+    EXPECT_EQ(capture.count.load(), 2u);
+    EXPECT_TRUE(capture.other_thread.load());
+    const std::string message(capture.last, capture.last_size);
+    EXPECT_TRUE(message.find("Large allocation detected: 20000 bytes") != std::string::npos);
+    EXPECT_TRUE(message.find("[thread ") != std::string::npos);
+    
+    // Reports from several threads, more than the ring holds: some are dropped, none block
+    capture.count = 0;
+    const size_t dropped_before = Debug::async_dropped_events();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 200; ++i) DEBUG_ALLOC(size_t(5000));
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    Debug::disable_async_output();
+    EXPECT_EQ(capture.count.load() + Debug::async_dropped_events() - dropped_before, 800u);
+    
+    // Back to synchronous delivery on the calling thread
+    capture.count = 0;
+    capture.other_thread = false;
+    DEBUG_ALLOC(size_t(5000));
+    EXPECT_EQ(capture.count.load(), 1u);
+    EXPECT_FALSE(capture.other_thread.load());
+    
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+[[gnu::noinline]] static void reserve_large_vector() {
+    Debug::vector<int> vec;
+    vec.reserve(5000);
+}
+
+// Test sampled backtraces: raw addresses inline, symbolized on the drain thread
+TEST_F(DebugContainersTest, BacktraceSampling) {
+    std::vector<std::string> messages;
+    Debug::set_output_stream([&messages](const std::string& message) { messages.push_back(message); });
+    
+    // Off by default
+    reserve_large_vector();
+    ASSERT_FALSE(messages.empty());
+    for (const auto& message : messages) {
+        EXPECT_EQ(message.find("backtrace"), std::string::npos);
+    }
+    
+    // Every second report of this thread
+    Debug::set_backtrace_sampling(2);
+    EXPECT_EQ(Debug::get_backtrace_sampling(), 2u);
+    messages.clear();
+    for (int i = 0; i < 4; ++i) DEBUG_ALLOC(size_t(5000));
+    ASSERT_EQ(messages.size(), 4u);
+    size_t sampled = 0;
+    for (const auto& message : messages) {
+        if (message.find(" [backtrace: 0x") != std::string::npos) ++sampled;
+    }
+    EXPECT_EQ(sampled, 2u);
+    
+    // The drain thread resolves each frame to its module and offset
+    Debug::set_backtrace_sampling(1);
+    Debug::enable_async_output(64);
+    messages.clear();
+    reserve_large_vector();
+    Debug::flush_async_output();
+    Debug::disable_async_output();
+    ASSERT_FALSE(messages.empty());
+    const std::string& message = messages.back();
+    EXPECT_NE(message.find("\n    #0 "), std::string::npos) << message;
+    EXPECT_NE(message.find("\n    #1 "), std::string::npos) << message;
+    EXPECT_NE(message.find("debug_containers_test+0x"), std::string::npos) << message;
+    
+    char frame[256];
+    int local = 0;
+    EXPECT_GT(Debug::symbolize_frame(&local, frame, sizeof(frame)), 0u);
+    
+    Debug::set_backtrace_sampling(0);
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+// Test the per-callsite statistics registry
+TEST_F(DebugContainersTest, CallsiteStatistics) {
+    Debug::set_output_sink([](std::string_view, void*) {});
+    Debug::reset_callsite_stats();
+    
+    const int small_line = __LINE__ + 2;
+    for (size_t i = 1; i <= 3; ++i) {
+        DEBUG_ALLOC(i * 100);
+    }
+    const int large_line = __LINE__ + 1;
+    DEBUG_ALLOC(size_t(1) << 40);
+    // Container members count against the line that called them
+    Debug::vector<int> vec;
+    Debug::vector<int> other;
+    const int reserve_line = __LINE__ + 1;
+    vec.reserve(10);
+    const int other_reserve_line = __LINE__ + 1;
+    other.reserve(20);
+    
+    bool found_small = false;
+    bool found_reserve = false;
+    bool found_other_reserve = false;
+    for (const auto& site : Debug::callsite_stats()) {
+        if (std::string(site.file) == __FILE__ && site.line == small_line) {
+            found_small = true;
+            EXPECT_EQ(site.count, 3u);
+            EXPECT_EQ(site.total_bytes, 600u);
+            EXPECT_EQ(site.max_request_bytes, 300u);
+            EXPECT_STREQ(site.function, "TestBody");
+        }
+        if (std::string(site.file) == __FILE__ && site.line == reserve_line) {
+            found_reserve = true;
+            EXPECT_EQ(site.count, 1u);
+            EXPECT_EQ(site.total_bytes, 10 * sizeof(int));
+            EXPECT_NE(std::string(site.function).find("TestBody"), std::string::npos);
+        }
+        if (std::string(site.file) == __FILE__ && site.line == other_reserve_line) {
+            found_other_reserve = true;
+            EXPECT_EQ(site.count, 1u);
+            EXPECT_EQ(site.total_bytes, 20 * sizeof(int));
+        }
+        // The allocators count through AllocationCounters, not as sites
+        EXPECT_STRNE(site.function, "SimpleAllocator::allocate");
+    }
+    EXPECT_TRUE(found_small);
+    EXPECT_TRUE(found_reserve);
+    EXPECT_TRUE(found_other_reserve);
+    
+    // Repeated calls from one line compare names once, then probe by pointer
+    const size_t text_lookups = Debug::detail::callsite_text_lookups().load();
+    Debug::vector<int> grown;
+    const int grown_line = __LINE__ + 1;
+    for (size_t i = 1; i <= 100; ++i) grown.reserve(i * 10);
+    EXPECT_EQ(Debug::detail::callsite_text_lookups().load() - text_lookups, 1u);
+    for (const auto& site : Debug::callsite_stats()) {
+        if (std::string(site.file) == __FILE__ && site.line == grown_line) {
+            EXPECT_EQ(site.count, 100u);
+        }
+    }
+    
+    const auto top = Debug::top_callsites(2);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].line, large_line);
+    EXPECT_GE(top[0].total_bytes, top[1].total_bytes);
+    
+    Debug::reset_callsite_stats();
+    for (const auto& site : Debug::callsite_stats()) {
+        EXPECT_EQ(site.count, 0u);
+    }
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+// Test the live-byte, high-water and count tracking of SimpleAllocator
+TEST_F(DebugContainersTest, AllocationCounters) {
+    struct PlannerTag {};
+    using PlannerAllocator = Debug::SimpleAllocator<double, PlannerTag>;
+    Debug::set_output_sink([](std::string_view, void*) {});
+    
+    const auto global_before = Debug::allocation_stats();
+    EXPECT_EQ(Debug::allocation_stats<PlannerTag>().live_bytes, 0u);
+    {
+        Debug::vector<double, PlannerAllocator> vec;
+        vec.reserve(1000);
+        const auto tagged = Debug::allocation_stats<PlannerTag>();
+        EXPECT_EQ(tagged.live_bytes, 1000 * sizeof(double));
+        EXPECT_EQ(tagged.allocations, 1u);
+        EXPECT_EQ(Debug::allocation_stats().live_bytes, global_before.live_bytes + 1000 * sizeof(double));
+        
+        vec.reserve(3000); // grows: allocates 3000, frees 1000
+        const auto grown = Debug::allocation_stats<PlannerTag>();
+        EXPECT_EQ(grown.live_bytes, 3000 * sizeof(double));
+        EXPECT_EQ(grown.peak_bytes, 4000 * sizeof(double));
+        EXPECT_EQ(grown.deallocations, 1u);
+    }
+    const auto after = Debug::allocation_stats<PlannerTag>();
+    EXPECT_EQ(after.live_bytes, 0u);
+    EXPECT_EQ(after.peak_bytes, 4000 * sizeof(double));
+    EXPECT_EQ(after.allocations, after.deallocations);
+    Debug::reset_allocation_peak<PlannerTag>();
+    EXPECT_EQ(Debug::allocation_stats<PlannerTag>().peak_bytes, 0u);
+    
+    // Batches of other threads are merged when they exit
+    struct ThreadTag {};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([]() {
+            Debug::list<int, Debug::SimpleAllocator<int, ThreadTag>> nodes;
+            for (int i = 0; i < 1000; ++i) nodes.push_back(i);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    const auto threaded = Debug::allocation_stats<ThreadTag>();
+    EXPECT_EQ(threaded.allocations, 4000u);
+    EXPECT_EQ(threaded.deallocations, 4000u);
+    EXPECT_EQ(threaded.live_bytes, 0u);
+    EXPECT_GT(threaded.peak_bytes, 0u);
+    
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+// Test the slab-backed pool allocator for node containers
+TEST_F(DebugContainersTest, PoolAllocator) {
+    struct PoolTag {};
+    std::vector<std::string> reports;
+    Debug::set_output_sink([](std::string_view message, void* context) {
+        static_cast<std::vector<std::string>*>(context)->emplace_back(message);
+    }, &reports);
+    
+    {
+        const size_t reserved_before = Debug::pool_reserved_bytes();
+        Debug::map<int, int, std::less<int>, Debug::PoolAllocator<std::pair<const int, int>, PoolTag>> pooled;
+        for (int i = 0; i < 1000; ++i) pooled[i] = i * 2;
+        EXPECT_EQ(pooled.size(), 1000u);
+        EXPECT_EQ(pooled[500], 1000);
+        
+        // 1000 nodes come from a few whole slabs
+        const size_t reserved = Debug::pool_reserved_bytes() - reserved_before;
+        EXPECT_GT(reserved, 0u);
+        EXPECT_LE(reserved, 2 * 1000 * 64 + 16 * 1024u);
+        EXPECT_EQ(Debug::allocation_stats<PoolTag>().allocations, 1000u);
+        
+        // Freed nodes are handed out again before any new slab
+        pooled.clear();
+        for (int i = 0; i < 1000; ++i) pooled[i] = i;
+        EXPECT_EQ(Debug::pool_reserved_bytes() - reserved_before, reserved);
+    }
+    EXPECT_EQ(Debug::allocation_stats<PoolTag>().live_bytes, 0u);
+    
+    // Bucket arrays are not single nodes and still trigger the threshold report
+    reports.clear();
+    {
+        Debug::unordered_set<int, std::hash<int>, std::equal_to<int>, Debug::PoolAllocator<int>> buckets;
+        buckets.reserve(1000);
+        buckets.insert(1);
+        EXPECT_EQ(buckets.count(1), 1u);
+    }
+    ASSERT_FALSE(reports.empty());
+    EXPECT_NE(reports[0].find("Large allocation detected"), std::string::npos);
+    
+    // Nodes freed on another thread than the one that allocated them
+    Debug::list<int, Debug::PoolAllocator<int>> shared_nodes;
+    std::thread producer([&shared_nodes]() {
+        for (int i = 0; i < 5000; ++i) shared_nodes.push_back(i);
+    });
+    producer.join();
+    EXPECT_EQ(shared_nodes.size(), 5000u);
+    EXPECT_EQ(shared_nodes.back(), 4999);
+    shared_nodes.clear();
+    
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+// Test that nodes built on one thread and freed on another are reused
+TEST_F(DebugContainersTest, PoolAllocatorCrossThreadFrees) {
+    using PooledList = Debug::list<int, Debug::PoolAllocator<int>>;
+    constexpr int ROUNDS = 200;
+    constexpr int NODES = 1000;
+    std::mutex mutex;
+    std::condition_variable handoff;
+    std::optional<PooledList> pending;
+    bool done = false;
+    
+    // A long-lived consumer, so its free list never moves on thread exit
+    std::thread consumer([&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            handoff.wait(lock, [&]() { return pending || done; });
+            if (!pending) return;
+            pending.reset(); // frees the nodes on this thread
+            handoff.notify_all();
+        }
+    });
+    
+    size_t reserved_after_warmup = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        PooledList nodes;
+        for (int i = 0; i < NODES; ++i) nodes.push_back(i);
+        std::unique_lock<std::mutex> lock(mutex);
+        pending.emplace(std::move(nodes));
+        handoff.notify_all();
+        handoff.wait(lock, [&]() { return !pending; });
+        if (round == 1) reserved_after_warmup = Debug::pool_reserved_bytes();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    handoff.notify_all();
+    consumer.join();
+    
+    // Without reuse every round would take NODES new nodes from fresh slabs
+    const size_t growth = Debug::pool_reserved_bytes() - reserved_after_warmup;
+    EXPECT_LT(growth, 4 * 16 * 1024u);
+}
+
+// Test changing threshold and sink while other threads allocate
+TEST_F(DebugContainersTest, ConcurrentConfiguration) {
+    static std::atomic<size_t> sink_a_calls{0};
+    static std::atomic<size_t> sink_b_calls{0};
+    auto sink_a = [](std::string_view, void*) { sink_a_calls.fetch_add(1); };
+    auto sink_b = [](std::string_view, void*) { sink_b_calls.fetch_add(1); };
+    Debug::set_output_sink(sink_a);
+    
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&stop]() {
+            while (!stop.load()) {
+                Debug::vector<char> buffer;
+                buffer.reserve(4000);
+            }
+        });
+    }
+    const uint64_t version_before = Debug::config_version();
+    for (int i = 0; i < 200; ++i) {
+        Debug::set_memory_threshold(i % 2 ? 1000 : 1000000);
+        Debug::set_output_sink(i % 3 ? sink_a : sink_b);
+        std::this_thread::yield();
+    }
+    stop.store(true);
+    for (auto& thread : threads) thread.join();
+    
+    EXPECT_EQ(Debug::config_version(), version_before + 400);
+    EXPECT_GT(sink_a_calls.load() + sink_b_calls.load(), 0u);
+    
+    // The last setter wins, and a std::function stream lives in its snapshot
+    std::vector<std::string> messages;
+    Debug::set_memory_threshold(1000);
+    Debug::set_output_stream([&messages](const std::string& message) { messages.push_back(message); });
+    {
+        Debug::vector<int> vec;
+        vec.reserve(1000);
+    }
+    ASSERT_EQ(messages.size(), 2u); // DEBUG_ALLOC in reserve(), then the allocator
+    EXPECT_NE(messages[0].find("Large allocation detected"), std::string::npos);
+    EXPECT_EQ(Debug::get_memory_threshold(), 1000u);
+    
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+// Test reallocation tracking of vectors and strings grown without reserve()
+TEST_F(DebugContainersTest, GrowthDetection) {
+    std::vector<std::string> messages;
+    Debug::set_output_stream([&messages](const std::string& message) { messages.push_back(message); });
+    Debug::set_memory_threshold(Debug::DEFAULT_MEMORY_THRESHOLD);
+    
+    {
+        Debug::vector<int> grown;
+        for (int i = 0; i < 1000; ++i) grown.push_back(i);
+        const Debug::GrowthStats& stats = grown.growth_stats();
+        EXPECT_GE(stats.reallocations, 8u);
+        EXPECT_GE(stats.bytes_copied, 500 * sizeof(int));
+        EXPECT_EQ(stats.peak_size, 1000u);
+        EXPECT_TRUE(messages.empty());
+    }
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_NE(messages[0].find("Repeated reallocation detected: Debug::vector"), std::string::npos);
+    EXPECT_NE(messages[0].find("suggested reserve(1000)"), std::string::npos);
+    
+    // Reserved up front: no reallocation and no report
+    messages.clear();
+    {
+        Debug::vector<int> reserved;
+        reserved.reserve(1003);
+        for (int i = 0; i < 1000; ++i) reserved.emplace_back(i);
+        reserved.insert(reserved.begin(), {1, 2, 3});
+        EXPECT_EQ(reserved.growth_stats().reallocations, 0u);
+    }
+    EXPECT_TRUE(messages.empty());
+
+    // The history moves with the buffer: a vector filled in a function and
+    // returned is reported once, by the vector that ends up owning it
+    auto fill = [](bool first) {
+        Debug::vector<int> a, b;
+        Debug::vector<int>& target = first ? a : b; // two candidates, so no NRVO
+        for (int i = 0; i < 100000; ++i) target.push_back(i);
+        return first ? std::move(a) : std::move(b);
+    };
+    {
+        Debug::vector<int> returned = fill(true);
+        EXPECT_GE(returned.growth_stats().reallocations, 8u);
+        EXPECT_EQ(returned.growth_stats().peak_size, 100000u);
+        EXPECT_TRUE(messages.empty());
+
+        Debug::vector<int> assigned;
+        assigned = std::move(returned);
+        EXPECT_EQ(returned.growth_stats().reallocations, 0u);
+        EXPECT_EQ(assigned.growth_stats().peak_size, 100000u);
+        EXPECT_TRUE(messages.empty());
+    }
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_NE(messages[0].find("suggested reserve(100000)"), std::string::npos);
+    messages.clear();
+
+    // Strings grown by appending
+    {
+        Debug::string text;
+        for (int i = 0; i < 2000; ++i) text += 'x';
+        text.append("abc");
+        EXPECT_GE(text.growth_stats().reallocations, 4u);
+        EXPECT_EQ(text.growth_stats().peak_size, 2003u);
+    }
+    Debug::set_growth_report_threshold(0);
+    {
+        Debug::vector<double> quiet;
+        for (int i = 0; i < 1000; ++i) quiet.push_back(i);
+    }
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_NE(messages[0].find("Debug::basic_string"), std::string::npos);
+    
+    Debug::set_growth_report_threshold(Debug::DEFAULT_GROWTH_REPORT_THRESHOLD);
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+// Test reporting of range, initializer-list, assign and insert paths, and that
+// moves and forwarding add no copies
+TEST_F(DebugContainersTest, FullApiInstrumentation) {
+    std::vector<std::string> messages;
+    Debug::set_output_stream([&messages](const std::string& message) { messages.push_back(message); });
+    auto reported = [&messages](const char* function) {
+        for (const auto& message : messages) {
+            if (message.find("Large allocation detected") != std::string::npos &&
+                message.find(function) != std::string::npos) return true;
+        }
+        return false;
+    };
+    
+    std::vector<int> source(2000, 7);
+    
+    messages.clear();
+    Debug::vector<int> from_range(source.begin(), source.end());
+    EXPECT_EQ(from_range.size(), 2000u);
+    EXPECT_TRUE(reported("vector"));
+    
+    messages.clear();
+    Debug::vector<int> assigned;
+    assigned.assign(source.begin(), source.end());
+    EXPECT_TRUE(reported("assign"));
+    
+    messages.clear();
+    Debug::vector<int> inserted;
+    inserted.insert(inserted.end(), 1000, 3);
+    EXPECT_TRUE(reported("insert"));
+    
+    messages.clear();
+    Debug::deque<int> from_list = {1, 2, 3};
+    from_list.insert(from_list.end(), source.begin(), source.end());
+    EXPECT_EQ(from_list.size(), 2003u);
+    EXPECT_TRUE(reported("insert"));
+    
+    messages.clear();
+    Debug::map<int, int> map;
+    std::vector<std::pair<const int, int>> pairs;
+    for (int i = 0; i < 500; ++i) pairs.emplace_back(i, i);
+    map.insert(pairs.begin(), pairs.end());
+    map.insert({-1, -1});
+    EXPECT_EQ(map.size(), 501u);
+    EXPECT_TRUE(reported("insert"));
+    
+    messages.clear();
+    Debug::unordered_set<int> buckets;
+    buckets.rehash(1000);
+    EXPECT_TRUE(reported("rehash"));
+    
+    messages.clear();
+    Debug::list<int> small_list = {1, 2, 3};
+    small_list.insert(small_list.end(), 4);
+    Debug::set<int> small_set{1, 2, 3};
+    EXPECT_TRUE(messages.empty());
+    
+    // Moves are noexcept like their std:: counterparts, and forward without copies
+    static_assert(std::is_nothrow_move_constructible<Debug::vector<int>>::value, "vector move");
+    static_assert(std::is_nothrow_move_assignable<Debug::vector<int>>::value, "vector move assign");
+    static_assert(std::is_nothrow_move_constructible<Debug::string>::value, "string move");
+    static_assert(std::is_nothrow_move_constructible<Debug::list<int>>::value, "list move");
+    static_assert(std::is_nothrow_move_constructible<Debug::map<int, int>>::value, "map move");
+    struct Counted {
+        int* copies;
+        explicit Counted(int* c) : copies(c) {}
+        Counted(const Counted& other) : copies(other.copies) { ++*copies; }
+        Counted(Counted&& other) noexcept : copies(other.copies) {}
+        Counted& operator=(const Counted&) = default;
+        Counted& operator=(Counted&&) noexcept = default;
+    };
+    int copies = 0;
+    Debug::vector<Counted> counted;
+    for (int i = 0; i < 100; ++i) counted.emplace_back(&copies);
+    counted.push_back(Counted(&copies));
+    Debug::vector<Counted> moved(std::move(counted));
+    Debug::deque<Counted> deque;
+    deque.emplace_back(&copies);
+    Debug::deque<Counted> moved_deque = std::move(deque);
+    EXPECT_EQ(copies, 0);
+    EXPECT_EQ(moved.size(), 101u);
+
+    // vector<bool> hands out proxy references
+    Debug::vector<bool> flags;
+    flags.emplace_back(true);
+    flags.emplace_back(false) = true;
+    flags.push_back(false);
+    EXPECT_EQ(flags, Debug::vector<bool>({true, true, false}));
+
+    Debug::string text("a long enough string to leave the inline buffer behind");
+    text.replace(0, 1, 500, 'x');
+    Debug::string copy = text;
+    EXPECT_EQ(copy, text);
+    
+    // Assignments from the std::basic_string the operators return
+    messages.clear();
+    Debug::string joined;
+    joined = text + copy;
+    EXPECT_EQ(joined.size(), 2 * text.size());
+    EXPECT_TRUE(reported("operator="));
+    const Debug::string::base_type plain(text);
+    joined = plain;
+    EXPECT_EQ(joined, text);
+    
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
+// Test that container reports name the line that called the member, not the header
+TEST_F(DebugContainersTest, CallerLocation) {
+    std::vector<std::string> messages;
+    Debug::set_output_stream([&messages](const std::string& message) { messages.push_back(message); });
+    auto reported_at = [&messages](int line, const char* operation) {
+        const std::string location = std::string(__FILE__) + ":" + std::to_string(line) + " ";
+        for (const auto& message : messages) {
+            if (message.find(location) != std::string::npos &&
+                message.find(operation) != std::string::npos) return true;
+        }
+        return false;
+    };
+    
+    const int construct_line = __LINE__ + 1;
+    Debug::vector<int> vec(5000);
+    EXPECT_TRUE(reported_at(construct_line, "(vector::vector)"));
+    
+    const int resize_line = __LINE__ + 1;
+    vec.resize(10000);
+    EXPECT_TRUE(reported_at(resize_line, "(vector::resize)"));
+    
+    Debug::unordered_map<int, int> map;
+    const int reserve_line = __LINE__ + 1;
+    map.reserve(1000);
+    EXPECT_TRUE(reported_at(reserve_line, "(unordered_map::reserve)"));
+    
+    Debug::string text;
+    const int string_line = __LINE__ + 1;
+    text.resize(2000, 'x');
+    EXPECT_TRUE(reported_at(string_line, "(basic_string::resize)"));
+    
+    // A copy is still a copy constructor, and reports where it was made
+    const int copy_line = __LINE__ + 1;
+    Debug::vector<int> copy = vec;
+    EXPECT_TRUE(reported_at(copy_line, "(vector::vector)"));
+    static_assert(std::is_copy_constructible<Debug::vector<int>>::value, "vector copy");
+    
+    // Direct copies of non-const lvalues too, not the forwarding constructor
+    const int direct_copy_line = __LINE__ + 1;
+    Debug::vector<int> direct_copy(vec);
+    EXPECT_TRUE(reported_at(direct_copy_line, "(vector::vector)"));
+    const int string_copy_line = __LINE__ + 1;
+    Debug::string text_copy(text);
+    EXPECT_TRUE(reported_at(string_copy_line, "(basic_string::basic_string)"));
+    Debug::map<int, int> ordered;
+    for (int i = 0; i < 200; ++i) ordered.emplace(i, i);
+    const int map_copy_line = __LINE__ + 1;
+    Debug::map<int, int> ordered_copy(ordered);
+    EXPECT_TRUE(reported_at(map_copy_line, "(map::map)"));
+    
+    // The header never appears as the location of a container report
+    for (const auto& message : messages) {
+        EXPECT_EQ(message.find("debug_containers.hpp"), std::string::npos) << message;
+    }
+    
+    // A copy with an allocator still goes through the forwarding constructor
+    Debug::vector<int> with_allocator(vec, Debug::SimpleAllocator<int>());
+    EXPECT_EQ(with_allocator.size(), vec.size());
+    
+    Debug::set_output_sink(Debug::detail::stderr_sink);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
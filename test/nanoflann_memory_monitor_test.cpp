@@ -4,9 +4,44 @@
 #include <random>
 #include <memory>
 #include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <csignal>
 
 // Include the nanoflann memory monitor
 #include "../include/memory/nanoflann_debug/nanoflann_memory_monitor.hpp"
+#include "../include/memory/nanoflann_debug/nanoflann_dynamic_memory_monitor.hpp"
+
+// Heap allocations through operator new, for the allocation-free query test
+static std::atomic<size_t> g_heap_allocations{0};
+
+void* operator new(std::size_t size) {
+    ++g_heap_allocations;
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+// GCC flags malloc/free inside replaced operators once they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 
 // Test fixture for nanoflann memory monitor tests
 class NanoflannMemoryMonitorTest : public ::testing::Test {
@@ -211,7 +246,1665 @@ TEST_F(NanoflannMemoryMonitorTest, SinglePoint) {
     EXPECT_EQ(num_found, 1);
 }
 
+// Test that checks between probes reuse the cached value
+TEST_F(NanoflannMemoryMonitorTest, ProbeIntervalByCount) {
+    nanoflann::MemoryMonitor monitor(SIZE_MAX / 2, nanoflann::MemoryMonitorParams(8, 0));
+    
+    // First check always probes, then one probe every 8 checks
+    for (int i = 0; i < 17; ++i) {
+        EXPECT_FALSE(monitor.checkMemoryLimit());
+    }
+    EXPECT_EQ(monitor.getProbeCount(), 3);
+    EXPECT_GT(monitor.getCachedMemoryUsage(), 0);
+}
+
+// Test that reported bytes trigger a probe once the byte interval is reached
+TEST_F(NanoflannMemoryMonitorTest, ProbeIntervalByBytes) {
+    nanoflann::MemoryMonitor monitor(SIZE_MAX / 2, nanoflann::MemoryMonitorParams(0, 1000));
+    
+    monitor.checkMemoryLimit();
+    monitor.checkMemoryLimit(600);
+    EXPECT_EQ(monitor.getProbeCount(), 1);
+    monitor.checkMemoryLimit(600);
+    EXPECT_EQ(monitor.getProbeCount(), 2);
+    
+    // Bytes reported since the last probe count toward the limit
+    nanoflann::MemoryMonitor tight(monitor.getCachedMemoryUsage() + 4096,
+                                   nanoflann::MemoryMonitorParams(0, 0));
+    EXPECT_FALSE(tight.checkMemoryLimit());
+    EXPECT_TRUE(tight.checkMemoryLimit(1024 * 1024 * 1024));
+}
+
+// Test that sampled probing performs far fewer probes than per-check probing
+TEST_F(NanoflannMemoryMonitorTest, SampledProbingDuringBuild) {
+    TestDatasetAdaptor dataset(test_points_);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    
+    nanoflann::KDTreeSingleIndexAdaptorParams params;
+    params.leaf_max_size = 1;
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    Tree every_check(3, dataset, params, memory_threshold, nanoflann::MemoryMonitorParams(1, 1));
+    Tree sampled(3, dataset, params, memory_threshold);
+    
+    EXPECT_GT(every_check.getMemoryMonitor().getProbeCount(), 1000);
+    EXPECT_LT(sampled.getMemoryMonitor().getProbeCount() * 10,
+              every_check.getMemoryMonitor().getProbeCount());
+}
+
+// Test that TreeBytes accounting counts exactly what the tree owns
+TEST_F(NanoflannMemoryMonitorTest, TreeBytesAccounting) {
+    TestDatasetAdaptor dataset(test_points_);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    Tree index(3, dataset, memory_threshold, nanoflann::KDTreeSingleIndexAdaptorParams(), monitor_params);
+    
+    const size_t accounted = index.getAccountedBytes();
+    EXPECT_GE(accounted, test_points_.size() * sizeof(uint32_t) + nanoflann::BLOCKSIZE);
+    EXPECT_EQ(index.getCurrentMemoryUsage(), accounted);
+    EXPECT_EQ(index.getMemoryMonitor().getProbeCount(), 0);
+    
+    // Same input gives the same answer, and rebuilding releases the old pool
+    Tree other(3, dataset, memory_threshold, nanoflann::KDTreeSingleIndexAdaptorParams(), monitor_params);
+    EXPECT_EQ(other.getAccountedBytes(), accounted);
+    index.buildIndex();
+    EXPECT_EQ(index.getAccountedBytes(), accounted);
+}
+
+// Test that each tree is held to its own TreeBytes budget
+TEST_F(NanoflannMemoryMonitorTest, TreeBytesLimitExceeded) {
+    TestDatasetAdaptor dataset(test_points_);
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    
+    // Index storage alone does not fit
+    try {
+        Tree index(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(), 1024, monitor_params);
+        FAIL() << "Expected MemoryLimitExceededException";
+    } catch (const nanoflann::MemoryLimitExceededException& e) {
+        EXPECT_NE(std::string(e.what()).find("index storage"), std::string::npos);
+    }
+    
+    // Index storage fits, but the node pool does not
+    EXPECT_THROW(
+        Tree(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(),
+             test_points_.size() * sizeof(uint32_t) + 1024, monitor_params),
+        nanoflann::MemoryLimitExceededException);
+}
+
+// Test that a multi-threaded build is monitored and matches the serial build
+TEST_F(NanoflannMemoryMonitorTest, ConcurrentBuildMatchesSerial) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    nanoflann::KDTreeSingleIndexAdaptorParams params;
+    Tree serial(3, dataset, params, memory_threshold, monitor_params);
+    params.n_thread_build = 4;
+    Tree concurrent(3, dataset, params, memory_threshold, monitor_params);
+    
+    // Worker pools are counted toward the same budget
+    EXPECT_GE(concurrent.getAccountedBytes(), serial.getAccountedBytes());
+    
+    for (int q = 0; q < 50; ++q) {
+        const std::array<float, 3> query = {dis(gen), dis(gen), dis(gen)};
+        std::vector<uint32_t> serial_indices(5), concurrent_indices(5);
+        std::vector<float> serial_dists(5), concurrent_dists(5);
+        serial.knnSearch(query.data(), 5, serial_indices.data(), serial_dists.data());
+        concurrent.knnSearch(query.data(), 5, concurrent_indices.data(), concurrent_dists.data());
+        EXPECT_EQ(serial_indices, concurrent_indices);
+        EXPECT_EQ(serial_dists, concurrent_dists);
+    }
+}
+
+// Test that exceeding the budget in any build task surfaces on the calling thread
+TEST_F(NanoflannMemoryMonitorTest, ConcurrentBuildLimitExceeded) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    
+    nanoflann::KDTreeSingleIndexAdaptorParams params;
+    params.leaf_max_size = 1;
+    params.n_thread_build = 4;
+    
+    try {
+        nanoflann::MemoryMonitoredKDTree<
+            nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+            TestDatasetAdaptor,
+            3,
+            uint32_t> index(3, dataset, params, points.size() * sizeof(uint32_t) + 256 * 1024, monitor_params);
+        FAIL() << "Expected MemoryLimitExceededException";
+    } catch (const nanoflann::MemoryLimitExceededException& e) {
+        std::string message = e.what();
+        EXPECT_NE(message.find("Memory limit exceeded"), std::string::npos);
+        EXPECT_EQ(message.find("cancelled"), std::string::npos);
+    }
+}
+
+// Test the work-stealing pool with nested tasks and exception propagation
+TEST_F(NanoflannMemoryMonitorTest, WorkStealingPool) {
+    nanoflann::WorkStealingPool pool(4);
+    EXPECT_EQ(pool.size(), 4);
+    
+    // Recursive fork/join: sum of [0, 1 << 16)
+    std::function<uint64_t(uint64_t, uint64_t)> sum = [&](uint64_t lo, uint64_t hi) -> uint64_t {
+        if (hi - lo <= 256) {
+            uint64_t total = 0;
+            for (uint64_t i = lo; i < hi; ++i) total += i;
+            return total;
+        }
+        const uint64_t mid = lo + (hi - lo) / 2;
+        uint64_t right = 0;
+        nanoflann::WorkStealingPool::TaskGroup group;
+        pool.submit(group, [&]() { right = sum(mid, hi); });
+        const uint64_t left = sum(lo, mid);
+        pool.wait(group);
+        return left + right;
+    };
+    const uint64_t n = 1 << 16;
+    EXPECT_EQ(sum(0, n), n * (n - 1) / 2);
+    
+    nanoflann::WorkStealingPool::TaskGroup group;
+    pool.submit(group, []() { throw std::runtime_error("task failed"); });
+    EXPECT_THROW(pool.wait(group), std::runtime_error);
+}
+
+// Test the work-stealing build mode and reuse of its pool across builds
+TEST_F(NanoflannMemoryMonitorTest, WorkStealingBuild) {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    nanoflann::KDTreeSingleIndexAdaptorParams params;
+    Tree serial(3, dataset, params, memory_threshold);
+    
+    params.n_thread_build = 4;
+    nanoflann::MemoryMonitoredBuildParams build_params(
+        nanoflann::ConcurrentBuildMode::WorkStealing, 512);
+    build_params.thread_pool = std::make_shared<nanoflann::WorkStealingPool>(3);
+    Tree stealing(3, dataset, params, memory_threshold, nanoflann::MemoryMonitorParams(), build_params);
+    
+    // Rebuilding reuses the same pool
+    stealing.buildIndex();
+    stealing.buildIndex();
+    EXPECT_EQ(stealing.getBuildParams().thread_pool, build_params.thread_pool);
+    
+    for (int q = 0; q < 50; ++q) {
+        const std::array<float, 3> query = {dis(gen), dis(gen), dis(gen)};
+        std::vector<uint32_t> serial_indices(5), stealing_indices(5);
+        std::vector<float> serial_dists(5), stealing_dists(5);
+        serial.knnSearch(query.data(), 5, serial_indices.data(), serial_dists.data());
+        stealing.knnSearch(query.data(), 5, stealing_indices.data(), stealing_dists.data());
+        EXPECT_EQ(serial_indices, stealing_indices);
+        EXPECT_EQ(serial_dists, stealing_dists);
+    }
+    
+    // The budget is still enforced across pool threads
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    params.leaf_max_size = 1;
+    EXPECT_THROW(
+        Tree(3, dataset, params, points.size() * sizeof(uint32_t) + 256 * 1024, monitor_params, build_params),
+        nanoflann::MemoryLimitExceededException);
+}
+
+// Test two trees building at the same time on one shared pool. A caller waiting
+// for its own build runs the other tree's tasks, which must not use that tree's
+// caller arena.
+TEST_F(NanoflannMemoryMonitorTest, WorkStealingSharedPool) {
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    nanoflann::KDTreeSingleIndexAdaptorParams params;
+    const Tree serial(3, dataset, params, memory_threshold);
+
+    params.flags = nanoflann::KDTreeSingleIndexAdaptorFlags::SkipInitialBuildIndex;
+    params.n_thread_build = 4;
+    nanoflann::MemoryMonitoredBuildParams build_params(
+        nanoflann::ConcurrentBuildMode::WorkStealing, 256);
+    build_params.thread_pool = std::make_shared<nanoflann::WorkStealingPool>(2);
+    Tree first(3, dataset, params, memory_threshold, nanoflann::MemoryMonitorParams(), build_params);
+    Tree second(3, dataset, params, memory_threshold, nanoflann::MemoryMonitorParams(), build_params);
+
+    for (int round = 0; round < 5; ++round) {
+        std::thread other([&]() { second.buildIndex(); });
+        first.buildIndex();
+        other.join();
+
+        for (const Tree* tree : {&first, &second}) {
+            for (size_t q = 0; q < 20; ++q) {
+                const std::array<float, 3> query = {dis(gen), dis(gen), dis(gen)};
+                uint32_t expected_index = 0, index = 0;
+                float expected_dist = 0.0f, dist = 0.0f;
+                serial.knnSearch(query.data(), 1, &expected_index, &expected_dist);
+                tree->knnSearch(query.data(), 1, &index, &dist);
+                EXPECT_EQ(index, expected_index);
+                EXPECT_EQ(dist, expected_dist);
+            }
+        }
+    }
+}
+
+// Test batched kNN and radius queries against single queries, with and without a pool
+TEST_F(NanoflannMemoryMonitorTest, BatchSearch) {
+    TestDatasetAdaptor dataset(test_points_);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    Tree tree(3, dataset, memory_threshold);
+    nanoflann::WorkStealingPool pool(3);
+    nanoflann::MonitoredSearchParameters pooled;
+    pooled.thread_pool = &pool;
+    
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    const size_t num_queries = 1000;
+    const size_t k = 5;
+    std::vector<float> queries(num_queries * 3);
+    for (auto& v : queries) v = dis(gen);
+    
+    for (const nanoflann::MonitoredSearchParameters& search_params :
+         {nanoflann::MonitoredSearchParameters(), pooled}) {
+        std::vector<uint32_t> indices(num_queries * k);
+        std::vector<float> dists(num_queries * k);
+        std::vector<size_t> counts(num_queries);
+        tree.knnSearchBatch(queries.data(), num_queries, k, indices.data(), dists.data(),
+                            counts.data(), 64, search_params);
+        for (size_t q = 0; q < num_queries; ++q) {
+            std::vector<uint32_t> expected_indices(k);
+            std::vector<float> expected_dists(k);
+            EXPECT_EQ(counts[q], tree.knnSearch(&queries[q * 3], k,
+                                                expected_indices.data(), expected_dists.data()));
+            EXPECT_TRUE(std::equal(expected_indices.begin(), expected_indices.end(), &indices[q * k]));
+            EXPECT_TRUE(std::equal(expected_dists.begin(), expected_dists.end(), &dists[q * k]));
+        }
+        
+        // Radius batch: the nearest max_results points within the radius, nearest first
+        const float radius = 400.0f; // squared distance
+        const size_t max_results = 3;
+        std::vector<uint32_t> r_indices(num_queries * max_results);
+        std::vector<float> r_dists(num_queries * max_results);
+        tree.radiusSearchBatch(queries.data(), num_queries, radius, max_results,
+                               r_indices.data(), r_dists.data(), counts.data(), 64, search_params);
+        for (size_t q = 0; q < num_queries; ++q) {
+            std::vector<float> inside;
+            for (const auto& p : test_points_) {
+                const float dx = p[0] - queries[q * 3], dy = p[1] - queries[q * 3 + 1],
+                            dz = p[2] - queries[q * 3 + 2];
+                const float d = dx * dx + dy * dy + dz * dz;
+                if (d < radius) inside.push_back(d);
+            }
+            std::sort(inside.begin(), inside.end());
+            ASSERT_EQ(counts[q], std::min(inside.size(), max_results));
+            for (size_t i = 0; i < counts[q]; ++i) {
+                EXPECT_FLOAT_EQ(r_dists[q * max_results + i], inside[i]);
+            }
+        }
+    }
+}
+
+// Dataset that records the threads reading it once recording is on, and the
+// worker index each has in record.pool. Unless told otherwise, the calling
+// thread blocks on its first read until another thread has read, so a batch split across threads cannot
+// finish on the caller alone. The tree keeps a copy of the adaptor, so the
+// record lives outside it.
+struct ThreadRecordingDatasetAdaptor {
+    struct Record {
+        std::atomic<bool> enabled{false};
+        std::thread::id caller;
+        const nanoflann::WorkStealingPool* pool = nullptr;
+        bool wait_for_other = true; // block the caller until another thread reads
+        std::mutex mutex;
+        std::condition_variable other_thread_read;
+        std::vector<std::thread::id> threads;
+        std::vector<int> worker_indices; // of the threads other than the caller
+    };
+    const std::vector<std::array<float, 3>>& points;
+    Record& record;
+    
+    ThreadRecordingDatasetAdaptor(const std::vector<std::array<float, 3>>& pts, Record& r)
+        : points(pts), record(r) {}
+    
+    inline size_t kdtree_get_point_count() const { return points.size(); }
+    inline float kdtree_get_pt(const size_t idx, const size_t dim) const {
+        if (record.enabled.load()) {
+            std::unique_lock<std::mutex> lock(record.mutex);
+            const auto id = std::this_thread::get_id();
+            const bool first_read =
+                std::find(record.threads.begin(), record.threads.end(), id) == record.threads.end();
+            if (first_read) record.threads.push_back(id);
+            if (id != record.caller) {
+                if (first_read) {
+                    record.worker_indices.push_back(record.pool ? record.pool->currentWorkerIndex() : -1);
+                    record.other_thread_read.notify_all();
+                }
+            } else if (record.wait_for_other) {
+                record.other_thread_read.wait_for(lock, std::chrono::seconds(5), [this]() {
+                    return !record.worker_indices.empty();
+                });
+            }
+        }
+        return points[idx][dim];
+    }
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& /*bb*/) const { return false; }
+};
+
+// Test that a batch runs on the pool its search parameters name, else on a
+// tree-owned pool of getQueryThreads() workers, plus the calling thread
+TEST_F(NanoflannMemoryMonitorTest, BatchSearchOwnPool) {
+    ThreadRecordingDatasetAdaptor::Record record;
+    record.caller = std::this_thread::get_id();
+    const ThreadRecordingDatasetAdaptor dataset(test_points_, record);
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, ThreadRecordingDatasetAdaptor, float, uint32_t>,
+        ThreadRecordingDatasetAdaptor,
+        3,
+        uint32_t>;
+    Tree index(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(10), 100 * 1024 * 1024);
+    EXPECT_EQ(index.getQueryThreads(), std::max(std::thread::hardware_concurrency(), 1u));
+    const size_t query_threads = 4;
+    index.setQueryThreads(query_threads);
+    
+    const size_t num_queries = 64;
+    std::vector<float> queries(num_queries * 3);
+    for (size_t q = 0; q < num_queries; ++q) {
+        for (size_t d = 0; d < 3; ++d) queries[q * 3 + d] = test_points_[q][d];
+    }
+    std::vector<uint32_t> indices(num_queries);
+    std::vector<float> dists(num_queries);
+    auto run_batch = [&](const nanoflann::MonitoredSearchParameters& search_params) {
+        record.threads.clear();
+        record.worker_indices.clear();
+        std::fill(dists.begin(), dists.end(), -1.0f);
+        record.enabled = true;
+        index.knnSearchBatch(queries.data(), num_queries, 1, indices.data(), dists.data(),
+                             nullptr, 8, search_params);
+        record.enabled = false;
+        for (size_t q = 0; q < num_queries; ++q) {
+            EXPECT_FLOAT_EQ(dists[q], 0.0f);
+        }
+    };
+    
+    // The tree's own pool, sized apart from n_thread_build: its workers and the caller at most
+    run_batch({});
+    EXPECT_FALSE(record.worker_indices.empty());
+    EXPECT_LE(record.threads.size(), query_threads + 1);
+    
+    // One query thread keeps the batch on the caller
+    index.setQueryThreads(1);
+    record.wait_for_other = false;
+    run_batch({});
+    EXPECT_TRUE(record.worker_indices.empty());
+    EXPECT_EQ(record.threads.size(), 1u);
+    record.wait_for_other = true;
+    index.setQueryThreads(query_threads);
+    
+    // A given pool: every other thread is one of its workers
+    nanoflann::WorkStealingPool pool(2);
+    record.pool = &pool;
+    nanoflann::MonitoredSearchParameters pooled;
+    pooled.thread_pool = &pool;
+    run_batch(pooled);
+    ASSERT_FALSE(record.worker_indices.empty());
+    EXPECT_LE(record.threads.size(), pool.size() + 1);
+    for (const int worker : record.worker_indices) {
+        EXPECT_GE(worker, 0);
+        EXPECT_LT(worker, static_cast<int>(pool.size()));
+    }
+}
+
+// Test the SIMD leaf kernel against the scalar leaf scan
+TEST_F(NanoflannMemoryMonitorTest, SimdLeafKernel) {
+    // Kernel on its own, with a tail that does not fill a vector register
+    std::vector<float> coords(3 * 21);
+    for (size_t i = 0; i < coords.size(); ++i) coords[i] = static_cast<float>(i % 7) - 2.5f;
+    const float query[3] = {0.5f, -1.0f, 2.0f};
+    float out[19];
+    nanoflann::leafL2Distances<3>(coords.data(), 21, 2, 19, query, out);
+    for (size_t j = 0; j < 19; ++j) {
+        float expected = 0.0f;
+        for (size_t d = 0; d < 3; ++d) {
+            const float diff = coords[d * 21 + 2 + j] - query[d];
+            expected += diff * diff;
+        }
+        EXPECT_FLOAT_EQ(out[j], expected);
+    }
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    // Default builds pick AVX2 at run time
+    EXPECT_EQ(nanoflann::detail::leafKernelUsesAvx2(), __builtin_cpu_supports("avx2") != 0);
+#endif
+    
+    TestDatasetAdaptor dataset(test_points_);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    nanoflann::KDTreeSingleIndexAdaptorParams params;
+    params.leaf_max_size = 20;
+    Tree scalar(3, dataset, params, memory_threshold);
+    nanoflann::MemoryMonitoredBuildParams build_params;
+    build_params.simd_leaves = true;
+    Tree simd(3, dataset, params, memory_threshold, nanoflann::MemoryMonitorParams(), build_params);
+    EXPECT_FALSE(scalar.usesLeafKernel());
+    EXPECT_TRUE(simd.usesLeafKernel());
+    
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    for (int q = 0; q < 100; ++q) {
+        const std::array<float, 3> point = {dis(gen), dis(gen), dis(gen)};
+        std::vector<uint32_t> scalar_indices(8), simd_indices(8);
+        std::vector<float> scalar_dists(8), simd_dists(8);
+        scalar.knnSearch(point.data(), 8, scalar_indices.data(), scalar_dists.data());
+        simd.knnSearch(point.data(), 8, simd_indices.data(), simd_dists.data());
+        EXPECT_EQ(scalar_indices, simd_indices);
+        for (size_t i = 0; i < 8; ++i) EXPECT_FLOAT_EQ(scalar_dists[i], simd_dists[i]);
+    }
+}
+
+// Test searches on the reordered point copy, for both layouts
+TEST_F(NanoflannMemoryMonitorTest, ReorderedPointStorage) {
+    TestDatasetAdaptor dataset(test_points_);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    nanoflann::MemoryMonitoredBuildParams build_params;
+    build_params.reorder_points = true;
+    
+    using Metric = nanoflann::L1_Adaptor<float, TestDatasetAdaptor, float, uint32_t>;
+    using Tree = nanoflann::MemoryMonitoredKDTree<Metric, TestDatasetAdaptor, 3, uint32_t>;
+    using SoATree = nanoflann::MemoryMonitoredKDTree<
+        Metric, TestDatasetAdaptor, 3, uint32_t, nanoflann::PointStorageLayout::SoA>;
+    using AoSTree = nanoflann::MemoryMonitoredKDTree<
+        Metric, TestDatasetAdaptor, 3, uint32_t, nanoflann::PointStorageLayout::AoS>;
+    const nanoflann::KDTreeSingleIndexAdaptorParams params;
+    Tree plain(3, dataset, params, memory_threshold, monitor_params);
+    SoATree soa(3, dataset, params, memory_threshold, monitor_params, build_params);
+    AoSTree aos(3, dataset, params, memory_threshold, monitor_params, build_params);
+    EXPECT_FALSE(plain.usesPointStorage());
+    EXPECT_TRUE(soa.usesPointStorage());
+    EXPECT_TRUE(aos.usesPointStorage());
+    EXPECT_FALSE(soa.usesLeafKernel());
+    
+    // The copy is charged to the budget
+    EXPECT_EQ(soa.getAccountedBytes(), plain.getAccountedBytes() + test_points_.size() * 3 * sizeof(float));
+    EXPECT_EQ(aos.getAccountedBytes(), soa.getAccountedBytes());
+    
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    for (int q = 0; q < 100; ++q) {
+        const std::array<float, 3> point = {dis(gen), dis(gen), dis(gen)};
+        std::vector<uint32_t> plain_indices(6), soa_indices(6), aos_indices(6);
+        std::vector<float> plain_dists(6), soa_dists(6), aos_dists(6);
+        plain.knnSearch(point.data(), 6, plain_indices.data(), plain_dists.data());
+        soa.knnSearch(point.data(), 6, soa_indices.data(), soa_dists.data());
+        aos.knnSearch(point.data(), 6, aos_indices.data(), aos_dists.data());
+        EXPECT_EQ(plain_indices, soa_indices);
+        EXPECT_EQ(plain_indices, aos_indices);
+        EXPECT_EQ(soa_dists, aos_dists);
+        for (size_t i = 0; i < 6; ++i) EXPECT_FLOAT_EQ(plain_dists[i], soa_dists[i]);
+    }
+    
+    // Without room for the copy the build fails
+    EXPECT_THROW(
+        SoATree(3, dataset, params, soa.getAccountedBytes() - 1024, monitor_params, build_params),
+        nanoflann::MemoryLimitExceededException);
+}
+
+// Test the compact node layout against linked nodes, for serial and concurrent builds
+TEST_F(NanoflannMemoryMonitorTest, CompactNodes) {
+    std::mt19937 gen(9);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    static_assert(sizeof(Tree::CompactNode) == 16, "compact nodes are 16 bytes for float");
+    nanoflann::KDTreeSingleIndexAdaptorParams params;
+    params.leaf_max_size = 4;
+    Tree linked(3, dataset, params, memory_threshold, monitor_params);
+    EXPECT_FALSE(linked.usesCompactNodes());
+    
+    nanoflann::MemoryMonitoredBuildParams build_params;
+    build_params.compact_nodes = true;
+    Tree compact(3, dataset, params, memory_threshold, monitor_params, build_params);
+    EXPECT_TRUE(compact.usesCompactNodes());
+    EXPECT_LT(compact.getAccountedBytes(), linked.getAccountedBytes());
+    EXPECT_LT(compact.usedMemory(compact), linked.usedMemory(linked));
+    
+    params.n_thread_build = 4;
+    Tree spawned(3, dataset, params, memory_threshold, monitor_params, build_params);
+    build_params.concurrent_mode = nanoflann::ConcurrentBuildMode::WorkStealing;
+    build_params.task_cutoff = 512;
+    Tree stolen(3, dataset, params, memory_threshold, monitor_params, build_params);
+    EXPECT_TRUE(spawned.usesCompactNodes());
+    EXPECT_TRUE(stolen.usesCompactNodes());
+    // The linked nodes are released after flattening
+    EXPECT_LT(stolen.getAccountedBytes(), linked.getAccountedBytes());
+    
+    for (int q = 0; q < 100; ++q) {
+        const std::array<float, 3> query = {dis(gen), dis(gen), dis(gen)};
+        std::vector<uint32_t> expected_indices(5);
+        std::vector<float> expected_dists(5);
+        linked.knnSearch(query.data(), 5, expected_indices.data(), expected_dists.data());
+        for (const Tree* tree : {&compact, &spawned, &stolen}) {
+            std::vector<uint32_t> indices(5);
+            std::vector<float> dists(5);
+            tree->knnSearch(query.data(), 5, indices.data(), dists.data());
+            EXPECT_EQ(expected_indices, indices);
+            EXPECT_EQ(expected_dists, dists);
+        }
+    }
+}
+
+// Test that the iterative search returns exactly what the recursive one does
+TEST_F(NanoflannMemoryMonitorTest, IterativeSearch) {
+    TestDatasetAdaptor dataset(test_points_);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    nanoflann::KDTreeSingleIndexAdaptorParams params;
+    params.leaf_max_size = 1;
+    nanoflann::MemoryMonitoredBuildParams build_params;
+    Tree linked(3, dataset, params, memory_threshold, nanoflann::MemoryMonitorParams(), build_params);
+    build_params.compact_nodes = true;
+    Tree compact(3, dataset, params, memory_threshold, nanoflann::MemoryMonitorParams(), build_params);
+    EXPECT_GT(linked.getTreeDepth(), 10u);
+    EXPECT_LE(linked.getTreeDepth(), Tree::SEARCH_STACK_SIZE);
+    EXPECT_EQ(linked.getTreeDepth(), compact.getTreeDepth());
+    
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    for (Tree* tree : {&linked, &compact}) {
+        for (float eps : {0.0f, 0.5f}) {
+            const nanoflann::MonitoredSearchParameters iterative_params(eps, true, true);
+            const nanoflann::MonitoredSearchParameters recursive_params(eps, true, false);
+            for (int q = 0; q < 100; ++q) {
+                const std::array<float, 3> query = {dis(gen), dis(gen), dis(gen)};
+                std::vector<uint32_t> iterative_indices(7), recursive_indices(7);
+                std::vector<float> iterative_dists(7), recursive_dists(7);
+                
+                nanoflann::KNNResultSet<float, uint32_t> iterative(7);
+                iterative.init(iterative_indices.data(), iterative_dists.data());
+                tree->findNeighbors(iterative, query.data(), iterative_params);
+                
+                nanoflann::KNNResultSet<float, uint32_t> recursive(7);
+                recursive.init(recursive_indices.data(), recursive_dists.data());
+                tree->findNeighbors(recursive, query.data(), recursive_params);
+                
+                EXPECT_EQ(iterative_indices, recursive_indices);
+                EXPECT_EQ(iterative_dists, recursive_dists);
+            }
+        }
+    }
+}
+
+// Test that a build out of budget degrades into a smaller tree instead of throwing
+TEST_F(NanoflannMemoryMonitorTest, DegradedBuild) {
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    const nanoflann::KDTreeSingleIndexAdaptorParams params(4);
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    
+    // Index storage and about a third of the nodes of the full tree
+    const Tree full(3, dataset, params, 100 * 1024 * 1024, monitor_params);
+    const size_t storage = points.size() * sizeof(uint32_t);
+    const size_t budget = storage + (full.getAccountedBytes() - storage) / 3;
+    EXPECT_FALSE(full.getBuildDegradation().degraded());
+    EXPECT_LE(full.getBuildDegradation().max_leaf_size, 4u);
+    
+    // Throw releases the partial tree
+    {
+        const nanoflann::KDTreeSingleIndexAdaptorParams deferred(
+            4, nanoflann::KDTreeSingleIndexAdaptorFlags::SkipInitialBuildIndex);
+        Tree index(3, dataset, deferred, budget, monitor_params);
+        EXPECT_EQ(index.getAccountedBytes(), 0u);
+        EXPECT_THROW(index.buildIndex(), nanoflann::MemoryLimitExceededException);
+        // Only the index storage and the root box are kept, also after another failure
+        EXPECT_EQ(index.getAccountedBytes(), storage + 3 * 2 * sizeof(float));
+        EXPECT_THROW(index.buildIndex(), nanoflann::MemoryLimitExceededException);
+        EXPECT_EQ(index.getAccountedBytes(), storage + 3 * 2 * sizeof(float));
+    }
+    
+    std::vector<std::array<float, 3>> queries(100);
+    for (auto& q : queries) q = {dis(gen), dis(gen), dis(gen)};
+    auto nearest = [&](const std::array<float, 3>& query) {
+        float best = std::numeric_limits<float>::max();
+        for (const auto& p : points) {
+            float dist = 0.0f;
+            for (int d = 0; d < 3; ++d) dist += (p[d] - query[d]) * (p[d] - query[d]);
+            best = std::min(best, dist);
+        }
+        return best;
+    };
+    
+    // LargerLeaves keeps searches exact, in both layouts and in concurrent builds
+    // (spawned tasks and work stealing), which degrade in place
+    for (int variant = 0; variant < 4; ++variant) {
+        nanoflann::MemoryMonitoredBuildParams build_params;
+        build_params.limit_policy = nanoflann::MemoryLimitPolicy::LargerLeaves;
+        build_params.compact_nodes = variant == 1;
+        if (variant == 3) {
+            build_params.concurrent_mode = nanoflann::ConcurrentBuildMode::WorkStealing;
+            build_params.task_cutoff = 512;
+        }
+        const nanoflann::KDTreeSingleIndexAdaptorParams variant_params(
+            4, nanoflann::KDTreeSingleIndexAdaptorFlags::None, variant >= 2 ? 4 : 1);
+        const Tree index(3, dataset, variant_params, budget, monitor_params, build_params);
+        const nanoflann::BuildDegradation& degradation = index.getBuildDegradation();
+        EXPECT_TRUE(degradation.degraded());
+        EXPECT_GT(degradation.degraded_leaves, 0u);
+        EXPECT_GT(degradation.skipped_nodes, 0u);
+        EXPECT_GT(degradation.max_leaf_size, 4u);
+        EXPECT_EQ(degradation.dropped_points, 0u);
+        EXPECT_LE(index.getAccountedBytes(), budget);
+        for (const auto& query : queries) {
+            uint32_t found;
+            float dist;
+            ASSERT_EQ(index.knnSearch(query.data(), 1, &found, &dist), 1u);
+            EXPECT_FLOAT_EQ(dist, nearest(query));
+        }
+    }
+    
+    // Subsample keeps the leaves small and leaves points out, also when built concurrently
+    for (const unsigned int threads : {1u, 4u}) {
+        nanoflann::MemoryMonitoredBuildParams build_params;
+        build_params.limit_policy = nanoflann::MemoryLimitPolicy::Subsample;
+        const nanoflann::KDTreeSingleIndexAdaptorParams thread_params(
+            4, nanoflann::KDTreeSingleIndexAdaptorFlags::None, threads);
+        const Tree index(3, dataset, thread_params, budget, monitor_params, build_params);
+        const nanoflann::BuildDegradation& degradation = index.getBuildDegradation();
+        EXPECT_GT(degradation.degraded_leaves, 0u);
+        EXPECT_GT(degradation.dropped_points, 0u);
+        EXPECT_LT(degradation.dropped_points, points.size());
+        EXPECT_LE(degradation.max_leaf_size, 4u);
+        EXPECT_LE(index.getAccountedBytes(), budget);
+        for (const auto& query : queries) {
+            uint32_t found;
+            float dist;
+            ASSERT_EQ(index.knnSearch(query.data(), 1, &found, &dist), 1u);
+            EXPECT_GE(dist, nearest(query));
+        }
+    }
+}
+
+// Dataset that touches 64 MB while the root range is split, standing in for
+// another part of the process growing its RSS during a build. The tree keeps a
+// copy of the adaptor, so the balloon lives outside it.
+struct BalloonDatasetAdaptor {
+    struct Balloon {
+        size_t reads = 0;
+        std::vector<char> bytes;
+    };
+    const std::vector<std::array<float, 3>>& points;
+    Balloon& balloon;
+    
+    BalloonDatasetAdaptor(const std::vector<std::array<float, 3>>& pts, Balloon& b)
+        : points(pts), balloon(b) {}
+    
+    inline size_t kdtree_get_point_count() const { return points.size(); }
+    inline float kdtree_get_pt(const size_t idx, const size_t dim) const {
+        if (++balloon.reads == 4 * points.size()) balloon.bytes.assign(64 * 1024 * 1024, 1);
+        return points[idx][dim];
+    }
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& /*bb*/) const { return false; }
+};
+
+// Test that a degrading build also degrades when the process RSS jumps past the
+// limit between two checks, instead of throwing at the next division
+TEST_F(NanoflannMemoryMonitorTest, DegradedBuildAfterUsageJump) {
+    std::mt19937 gen(6);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, BalloonDatasetAdaptor, float, uint32_t>,
+        BalloonDatasetAdaptor,
+        3,
+        uint32_t>;
+    const nanoflann::MemoryMonitorParams monitor_params(1, 0, nanoflann::MemoryAccountingMode::ProcessRSS);
+    
+    std::vector<std::array<float, 3>> queries(50);
+    for (auto& q : queries) q = {dis(gen), dis(gen), dis(gen)};
+    for (int variant = 0; variant < 3; ++variant) {
+        BalloonDatasetAdaptor::Balloon balloon;
+        const BalloonDatasetAdaptor dataset(points, balloon);
+        nanoflann::MemoryMonitoredBuildParams build_params;
+        build_params.limit_policy = variant == 0
+            ? nanoflann::MemoryLimitPolicy::Throw : nanoflann::MemoryLimitPolicy::LargerLeaves;
+        build_params.compact_nodes = variant == 2;
+        const nanoflann::MemoryMonitor probe(SIZE_MAX / 2, monitor_params);
+        const size_t threshold = probe.getCurrentMemoryUsage() + 16 * 1024 * 1024;
+        const nanoflann::KDTreeSingleIndexAdaptorParams params(4);
+        
+        if (variant == 0) {
+            EXPECT_THROW(Tree(3, dataset, params, threshold, monitor_params, build_params),
+                         nanoflann::MemoryLimitExceededException);
+            continue;
+        }
+        const Tree index(3, dataset, params, threshold, monitor_params, build_params);
+        ASSERT_FALSE(balloon.bytes.empty());
+        balloon.bytes = std::vector<char>();
+        const nanoflann::BuildDegradation& degradation = index.getBuildDegradation();
+        EXPECT_TRUE(degradation.degraded());
+        EXPECT_GT(degradation.skipped_nodes, 0u);
+        EXPECT_GT(degradation.max_leaf_size, 4u);
+        EXPECT_EQ(degradation.dropped_points, 0u);
+        for (const auto& query : queries) {
+            float best = std::numeric_limits<float>::max();
+            for (const auto& p : points) {
+                float dist = 0.0f;
+                for (int d = 0; d < 3; ++d) dist += (p[d] - query[d]) * (p[d] - query[d]);
+                best = std::min(best, dist);
+            }
+            uint32_t found;
+            float dist;
+            ASSERT_EQ(index.knnSearch(query.data(), 1, &found, &dist), 1u);
+            EXPECT_FLOAT_EQ(dist, best);
+        }
+    }
+}
+
+#ifdef NANOFLANN_MAPPED_INDEX
+// Test that a saved index maps back read-only and answers like the tree it was saved from
+TEST_F(NanoflannMemoryMonitorTest, SaveLoadIndex) {
+    std::mt19937 gen(9);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    std::vector<std::array<float, 3>> queries(200);
+    for (auto& q : queries) q = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    const nanoflann::KDTreeSingleIndexAdaptorParams params(8);
+    const nanoflann::KDTreeSingleIndexAdaptorParams deferred(
+        8, nanoflann::KDTreeSingleIndexAdaptorFlags::SkipInitialBuildIndex);
+    const std::string path = ::testing::TempDir() + "nanoflann_monitor_index.bin";
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    
+    // Linked tree without points, compact tree with SIMD leaves
+    for (bool compact : {false, true}) {
+        nanoflann::MemoryMonitoredBuildParams build_params;
+        build_params.compact_nodes = compact;
+        build_params.simd_leaves = compact;
+        const Tree built(3, dataset, params, memory_threshold, monitor_params, build_params);
+        built.saveIndex(path);
+        
+        Tree loaded(3, dataset, deferred, memory_threshold, monitor_params, build_params);
+        loaded.loadIndex(path);
+        EXPECT_TRUE(loaded.usesMappedIndex());
+        EXPECT_TRUE(loaded.usesCompactNodes());
+        EXPECT_EQ(loaded.usesPointStorage(), compact);
+        EXPECT_EQ(loaded.usesLeafKernel(), built.usesLeafKernel());
+        EXPECT_EQ(loaded.getTreeDepth(), built.getTreeDepth());
+        // Only the resident part of the file is accounted
+        EXPECT_LE(loaded.getAccountedBytes(), loaded.refreshMappedAccounting() + 3 * 2 * sizeof(float));
+        
+        uint32_t built_indices[5], loaded_indices[5];
+        float built_dists[5], loaded_dists[5];
+        for (const auto& query : queries) {
+            ASSERT_EQ(built.knnSearch(query.data(), 5, built_indices, built_dists), 5u);
+            ASSERT_EQ(loaded.knnSearch(query.data(), 5, loaded_indices, loaded_dists), 5u);
+            for (int j = 0; j < 5; ++j) {
+                EXPECT_EQ(loaded_indices[j], built_indices[j]);
+                EXPECT_FLOAT_EQ(loaded_dists[j], built_dists[j]);
+            }
+        }
+        
+        // A mapped index saves back to the same file contents
+        const std::string copy = path + ".copy";
+        loaded.saveIndex(copy);
+        std::ifstream a(path, std::ios::binary), b(copy, std::ios::binary);
+        const std::string original((std::istreambuf_iterator<char>(a)), std::istreambuf_iterator<char>());
+        const std::string resaved((std::istreambuf_iterator<char>(b)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(original, resaved);
+        std::remove(copy.c_str());
+        
+        // Rebuilding drops the mapping
+        loaded.buildIndex();
+        EXPECT_FALSE(loaded.usesMappedIndex());
+        EXPECT_EQ(loaded.getAccountedBytes(), built.getAccountedBytes());
+    }
+    
+    // Files that do not match the tree are rejected
+    std::vector<std::array<float, 3>> fewer(points.begin(), points.begin() + 100);
+    TestDatasetAdaptor other_dataset(fewer);
+    Tree mismatched(3, other_dataset, deferred, memory_threshold, monitor_params);
+    EXPECT_THROW(mismatched.loadIndex(path), std::runtime_error);
+    EXPECT_FALSE(mismatched.usesMappedIndex());
+    {
+        std::ofstream corrupt(path, std::ios::binary | std::ios::in | std::ios::out);
+        corrupt.write("XXXX", 4);
+    }
+    Tree corrupted(3, dataset, deferred, memory_threshold, monitor_params);
+    EXPECT_THROW(corrupted.loadIndex(path), std::runtime_error);
+    EXPECT_THROW(corrupted.loadIndex(path + ".missing"), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+// Test that saving never disturbs a mapped file, and that inconsistent headers are rejected
+TEST_F(NanoflannMemoryMonitorTest, SaveLoadIndexSafety) {
+    using Header = nanoflann::detail::MappedIndexHeader;
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    TestDatasetAdaptor dataset(test_points_);
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    const nanoflann::KDTreeSingleIndexAdaptorParams deferred(
+        10, nanoflann::KDTreeSingleIndexAdaptorFlags::SkipInitialBuildIndex);
+    const std::string path = ::testing::TempDir() + "nanoflann_monitor_safety.bin";
+    
+    const Tree built(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(10), memory_threshold);
+    built.saveIndex(path);
+    Tree loaded(3, dataset, deferred, memory_threshold);
+    loaded.loadIndex(path);
+    
+    // A save that cannot get its blocks throws instead of faulting in the mapping
+    {
+        struct rlimit limit;
+        ASSERT_EQ(::getrlimit(RLIMIT_FSIZE, &limit), 0);
+        struct rlimit small = limit;
+        small.rlim_cur = 4096;
+        const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+        ASSERT_EQ(::setrlimit(RLIMIT_FSIZE, &small), 0);
+        EXPECT_THROW(built.saveIndex(path), std::runtime_error);
+        ::setrlimit(RLIMIT_FSIZE, &limit);
+        std::signal(SIGXFSZ, handler);
+        EXPECT_FALSE(std::ifstream(path + ".tmp").good());
+        uint32_t index = 0;
+        float dist = 0.0f;
+        ASSERT_EQ(loaded.knnSearch(test_points_[0].data(), 1, &index, &dist), 1u);
+        EXPECT_FLOAT_EQ(dist, 0.0f);
+    }
+    
+    // Saving again replaces the file by rename; the old mapping stays readable
+    built.saveIndex(path);
+    EXPECT_FALSE(std::ifstream(path + ".tmp").good());
+    uint32_t built_indices[5], loaded_indices[5];
+    float built_dists[5], loaded_dists[5];
+    for (size_t q = 0; q < 50; ++q) {
+        ASSERT_EQ(built.knnSearch(test_points_[q].data(), 5, built_indices, built_dists), 5u);
+        ASSERT_EQ(loaded.knnSearch(test_points_[q].data(), 5, loaded_indices, loaded_dists), 5u);
+        EXPECT_EQ(loaded_indices[0], built_indices[0]);
+    }
+    
+    std::string file;
+    {
+        std::ifstream in(path, std::ios::binary);
+        file.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+    ASSERT_GE(file.size(), sizeof(Header));
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(Header));
+    EXPECT_EQ(header.checksum, header.computeChecksum());
+    auto load_bytes = [&](const std::string& bytes, bool verify) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size());
+        Tree tree(3, dataset, deferred, memory_threshold);
+        try {
+            tree.loadIndex(path, verify);
+        } catch (const std::runtime_error& e) {
+            EXPECT_FALSE(tree.usesMappedIndex());
+            return std::string(e.what());
+        }
+        return std::string();
+    };
+    auto load_with = [&](const Header& changed) {
+        std::string bytes = file;
+        std::memcpy(&bytes[0], &changed, sizeof(Header));
+        return load_bytes(bytes, true);
+    };
+    
+    // A changed field without a matching checksum
+    Header changed = header;
+    changed.node_count += 1;
+    EXPECT_NE(load_with(changed).find("corrupted header"), std::string::npos);
+    
+    // Consistent checksums over sections that overlap or leave the file
+    changed = header;
+    changed.vacc_offset = changed.nodes_offset;
+    changed.checksum = changed.computeChecksum();
+    EXPECT_NE(load_with(changed).find("sections out of bounds"), std::string::npos);
+    changed = header;
+    changed.node_count = header.vacc_offset - header.nodes_offset + 1;
+    changed.checksum = changed.computeChecksum();
+    EXPECT_NE(load_with(changed).find("sections out of bounds"), std::string::npos);
+    changed = header;
+    changed.points_offset = header.file_bytes + Header::ALIGNMENT;
+    changed.checksum = changed.computeChecksum();
+    EXPECT_NE(load_with(changed).find("sections out of bounds"), std::string::npos);
+    changed = header;
+    changed.bbox_offset = 0;
+    changed.checksum = changed.computeChecksum();
+    EXPECT_NE(load_with(changed).find("sections out of bounds"), std::string::npos);
+    
+    // Node payloads the checksum does not cover
+    using Node = Tree::CompactNode;
+    auto load_with_node = [&](size_t index, const Node& node, bool verify) {
+        std::string bytes = file;
+        std::memcpy(&bytes[header.nodes_offset + index * sizeof(Node)], &node, sizeof(Node));
+        return load_bytes(bytes, verify);
+    };
+    Node root;
+    std::memcpy(&root, &file[header.nodes_offset], sizeof(Node));
+    ASSERT_EQ(root.first & Tree::COMPACT_LEAF_FLAG, 0u);
+    Node bad = root;
+    bad.second = static_cast<uint32_t>(header.node_count); // second child past the end
+    EXPECT_NE(load_with_node(0, bad, true).find("invalid nodes"), std::string::npos);
+    bad = root;
+    bad.second = 0; // cycle back to the root
+    EXPECT_NE(load_with_node(0, bad, true).find("invalid nodes"), std::string::npos);
+    bad = root;
+    bad.first = 3; // split dimension
+    EXPECT_NE(load_with_node(0, bad, true).find("invalid nodes"), std::string::npos);
+    Node leaf;
+    size_t leaf_index = 0;
+    do {
+        std::memcpy(&leaf, &file[header.nodes_offset + ++leaf_index * sizeof(Node)], sizeof(Node));
+    } while (!(leaf.first & Tree::COMPACT_LEAF_FLAG));
+    bad = leaf;
+    bad.second = static_cast<uint32_t>(header.size + 1); // leaf range past vAcc_
+    EXPECT_NE(load_with_node(leaf_index, bad, true).find("invalid nodes"), std::string::npos);
+    // Trusted files skip the walk
+    EXPECT_EQ(load_with_node(leaf_index, bad, false), "");
+    {
+        std::string bytes = file;
+        const uint32_t out_of_range = static_cast<uint32_t>(header.size);
+        std::memcpy(&bytes[header.vacc_offset], &out_of_range, sizeof(uint32_t));
+        EXPECT_NE(load_bytes(bytes, true).find("invalid nodes"), std::string::npos);
+    }
+    changed = header;
+    changed.tree_depth = Tree::SEARCH_STACK_SIZE + 1;
+    changed.checksum = changed.computeChecksum();
+    EXPECT_NE(load_with(changed).find("invalid nodes"), std::string::npos);
+    
+    // The unchanged header still loads
+    EXPECT_EQ(load_with(header), "");
+    std::remove(path.c_str());
+}
+#endif
+
+// Dataset that counts coordinate reads and can report its bounding box
+struct CountingDatasetAdaptor {
+    const std::vector<std::array<float, 3>>& points;
+    std::atomic<size_t>& reads;
+    bool provide_bbox;
+    
+    inline size_t kdtree_get_point_count() const { return points.size(); }
+    inline float kdtree_get_pt(const size_t idx, const size_t dim) const {
+        reads.fetch_add(1, std::memory_order_relaxed);
+        return points[idx][dim];
+    }
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& bb) const {
+        if (!provide_bbox) return false;
+        for (size_t d = 0; d < 3; ++d) {
+            bb[d].low = bb[d].high = points[0][d];
+            for (const auto& p : points) {
+                bb[d].low = std::min(bb[d].low, p[d]);
+                bb[d].high = std::max(bb[d].high, p[d]);
+            }
+        }
+        return true;
+    }
+};
+
+// Test that a build scans the dataset once for vAcc_ and the root box, or not at all
+TEST_F(NanoflannMemoryMonitorTest, InitialScan) {
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(100000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    const size_t memory_threshold = 100 * 1024 * 1024; // 100 MB
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, CountingDatasetAdaptor, float, uint32_t>,
+        CountingDatasetAdaptor,
+        3,
+        uint32_t>;
+    
+    // A box from the adaptor saves exactly the one scan the build would make
+    std::atomic<size_t> scanned{0}, provided{0};
+    const CountingDatasetAdaptor scanning_dataset{points, scanned, false};
+    const CountingDatasetAdaptor boxed_dataset{points, provided, true};
+    const Tree scanning(3, scanning_dataset, nanoflann::KDTreeSingleIndexAdaptorParams(), memory_threshold);
+    const Tree boxed(3, boxed_dataset, nanoflann::KDTreeSingleIndexAdaptorParams(), memory_threshold);
+    EXPECT_EQ(scanned.load() - provided.load(), points.size() * 3);
+
+    // A deferred tree reads nothing until buildIndex(), which reads as much as an immediate build
+    std::atomic<size_t> deferred_reads{0};
+    const CountingDatasetAdaptor deferred_dataset{points, deferred_reads, false};
+    Tree deferred(3, deferred_dataset,
+                  nanoflann::KDTreeSingleIndexAdaptorParams(
+                      10, nanoflann::KDTreeSingleIndexAdaptorFlags::SkipInitialBuildIndex),
+                  memory_threshold);
+    EXPECT_EQ(deferred_reads.load(), 0u);
+    deferred.buildIndex();
+    EXPECT_EQ(deferred_reads.load(), scanned.load());
+
+    // The split scan of a multi-threaded build finds the same tree
+    std::atomic<size_t> threaded_reads{0};
+    const CountingDatasetAdaptor threaded_dataset{points, threaded_reads, false};
+    const Tree threaded(3, threaded_dataset,
+                        nanoflann::KDTreeSingleIndexAdaptorParams(
+                            10, nanoflann::KDTreeSingleIndexAdaptorFlags::None, 4),
+                        memory_threshold);
+    std::vector<std::array<float, 3>> queries(100);
+    for (auto& q : queries) q = {dis(gen), dis(gen), dis(gen)};
+    uint32_t expected[3], found[3], boxed_found[3];
+    float expected_dists[3], dists[3], boxed_dists[3];
+    for (const auto& query : queries) {
+        ASSERT_EQ(scanning.knnSearch(query.data(), 3, expected, expected_dists), 3u);
+        ASSERT_EQ(threaded.knnSearch(query.data(), 3, found, dists), 3u);
+        ASSERT_EQ(boxed.knnSearch(query.data(), 3, boxed_found, boxed_dists), 3u);
+        for (int j = 0; j < 3; ++j) {
+            EXPECT_EQ(found[j], expected[j]);
+            EXPECT_EQ(boxed_found[j], expected[j]);
+        }
+    }
+    
+    // nanoflann's init_vind() and computeBoundingBox() remain: one pass, same box
+    Tree::BoundingBox expected_box, box;
+    boxed_dataset.kdtree_get_bbox(expected_box);
+    deferred_reads = 0;
+    deferred.init_vind();
+    EXPECT_EQ(deferred_reads.load(), 0u);
+    deferred.computeBoundingBox(box);
+    EXPECT_EQ(deferred_reads.load(), points.size() * 3);
+    for (size_t d = 0; d < 3; ++d) {
+        EXPECT_EQ(box[d].low, expected_box[d].low);
+        EXPECT_EQ(box[d].high, expected_box[d].high);
+    }
+}
+
+// Test a tree whose dimensionality is only known at run time (DIM = -1)
+TEST_F(NanoflannMemoryMonitorTest, DynamicDimensionality) {
+    TestDatasetAdaptor dataset(test_points_);
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        -1,
+        uint32_t>;
+    const Tree index(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(), 100 * 1024 * 1024);
+    
+    const std::array<float, 3> query = test_points_[42];
+    uint32_t found;
+    float dist;
+    ASSERT_EQ(index.knnSearch(query.data(), 1, &found, &dist), 1u);
+    EXPECT_EQ(found, 42u);
+    EXPECT_FLOAT_EQ(dist, 0.0f);
+}
+
+// Dataset that reports a huge point count and never stores a point
+struct HugeDatasetAdaptor {
+    inline size_t kdtree_get_point_count() const { return size_t(1) << 30; }
+    inline float kdtree_get_pt(const size_t /*idx*/, const size_t /*dim*/) const { return 0.0f; }
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX& /*bb*/) const { return false; }
+};
+
+// Test the footprint estimate against the bytes builds account, and the up-front check
+TEST_F(NanoflannMemoryMonitorTest, FootprintEstimate) {
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(50000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    
+    for (size_t leaf_size : {1, 10, 32}) {
+        const nanoflann::KDTreeSingleIndexAdaptorParams params(leaf_size);
+        for (bool compact : {false, true}) {
+            nanoflann::MemoryMonitoredBuildParams build_params;
+            build_params.compact_nodes = compact;
+            build_params.reorder_points = leaf_size == 32;
+            const nanoflann::MemoryFootprint footprint =
+                Tree::estimateMemoryFootprint(points.size(), 3, params, build_params);
+            const Tree index(3, dataset, params, 1024 * 1024 * 1024, monitor_params, build_params);
+            EXPECT_EQ(footprint.index_storage, points.size() * sizeof(uint32_t) + 3 * 2 * sizeof(float));
+            EXPECT_EQ(footprint.point_storage, leaf_size == 32 ? points.size() * 3 * sizeof(float) : 0u);
+            EXPECT_GE(footprint.total(), index.getAccountedBytes()) << leaf_size << " " << compact;
+            // The linked layout has no growth transient to cover
+            if (!compact) {
+                EXPECT_LE(footprint.total(), index.getAccountedBytes() * 11 / 10) << leaf_size;
+            }
+        }
+    }
+    
+    // check_footprint rejects a build that cannot fit before it allocates anything
+    const nanoflann::KDTreeSingleIndexAdaptorParams params;
+    nanoflann::MemoryMonitoredBuildParams build_params;
+    build_params.check_footprint = true;
+    const size_t estimate = Tree::estimateMemoryFootprint(points.size(), 3, params, build_params).total();
+    try {
+        Tree index(3, dataset, params, estimate - 1, monitor_params, build_params);
+        FAIL() << "Expected MemoryLimitExceededException";
+    } catch (const nanoflann::MemoryLimitExceededException& e) {
+        EXPECT_NE(std::string(e.what()).find("estimated build footprint"), std::string::npos);
+    }
+    EXPECT_NO_THROW(Tree(3, dataset, params, estimate, monitor_params, build_params));
+    
+    // A degrading build only needs room for its index storage
+    build_params.limit_policy = nanoflann::MemoryLimitPolicy::LargerLeaves;
+    const Tree degraded(3, dataset, params, estimate / 2, monitor_params, build_params);
+    EXPECT_TRUE(degraded.getBuildDegradation().degraded());
+    
+    // A billion points are rejected from the point count alone
+    using HugeTree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, HugeDatasetAdaptor, float, uint32_t>,
+        HugeDatasetAdaptor,
+        3,
+        uint32_t>;
+    build_params.limit_policy = nanoflann::MemoryLimitPolicy::Throw;
+    EXPECT_THROW(
+        HugeTree(3, HugeDatasetAdaptor(), params, 1024 * 1024 * 1024, monitor_params, build_params),
+        nanoflann::MemoryLimitExceededException);
+}
+
+// Nearest live point of points to query, by brute force
+template <class Index>
+static float bruteForceNearest(const std::vector<std::array<float, 3>>& points,
+                               const Index& index, const std::array<float, 3>& query) {
+    float best = std::numeric_limits<float>::max();
+    for (uint32_t i = 0; i < points.size(); ++i) {
+        if (!index.isIndexed(i)) continue;
+        float dist = 0.0f;
+        for (int d = 0; d < 3; ++d) dist += (points[i][d] - query[d]) * (points[i][d] - query[d]);
+        best = std::min(best, dist);
+    }
+    return best;
+}
+
+// Test that a dynamic index answers like a full rebuild while points come and go
+TEST_F(NanoflannMemoryMonitorTest, DynamicIndex) {
+    using DynamicTree = nanoflann::MemoryMonitoredKDTreeDynamic<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points;
+    TestDatasetAdaptor dataset(points);
+    const nanoflann::MemoryMonitoredDynamicParams dynamic_params(16);
+    DynamicTree index(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(5), 100 * 1024 * 1024,
+                      nanoflann::MemoryMonitorParams(), nanoflann::MemoryMonitoredBuildParams(), dynamic_params);
+    EXPECT_EQ(index.size(), 0u);
+    
+    // Stream "scans" of 100 points; sub-indices stay logarithmic in the point count
+    for (int scan = 0; scan < 20; ++scan) {
+        const uint32_t first = static_cast<uint32_t>(points.size());
+        for (int i = 0; i < 100; ++i) points.push_back({dis(gen), dis(gen), dis(gen)});
+        index.addPoints(first, static_cast<uint32_t>(points.size()));
+    }
+    EXPECT_EQ(index.size(), 2000u);
+    EXPECT_LE(index.getSubIndexCount(), 7u);
+    
+    // Removed points are never returned
+    for (uint32_t i = 0; i < points.size(); i += 3) index.removePoint(i);
+    EXPECT_EQ(index.size(), 2000u - 667u);
+    EXPECT_FALSE(index.isIndexed(0));
+    
+    uint32_t indices[5];
+    float dists[5];
+    for (int q = 0; q < 50; ++q) {
+        const std::array<float, 3> query = {dis(gen), dis(gen), dis(gen)};
+        ASSERT_EQ(index.knnSearch(query.data(), 5, indices, dists), 5u);
+        EXPECT_FLOAT_EQ(dists[0], bruteForceNearest(points, index, query));
+        for (int j = 0; j < 5; ++j) {
+            EXPECT_NE(indices[j] % 3, 0u);
+            if (j > 0) {
+                EXPECT_LE(dists[j - 1], dists[j]);
+            }
+        }
+    }
+    
+    // A removed point can be indexed again
+    index.addPoints(0, 1);
+    EXPECT_TRUE(index.isIndexed(0));
+    ASSERT_EQ(index.knnSearch(points[0].data(), 1, indices, dists), 1u);
+    EXPECT_EQ(indices[0], 0u);
+    EXPECT_EQ(index.getEvictedCount(), 0u);
+}
+
+// Test the eviction policies of a dynamic index under a TreeBytes budget
+TEST_F(NanoflannMemoryMonitorTest, DynamicIndexEviction) {
+    using DynamicTree = nanoflann::MemoryMonitoredKDTreeDynamic<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {dis(gen), dis(gen), dis(gen)};
+    TestDatasetAdaptor dataset(points);
+    const nanoflann::MemoryMonitorParams monitor_params(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes);
+    const size_t budget = 256 * 1024;
+    
+    // Throw: the failed merge leaves the new points searchable in the buffer
+    {
+        std::vector<std::array<float, 3>> empty;
+        TestDatasetAdaptor growing(empty);
+        DynamicTree index(3, growing, nanoflann::KDTreeSingleIndexAdaptorParams(), budget, monitor_params);
+        bool thrown = false;
+        try {
+            for (const auto& p : points) {
+                empty.push_back(p);
+                index.addPoints(static_cast<uint32_t>(empty.size() - 1), static_cast<uint32_t>(empty.size()));
+            }
+        } catch (const nanoflann::MemoryLimitExceededException&) {
+            thrown = true;
+        }
+        EXPECT_TRUE(thrown);
+        const uint32_t last = static_cast<uint32_t>(empty.size() - 1);
+        EXPECT_TRUE(index.isIndexed(last));
+        uint32_t nearest;
+        float dist;
+        ASSERT_EQ(index.knnSearch(empty[last].data(), 1, &nearest, &dist), 1u);
+        EXPECT_EQ(nearest, last);
+        EXPECT_EQ(index.getEvictedCount(), 0u);
+    }
+    
+    // DropOldest: the whole stream goes in, within budget, keeping the newest points
+    size_t dropped = 0;
+    {
+        DynamicTree index(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(), budget, monitor_params,
+                          nanoflann::MemoryMonitoredBuildParams(),
+                          nanoflann::MemoryMonitoredDynamicParams(64, nanoflann::DynamicEvictionPolicy::DropOldest));
+        EXPECT_GT(index.getEvictedCount(), 0u);
+        EXPECT_LE(index.getAccountedBytes(), budget);
+        EXPECT_EQ(index.size() + index.getEvictedCount(), points.size());
+        EXPECT_TRUE(index.isIndexed(static_cast<uint32_t>(points.size() - 1)));
+        EXPECT_FALSE(index.isIndexed(0));
+        dropped = index.getEvictedCount();
+    }
+    
+    // MergeOldest: removing old points makes room before anything is dropped
+    {
+        std::vector<std::array<float, 3>> empty;
+        TestDatasetAdaptor growing(empty);
+        DynamicTree index(3, growing, nanoflann::KDTreeSingleIndexAdaptorParams(), budget, monitor_params,
+                          nanoflann::MemoryMonitoredBuildParams(),
+                          nanoflann::MemoryMonitoredDynamicParams(64, nanoflann::DynamicEvictionPolicy::MergeOldest));
+        for (uint32_t first = 0; first < points.size(); first += 500) {
+            empty.insert(empty.end(), points.begin() + first, points.begin() + first + 500);
+            index.addPoints(first, first + 500);
+            // Keep one point in four of each scan once it is old
+            if (first >= 1000) {
+                for (uint32_t i = first - 1000; i < first - 500; ++i) {
+                    if (i % 4) index.removePoint(i);
+                }
+            }
+        }
+        EXPECT_LE(index.getAccountedBytes(), budget);
+        EXPECT_LT(index.getEvictedCount(), dropped);
+        EXPECT_TRUE(index.isIndexed(static_cast<uint32_t>(points.size() - 1)));
+    }
+}
+
+// Test that every split rule builds an exact tree, also on duplicate-heavy data
+TEST_F(NanoflannMemoryMonitorTest, SplitRules) {
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    
+    // Coarse grid values with a constant z, so many points share coordinates
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> grid(0, 15);
+    std::vector<std::array<float, 3>> points(20000);
+    for (auto& p : points) p = {float(grid(gen)), float(grid(gen)) * 0.5f, 3.0f};
+    for (size_t i = 0; i < 2000; ++i) points[i] = {7.0f, 7.0f, 3.0f};
+    TestDatasetAdaptor dataset(points);
+    
+    std::uniform_real_distribution<float> dis(-2.0f, 17.0f);
+    std::vector<std::array<float, 3>> queries(200);
+    for (auto& q : queries) q = {dis(gen), dis(gen), dis(gen)};
+    
+    const nanoflann::KDTreeSingleIndexAdaptorParams params(8);
+    const Tree reference(3, dataset, params, 100 * 1024 * 1024);
+    
+    for (nanoflann::SplitRule rule : {nanoflann::SplitRule::Median, nanoflann::SplitRule::SlidingMidpoint,
+                                      nanoflann::SplitRule::Sampled}) {
+        for (int variant = 0; variant < 3; ++variant) {
+            nanoflann::MemoryMonitoredBuildParams build_params;
+            build_params.split_rule = rule;
+            build_params.compact_nodes = variant == 1;
+            const nanoflann::KDTreeSingleIndexAdaptorParams variant_params(
+                8, nanoflann::KDTreeSingleIndexAdaptorFlags::None, variant == 2 ? 4 : 1);
+            const Tree index(3, dataset, variant_params, 100 * 1024 * 1024,
+                             nanoflann::MemoryMonitorParams(), build_params);
+            EXPECT_LE(index.getBuildDegradation().max_leaf_size, 8u);
+            if (rule == nanoflann::SplitRule::Median) {
+                // Balanced: 20000 points in leaves of 8 need 12 levels below the root
+                EXPECT_LE(index.getTreeDepth(), 13u);
+            }
+            
+            for (const auto& query : queries) {
+                std::vector<uint32_t> ref_indices(5), indices(5);
+                std::vector<float> ref_dists(5), dists(5);
+                ASSERT_EQ(reference.knnSearch(query.data(), 5, ref_indices.data(), ref_dists.data()), 5u);
+                ASSERT_EQ(index.knnSearch(query.data(), 5, indices.data(), dists.data()), 5u);
+                for (size_t i = 0; i < 5; ++i) EXPECT_FLOAT_EQ(dists[i], ref_dists[i]);
+            }
+        }
+    }
+}
+
+// Test that searches through a warmed-up query context do not allocate
+TEST_F(NanoflannMemoryMonitorTest, QueryContext) {
+    using DynamicDimTree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        -1,
+        uint32_t>;
+    
+    TestDatasetAdaptor dataset(test_points_);
+    const DynamicDimTree index(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(10), 100 * 1024 * 1024);
+    DynamicDimTree::QueryContext ctx = index.makeQueryContext(8);
+    EXPECT_EQ(ctx.dists.size(), 3u);
+    
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+    std::vector<std::array<float, 3>> queries(100);
+    for (auto& q : queries) q = {dis(gen), dis(gen), dis(gen)};
+    const float radius = 900.0f;
+    
+    // Same results as the allocating calls
+    for (const auto& query : queries) {
+        std::vector<uint32_t> indices(8);
+        std::vector<float> dists(8);
+        const size_t found = index.knnSearch(query.data(), 8, indices.data(), dists.data());
+        ASSERT_EQ(index.knnSearch(ctx, query.data(), 8), found);
+        for (size_t i = 0; i < found; ++i) {
+            EXPECT_EQ(ctx.indices[i], indices[i]);
+            EXPECT_EQ(ctx.distances[i], dists[i]);
+        }
+        
+        std::vector<nanoflann::ResultItem<uint32_t, float>> matches;
+        ASSERT_EQ(index.radiusSearch(ctx, query.data(), radius), index.radiusSearch(query.data(), radius, matches));
+        for (size_t i = 0; i < matches.size(); ++i) {
+            EXPECT_EQ(ctx.matches[i].first, matches[i].first);
+            EXPECT_EQ(ctx.matches[i].second, matches[i].second);
+        }
+    }
+    
+    // The context now holds the largest radius result of these queries
+    const size_t before = g_heap_allocations.load();
+    size_t total = 0;
+    for (const auto& query : queries) {
+        total += index.knnSearch(ctx, query.data(), 8);
+        total += index.radiusSearch(ctx, query.data(), radius);
+    }
+    EXPECT_EQ(g_heap_allocations.load(), before);
+    EXPECT_GT(total, 800u);
+}
+
+// Test the shared pressure callback on the build path and the bounded radius search
+TEST_F(NanoflannMemoryMonitorTest, MemoryPressure) {
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    using Match = nanoflann::ResultItem<uint32_t, float>;
+    
+    TestDatasetAdaptor dataset(test_points_);
+    const nanoflann::KDTreeSingleIndexAdaptorParams deferred(
+        10, nanoflann::KDTreeSingleIndexAdaptorFlags::SkipInitialBuildIndex);
+    const nanoflann::MemoryMonitorParams tree_bytes(
+        256, 1024 * 1024, nanoflann::MemoryAccountingMode::TreeBytes, 100 * sizeof(Match));
+    const Tree full(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(10), 100 * 1024 * 1024, tree_bytes);
+    const size_t tree_size = full.getAccountedBytes();
+    
+    std::vector<nanoflann::MemoryPressureEvent> events;
+    auto record = [&events](const nanoflann::MemoryPressureEvent& event) { events.push_back(event); };
+    
+    // Close to the threshold: one pressure event, and the build completes
+    {
+        Tree index(3, dataset, deferred, tree_size + tree_size / 20, tree_bytes);
+        index.setMemoryPressureCallback(record);
+        index.buildIndex();
+        ASSERT_EQ(events.size(), 1u);
+        EXPECT_EQ(events[0].source, nanoflann::MemoryPressureSource::Build);
+        EXPECT_FALSE(events[0].exceeded);
+        EXPECT_GE(events[0].usage, events[0].limit * 9 / 10);
+    }
+    
+    // Over the threshold: exceeded just before the build throws. A check that
+    // jumps straight past the limit reports it once.
+    events.clear();
+    {
+        Tree index(3, dataset, deferred, tree_size / 2, tree_bytes);
+        index.setMemoryPressureCallback(record);
+        EXPECT_THROW(index.buildIndex(), nanoflann::MemoryLimitExceededException);
+        ASSERT_FALSE(events.empty());
+        EXPECT_LE(events.size(), 2u);
+        EXPECT_TRUE(events.back().exceeded);
+        EXPECT_GT(events.back().usage, tree_size / 2);
+    }
+    
+    // Queries: the budget holds 100 matches
+    Tree index(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(10), 100 * 1024 * 1024, tree_bytes);
+    index.setMemoryPressureCallback(record);
+    const std::array<float, 3> query = {0.0f, 0.0f, 0.0f};
+    std::vector<float> sorted_dists;
+    for (const auto& p : test_points_) sorted_dists.push_back(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    std::sort(sorted_dists.begin(), sorted_dists.end());
+    
+    events.clear();
+    bool truncated = true;
+    std::vector<Match> matches, expected;
+    EXPECT_EQ(index.radiusSearchBounded(query.data(), sorted_dists[50], matches, truncated), 50u);
+    EXPECT_FALSE(truncated);
+    EXPECT_EQ(index.radiusSearch(query.data(), sorted_dists[50], expected), 50u);
+    for (size_t i = 0; i < 50; ++i) EXPECT_EQ(matches[i].first, expected[i].first);
+    EXPECT_TRUE(events.empty());
+    
+    // 95 matches are above pressure_ratio of the budget
+    EXPECT_EQ(index.radiusSearchBounded(query.data(), sorted_dists[95], matches, truncated), 95u);
+    EXPECT_FALSE(truncated);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].source, nanoflann::MemoryPressureSource::Query);
+    EXPECT_FALSE(events[0].exceeded);
+    EXPECT_EQ(events[0].usage, 95 * sizeof(Match));
+    
+    // Every point is inside: the search stops at the budget
+    std::vector<Match> capped;
+    EXPECT_EQ(index.radiusSearchBounded(query.data(), 1e9f, capped, truncated), 100u);
+    EXPECT_TRUE(truncated);
+    EXPECT_LE(capped.capacity(), 100u);
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_TRUE(events[1].exceeded);
+    EXPECT_EQ(events[1].limit, 100 * sizeof(Match));
+    for (size_t i = 1; i < capped.size(); ++i) EXPECT_LE(capped[i - 1].second, capped[i].second);
+    
+    auto ctx = index.makeQueryContext();
+    EXPECT_EQ(index.radiusSearchBounded(ctx, query.data(), 1e9f, truncated), 100u);
+    EXPECT_TRUE(truncated);
+}
+
+// Test the hot-path counters and their report through the Debug:: output sink
+TEST_F(NanoflannMemoryMonitorTest, Counters) {
+    using Tree = nanoflann::MemoryMonitoredKDTree<
+        nanoflann::L2_Simple_Adaptor<float, TestDatasetAdaptor, float, uint32_t>,
+        TestDatasetAdaptor,
+        3,
+        uint32_t>;
+    
+    TestDatasetAdaptor dataset(test_points_);
+    // Probe the process RSS on every check
+    Tree index(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(10), 8ull * 1024 * 1024 * 1024,
+               nanoflann::MemoryMonitorParams(1, 1));
+    nanoflann::MonitorCounters counters = index.getCounters();
+    
+#ifdef NANOFLANN_MONITOR_COUNTERS
+    EXPECT_GT(counters.splits, 0u);
+    EXPECT_GT(counters.split_ns, 0u);
+    EXPECT_GT(counters.bbox_updates, counters.splits);
+    EXPECT_GT(counters.probes, 0u);
+    EXPECT_EQ(counters.queries, 0u);
+    
+    // Queries on several threads, each counting into its own slot
+    index.resetCounters();
+    EXPECT_EQ(index.getCounters().splits, 0u);
+    auto search = [&index](unsigned seed) {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+        std::vector<uint32_t> indices(5);
+        std::vector<float> dists(5);
+        for (int q = 0; q < 50; ++q) {
+            const std::array<float, 3> query = {dis(gen), dis(gen), dis(gen)};
+            index.knnSearch(query.data(), 5, indices.data(), dists.data());
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; ++t) threads.emplace_back(search, t);
+    for (auto& thread : threads) thread.join();
+    
+    counters = index.getCounters();
+    EXPECT_EQ(counters.queries, 200u);
+    EXPECT_GT(counters.leaves_scanned, counters.queries);
+    EXPECT_GT(counters.nodes_visited, counters.leaves_scanned);
+    EXPECT_GE(counters.distance_evaluations, 5 * counters.queries);
+    EXPECT_GT(counters.pruned_branches, 0u);
+    EXPECT_EQ(counters.splits, 0u);
+    
+    // A thread alternating between trees keeps their counts apart, also for a
+    // tree that reuses the counter index of a destroyed one
+    for (int round = 0; round < 2; ++round) {
+        Tree other(3, dataset, nanoflann::KDTreeSingleIndexAdaptorParams(10), 8ull * 1024 * 1024 * 1024);
+        other.resetCounters();
+        std::vector<uint32_t> indices(5);
+        std::vector<float> dists(5);
+        for (int q = 0; q < 10; ++q) {
+            index.knnSearch(test_points_[q].data(), 5, indices.data(), dists.data());
+            other.knnSearch(test_points_[q].data(), 5, indices.data(), dists.data());
+            other.knnSearch(test_points_[q + 1].data(), 5, indices.data(), dists.data());
+        }
+        EXPECT_EQ(other.getCounters().queries, 20u);
+    }
+    EXPECT_EQ(index.getCounters().queries, 220u);
+    index.resetCounters();
+    for (auto& thread : threads) thread = std::thread(search, 7);
+    for (auto& thread : threads) thread.join();
+    counters = index.getCounters();
+    EXPECT_EQ(counters.queries, 200u);
+    
+    std::string output;
+    Debug::set_output_stream([&output](const std::string& message) { output += message; });
+    index.reportCounters();
+    Debug::set_output_stream([](const std::string& message) { std::fprintf(stderr, "%s\n", message.c_str()); });
+    EXPECT_NE(output.find("[nanoflann] counters: 200 queries"), std::string::npos);
+#else
+    // Compiled out: the snapshot stays empty
+    EXPECT_EQ(counters.splits, 0u);
+    EXPECT_EQ(counters.probes, 0u);
+    std::vector<uint32_t> indices(5);
+    std::vector<float> dists(5);
+    index.knnSearch(test_points_[0].data(), 5, indices.data(), dists.data());
+    EXPECT_EQ(index.getCounters().queries, 0u);
+#endif
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}